@@ -0,0 +1,64 @@
+// Author: Akira Okumura <mailto:oxon@mac.com>
+/******************************************************************************
+ * Copyright (C) 2006-, Akira Okumura                                         *
+ * All rights reserved.                                                       *
+ *****************************************************************************/
+
+#ifndef A_BEZIER_PROFILE_H
+#define A_BEZIER_PROFILE_H
+
+#include "TVector2.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// ABezierProfile
+//
+// Polynomial form of the Bezier curve (r(u), z(u)), 0 <= u <= 1, which gives
+// the side surfaces of AGeoBezierCone and AGeoBezierConePoly, and its
+// intersections with rays
+//
+///////////////////////////////////////////////////////////////////////////////
+
+class ABezierProfile {
+ private:
+  Int_t fDegree;       // Degree of the curve (1, 2, or 3)
+  Double_t fR[4];      // Coefficients of r(u) = Sum fR[k] u^k
+  Double_t fZ[4];      // Coefficients of z(u) = Sum fZ[k] u^k
+  Double_t fDZ;        // Half length. z(0) = -fDZ and z(1) = +fDZ
+  Double_t fRmax;      // Maximum of r(u)
+  Double_t fSlopeMax;  // Maximum of |dr/dz|
+
+  static Double_t Polynomial(Int_t n, const Double_t* c, Double_t u,
+                             Double_t* deriv = 0);
+
+ public:
+  ABezierProfile();
+  virtual ~ABezierProfile() {}
+
+  Double_t CalcR(Double_t z) const { return GetR(FindU(z)); }
+  Int_t CrossFace(Double_t q, Double_t w, Double_t z0, Double_t dz,
+                  Double_t* u, Double_t* t) const;
+  Int_t CrossRevolved(const Double_t* point, const Double_t* dir, Double_t* u,
+                      Double_t* t) const;
+  static Int_t FindRoots(Int_t n, const Double_t* c, Double_t* roots);
+  Double_t FindU(Double_t z) const;
+  Double_t GetdR(Double_t u) const {
+    return fR[1] + u * (2 * fR[2] + u * 3 * fR[3]);
+  }
+  Double_t GetdZ(Double_t u) const {
+    return fZ[1] + u * (2 * fZ[2] + u * 3 * fZ[3]);
+  }
+  Double_t GetR(Double_t u) const {
+    return fR[0] + u * (fR[1] + u * (fR[2] + u * fR[3]));
+  }
+  Double_t GetRmax() const { return fRmax; }
+  Double_t GetSlopeMax() const { return fSlopeMax; }
+  Double_t GetSquareIntegral() const;
+  Double_t GetZ(Double_t u) const {
+    return fZ[0] + u * (fZ[1] + u * (fZ[2] + u * fZ[3]));
+  }
+  Bool_t Set(Double_t r1, Double_t r2, Double_t dz, Int_t ncontrol,
+             const TVector2& p1, const TVector2& p2);
+};
+
+#endif  // A_BEZIER_PROFILE_H
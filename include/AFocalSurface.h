@@ -7,9 +7,14 @@
 #ifndef A_FOCAL_SURFACE_H
 #define A_FOCAL_SURFACE_H
 
+#include <memory>
+#include <vector>
+
 #include "TGraph.h"
 
 #include "AOpticalComponent.h"
+#include "ARayArray.h"
+#include "ARayBatch.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -21,21 +26,46 @@
 
 class AFocalSurface : public AOpticalComponent {
  private:
+  // QE curve resampled at equally spaced nodes
+  struct AQETable {
+    Double_t fMin;                  // First node
+    Double_t fInvStep;              // Inverse of the node step
+    std::vector<Double_t> fValues;  // QE at the nodes
+  };
+
   TGraph* fQuantumEfficiencyLambda;  // Quantum efficiency (QE vs lambda)
   TGraph* fQuantumEfficiencyAngle;   // Quantum efficiency (QE vs angle)
+  Bool_t fQELambdaFolded;            // Lambda QE already applied at the source
+  AQETable fQELambdaTable;           //!
+  AQETable fQEAngleTable;            //!
+
+  static Double_t Evaluate(const TGraph& graph, const AQETable& table,
+                           Double_t x);
+  static void Tabulate(const TGraph* graph, AQETable& table);
 
  public:
+  enum EFoldMode { kRejection, kWeight };
+
   AFocalSurface();
   AFocalSurface(const char* name, const TGeoShape* shape,
                 const TGeoMedium* med = 0);
+  virtual ~AFocalSurface();
 
-  Bool_t HasQEAngle() const { return fQuantumEfficiencyAngle ? kTRUE : kFALSE; }
-  void SetQuantumEfficiency(TGraph* qe) { fQuantumEfficiencyLambda = qe; }
-  void SetQuantumEfficiencyAngle(TGraph* qe) { fQuantumEfficiencyAngle = qe; }
+  void FoldQuantumEfficiency(ARayArray& array) const;
+  void FoldQuantumEfficiency(ARayBatch& batch,
+                             EFoldMode mode = kRejection) const;
+  Double_t GetDetectionProbability(Double_t lambda, Double_t angle) const;
   Double_t GetQuantumEfficiency(Double_t lambda) const;
   Double_t GetQuantumEfficiency(Double_t lambda, Double_t angle) const;
+  Bool_t HasQEAngle() const { return fQuantumEfficiencyAngle ? kTRUE : kFALSE; }
+  Bool_t IsQELambdaFolded() const { return fQELambdaFolded; }
+  void SetQELambdaFolded(Bool_t folded) { fQELambdaFolded = folded; }
+  void SetQuantumEfficiency(const TGraph* qe);
+  void SetQuantumEfficiency(std::shared_ptr<const TGraph> qe);
+  void SetQuantumEfficiencyAngle(const TGraph* qe);
+  void SetQuantumEfficiencyAngle(std::shared_ptr<const TGraph> qe);
 
-  ClassDef(AFocalSurface, 1)
+  ClassDef(AFocalSurface, 3)
 };
 
 #endif  // A_FOCAL_SURFACE_H
@@ -7,6 +7,8 @@
 #ifndef A_GEO_ASPHERIC_DISK_H
 #define A_GEO_ASPHERIC_DISK_H
 
+#include <vector>
+
 #include "TGeoBBox.h"
 
 #if ROOT_VERSION_CODE >= ROOT_VERSION(5, 34, 10)
@@ -43,7 +45,16 @@ class AGeoAsphericDisk : public TGeoBBox {
   Int_t fSteps;   // steps of approximate calculation
   Int_t fRepeat;  // repeat times of approximate calculation
 
+  Double_t fSagMin[2];  //! Minimum of F1 - fZ1 and F2 - fZ2 (see ComputeBBox)
+  Double_t fSagMax[2];  //! Maximum of F1 - fZ1 and F2 - fZ2
+  std::vector<Double_t> fSlope[2];  //! Bound of |dFn/dr| in each of fSteps bins
+  Double_t fSlopeMax[2];            //! Bound of |dFn/dr| over the surface
+  Double_t fWallZ[2][2];            //! Z range of the walls at fRmin and fRmax
+
+  Bool_t CalcSag(Int_t n, Double_t h2, Double_t& sag, Double_t& dsag) const;
+  void ComputeProfiles();
   void DeleteArrays();
+  Double_t SafetyToSurface(Int_t n, Double_t rad, Double_t z) const;
 
  public:
   AGeoAsphericDisk();
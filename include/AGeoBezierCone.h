@@ -0,0 +1,70 @@
+// Author: Akira Okumura <mailto:oxon@mac.com>
+/******************************************************************************
+ * Copyright (C) 2006-, Akira Okumura                                         *
+ * All rights reserved.                                                       *
+ *****************************************************************************/
+
+#ifndef A_GEO_BEZIER_CONE_H
+#define A_GEO_BEZIER_CONE_H
+
+#include "ABezierProfile.h"
+#include "AGeoBezierPcon.h"
+
+#if ROOT_VERSION_CODE >= ROOT_VERSION(5, 34, 10)
+#define CONST53410 const
+#else
+#define CONST53410
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// AGeoBezierCone
+//
+// Geometry class for a solid of revolution whose side surface is defined by a
+// Bezier curve as in AGeoBezierPcon. Rays are intersected with the exact
+// surface, and the conical sections are used only for drawing.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+class AGeoBezierCone : public AGeoBezierPcon {
+ protected:
+  ABezierProfile fProfile;  //! Polynomial form of the Bezier curve
+
+  virtual void CacheConstants();
+  Double_t DistToSurface(CONST53410 Double_t* point, CONST53410 Double_t* dir,
+                         Bool_t in) const;
+
+ public:
+  AGeoBezierCone();
+  AGeoBezierCone(Double_t r1, Double_t r2, Double_t dz, Int_t nz = 50);
+  AGeoBezierCone(const char* name, Double_t r1, Double_t r2, Double_t dz,
+                 Int_t nz = 50);
+  virtual ~AGeoBezierCone();
+
+  Double_t CalcR(Double_t z) const { return fProfile.CalcR(z); }
+  virtual Double_t Capacity() const;
+  virtual void ComputeBBox();
+  virtual void ComputeNormal(CONST53410 Double_t* point,
+                             CONST53410 Double_t* dir, Double_t* norm);
+  virtual Bool_t Contains(CONST53410 Double_t* point) const;
+  virtual TGeoVolume* Divide(TGeoVolume* voldiv, const char* divname,
+                             Int_t iaxis, Int_t ndiv, Double_t start,
+                             Double_t step);
+  virtual Double_t DistFromInside(CONST53410 Double_t* point,
+                                  CONST53410 Double_t* dir, Int_t iact = 1,
+                                  Double_t step = TGeoShape::Big(),
+                                  Double_t* safe = 0) const;
+  virtual Double_t DistFromOutside(CONST53410 Double_t* point,
+                                   CONST53410 Double_t* dir, Int_t iact = 1,
+                                   Double_t step = TGeoShape::Big(),
+                                   Double_t* safe = 0) const;
+  virtual void GetBoundingCylinder(Double_t* param) const;
+  virtual void InspectShape() const;
+  virtual Double_t Safety(CONST53410 Double_t* point, Bool_t in = kTRUE) const;
+  virtual void SavePrimitive(std::ostream& out, Option_t* option = "");
+  virtual void SetSections();
+
+  ClassDef(AGeoBezierCone, 1)
+};
+
+#endif  // A_GEO_BEZIER_CONE_H
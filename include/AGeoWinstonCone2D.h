@@ -8,6 +8,7 @@
 #define A_GEO_WINSTON_CONE_2D_H
 
 #include "TGeoBBox.h"
+#include "TMath.h"
 
 #if ROOT_VERSION_CODE >= ROOT_VERSION(5, 34, 10)
 #define CONST53410 const
@@ -31,6 +32,18 @@ class AGeoWinstonCone2D : public TGeoBBox {
   Double_t fR2;     // Half of the smaller aperture
   Double_t fTheta;  // Cutoff angle
   Double_t fF;      // Focal length
+  Double_t fCosTheta;   //! Cos(fTheta)
+  Double_t fSinTheta;   //! Sin(fTheta)
+  Double_t fInvF;       //! 1/fF
+  Double_t fRconst[3];  //! R(z) = [0] + [1]t + [2]Sqrt(fF cos(fTheta)t + fF^2)
+  Double_t fFcos;       //! fF * Cos(fTheta)
+  Double_t fF2;         //! fF * fF
+
+  virtual void CacheConstants();
+  Double_t DistToRotatedParabola(CONST53410 Double_t* point,
+                                 CONST53410 Double_t* dir, Double_t cosphi,
+                                 Double_t sinphi, Double_t cosopen,
+                                 Double_t sinopen) const;
 
  public:
   AGeoWinstonCone2D();
@@ -70,6 +83,8 @@ class AGeoWinstonCone2D : public TGeoBBox {
   }
   virtual void GetMeshNumbers(Int_t& nvert, Int_t& nsegs, Int_t& npols) const;
   virtual Int_t GetNmeshVertices() const;
+  Double_t GetR1() const { return fR1; }
+  Double_t GetR2() const { return fR2; }
   virtual Double_t GetTheta() const { return fTheta; }
   virtual void InspectShape() const;
   virtual Bool_t IsCylType() const { return kFALSE; }
@@ -86,4 +101,77 @@ class AGeoWinstonCone2D : public TGeoBBox {
   ClassDef(AGeoWinstonCone2D, 1)
 };
 
+//______________________________________________________________________________
+inline Double_t AGeoWinstonCone2D::DistToRotatedParabola(
+    CONST53410 Double_t* point, CONST53410 Double_t* dir, Double_t cosphi,
+    Double_t sinphi, Double_t cosopen, Double_t sinopen) const {
+  // Distance to the parabola rotated by phi around the Z axis, given by its
+  // cosine and sine. Crossing points are accepted only within +-open/2 around
+  // phi, given by Cos(open/2) and Sin(open/2) (open <= Pi). The sector is
+  // widened by 1e-9 so that a ray crossing an edge between two faces of
+  // AGeoWinstonConePoly is not rejected by both faces due to rounding.
+  Double_t x = cosphi * point[0] + sinphi * point[1];
+  Double_t y = -sinphi * point[0] + cosphi * point[1];
+  Double_t z = point[2];
+  Double_t px = cosphi * dir[0] + sinphi * dir[1];
+  Double_t py = -sinphi * dir[0] + cosphi * dir[1];
+  Double_t pz = dir[2];
+
+  if (px == 0 and pz == 0) {
+    return TGeoShape::Big();
+  }
+
+  // coordinates in the parabola frame inside the 1st quadrant
+  // The focal point is at (X, Z) = (0, f)
+  Double_t X = fCosTheta * (x + fR2) + (z + fDZ) * fSinTheta;
+  Double_t Z = -fSinTheta * (x + fR2) + (z + fDZ) * fCosTheta + fF;
+  Double_t PX = fCosTheta * px + fSinTheta * pz;  // direction in the X-Z plane
+  Double_t PZ = -fSinTheta * px + fCosTheta * pz;
+
+  Double_t Xcross[2];
+  if (2 * fDZ * TMath::Abs(PX) < TGeoShape::Tolerance() * TMath::Abs(PZ)) {
+    // direction is almost parallel to Z axis
+    Xcross[0] = X;
+    Xcross[1] = X;
+  } else {
+    Double_t tanA = PZ / PX;
+    Double_t tmp = tanA * tanA - (X * tanA - Z) * fInvF;
+    if (tmp < 0) {
+      return TGeoShape::Big();
+    }
+    Double_t sq = TMath::Sqrt(tmp);
+    Xcross[0] = 2 * fF * (tanA + sq);
+    Xcross[1] = 2 * fF * (tanA - sq);
+  }
+
+  // Avoid using meaningless values such as py/pz when |py| << 1 and |pz| << 1
+  // and py/px when |py| << 1 and |px| << 1. In the case of |px| << 1 and
+  // |pz| << 1, |py| is almost 1, and thus the photon will not cross the
+  // parabolas.
+  Double_t apx = TMath::Abs(px);
+  Double_t apy = TMath::Abs(py);
+  Double_t apz = TMath::Abs(pz);
+  Bool_t alongZ = (apx <= apz and apy <= apz) or
+                  (not(apy <= apx and apz <= apx) and apx < 1e-5);
+  Double_t slope = alongZ ? py / pz : py / px;
+
+  Double_t dist = TGeoShape::Big();
+  for (Int_t i = 0; i < 2; i++) {
+    Double_t Zcross = Xcross[i] * Xcross[i] * fInvF / 4.;
+    Double_t xcross = fCosTheta * Xcross[i] - fSinTheta * (Zcross - fF) - fR2;
+    Double_t zcross = fSinTheta * Xcross[i] + fCosTheta * (Zcross - fF) - fDZ;
+    Double_t dx = xcross - x;
+    Double_t dz = zcross - z;
+    Double_t dy = (alongZ ? dz : dx) * slope;
+    if (xcross < fR2 or fR1 < xcross or zcross < -fDZ or fDZ < zcross or
+        dx * px + dz * pz < 0 or
+        TMath::Abs(y + dy) * cosopen > xcross * (sinopen + 1e-9)) {
+      continue;
+    }
+    dist = TMath::Min(dist, TMath::Sqrt(dx * dx + dy * dy + dz * dz));
+  }
+
+  return dist;
+}
+
 #endif  // A_GEO_WINSTON_CONE_2D_H
@@ -7,6 +7,8 @@
 #ifndef A_GEO_WINSTON_CONE_POLY_H
 #define A_GEO_WINSTON_CONE_POLY_H
 
+#include <vector>
+
 #include "AGeoWinstonCone2D.h"
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -21,6 +23,15 @@
 class AGeoWinstonConePoly : public AGeoWinstonCone2D {
  protected:
   Int_t fPolyN;  //
+  std::vector<Double_t> fCosPhi;  //! Cos of the direction of each face
+  std::vector<Double_t> fSinPhi;  //! Sin of the direction of each face
+  Double_t fCosSector;            //! Cos(Pi/fPolyN)
+  Double_t fSinSector;            //! Sin(Pi/fPolyN)
+  Double_t fRcirc;  //! Radius of the circumscribed cylinder of the shape
+
+  virtual void CacheConstants();
+  Int_t FindFaces(CONST53410 Double_t* point, CONST53410 Double_t* dir,
+                  Bool_t in, Int_t& first) const;
 
  public:
   AGeoWinstonConePoly();
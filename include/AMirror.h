@@ -7,6 +7,8 @@
 #ifndef A_MIRROR_H
 #define A_MIRROR_H
 
+#include <vector>
+
 #include "TGraph.h"
 #include "TGraph2D.h"
 #include "TH2.h"
@@ -30,19 +32,43 @@ class AMirror : public AOpticalComponent {
       fReflectance2D;  // Reflectance data (ref v.s. angle v.s. wavelength)
   std::shared_ptr<TH2>
       fReflectanceTH2;  // Reflectance data (ref v.s. angle v.s. wavelength)
+  Int_t fGridNlambda;  // Number of wavelength nodes of the reflectance grid
+  Int_t fGridNangle;   // Number of angle nodes of the reflectance grid
+  Double_t fGridLambdaMin;   //! First wavelength node
+  Double_t fGridInvDlambda;  //! Inverse of the wavelength step
+  Double_t fGridAngleMin;    //! First angle node
+  Double_t fGridInvDangle;   //! Inverse of the angle step
+  Int_t fGridNcolumns;       //! Angle nodes in the grid (1 for a TGraph)
+  std::vector<Double_t> fReflectanceGrid;  //! [i_lambda][i_angle]
+
+  Bool_t InterpolateReflectanceGrid(Double_t lambda, Double_t angle,
+                                    Double_t& reflectance) const;
 
  public:
   AMirror();
   AMirror(const char* name, const TGeoShape* shape, const TGeoMedium* med = 0);
   virtual ~AMirror();
 
-  Double_t GetReflectance(Double_t lambda, Double_t angle /* (rad) */);
+  void BuildReflectanceGrid();
+  Double_t GetReflectance(Double_t lambda, Double_t angle /* (rad) */) const;
+  Bool_t HasReflectanceGrid() const { return not fReflectanceGrid.empty(); }
+  Bool_t IsReflectanceGridUsed() const { return fGridNlambda > 0; }
   void SetReflectance(Double_t ref) { fReflectance = ref; }
-  void SetReflectance(std::shared_ptr<const TGraph> ref) { fReflectance1D = ref; }
-  void SetReflectance(std::shared_ptr<TH2> ref) { fReflectanceTH2 = ref; }
-  void SetReflectance(std::shared_ptr<TGraph2D> ref) { fReflectance2D = ref; }
+  void SetReflectance(std::shared_ptr<const TGraph> ref) {
+    fReflectance1D = ref;
+    fReflectanceGrid.clear();
+  }
+  void SetReflectance(std::shared_ptr<TH2> ref) {
+    fReflectanceTH2 = ref;
+    fReflectanceGrid.clear();
+  }
+  void SetReflectance(std::shared_ptr<TGraph2D> ref) {
+    fReflectance2D = ref;
+    fReflectanceGrid.clear();
+  }
+  void UseReflectanceGrid(Int_t n_lambda = 1001, Int_t n_angle = 91);
 
-  ClassDef(AMirror, 1)
+  ClassDef(AMirror, 2)
 };
 
 #endif  // A_MIRROR_H
@@ -34,16 +34,19 @@ class AMixedRefractiveIndex : public ARefractiveIndex {
   virtual ~AMixedRefractiveIndex() {}
 
   virtual Double_t GetRefractiveIndex(Double_t lambda) const {
+    if (IsInFrozenRange(lambda)) return GetFrozenRefractiveIndex(lambda);
     Double_t nA = fMaterialA->GetRefractiveIndex(lambda);
     Double_t nB = fMaterialB->GetRefractiveIndex(lambda);
     return nA * fFractionA + nB * fFractionB;
   }
   virtual Double_t GetExtinctionCoefficient(Double_t lambda) const {
+    if (IsInFrozenRange(lambda)) return GetFrozenExtinctionCoefficient(lambda);
     Double_t kA = fMaterialA->GetExtinctionCoefficient(lambda);
     Double_t kB = fMaterialB->GetExtinctionCoefficient(lambda);
     return kA * fFractionA + kB * fFractionB;
   }
   void SetFraction(Double_t fractionA, Double_t fractionB) {
+    Unfreeze();
     fFractionA = fractionA / (fractionA + fractionB);
     fFractionB = fractionB / (fractionA + fractionB);
   }
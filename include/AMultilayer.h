@@ -8,11 +8,14 @@
 #define A_MULTILAYER_H
 
 #include <memory>
+#include <string>
 #include <thread>
 
 #include <TH2.h>
 
+#include "AMultilayerTable.h"
 #include "ARefractiveIndex.h"
+#include "AThreadPool.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -25,47 +28,53 @@ class AMultilayer : public TObject {
   enum EPolarization { kS, kP };
 
  private:
+  struct ATMMWorkspace;  // Per-thread intermediate values of CoherentTMM
+
   std::vector<std::shared_ptr<ARefractiveIndex>> fRefractiveIndexList;
   std::vector<Double_t> fThicknessList;
   std::vector<Double_t> fCoherentList;
+  std::vector<std::size_t> fIncoherentLayers;  //! Updated by Add/InsertLayer
   std::size_t fNthreads;
-  std::shared_ptr<TH2D> fPreCalculatedReflectanceMixed;
-  std::shared_ptr<TH2D> fPreCalculatedTransmittanceMixed;
+  std::shared_ptr<AThreadPool> fThreadPool;  //! Used by the grid calculations
+  std::shared_ptr<const AMultilayerTable> fPreCalculatedTable;
+  std::shared_ptr<TH2D> fPreCalculatedReflectanceMixed;  // view of the table
+  std::shared_ptr<TH2D> fPreCalculatedTransmittanceMixed;  // ditto
+  std::string fCacheDirectory;  // Directory of the precalculated tables
 
   Bool_t IsForwardAngle(std::complex<Double_t> n,
                         std::complex<Double_t> theta) const;
   void ListSnell(std::complex<Double_t> th_0,
                  const std::vector<std::complex<Double_t>>& n_list,
                  std::vector<std::complex<Double_t>>& th_list) const;
-  void CoherentTMMMixedMultiAngle(
-      std::vector<std::complex<Double_t>>::const_iterator th_0_cbegin,
-      std::vector<std::complex<Double_t>>::const_iterator th_0_cend,
-      Double_t lam_vac, std::vector<Double_t>::iterator reflectance_it,
-      std::vector<Double_t>::iterator transmittance_it) {
-    for (auto cit = th_0_cbegin; cit != th_0_cend; ++cit) {
-      Double_t r, t;
-      CoherentTMMMixed(*cit, lam_vac, r, t);
-      *reflectance_it = r;
-      *transmittance_it = t;
-      ++reflectance_it;
-      ++transmittance_it;
-    }
-  }
-  void CoherentTMMMixedMultiWavelength(
-      std::complex<Double_t> th_0,
-      std::vector<Double_t>::const_iterator lam_vac_cbegin,
-      std::vector<Double_t>::const_iterator lam_vac_cend,
-      std::vector<Double_t>::iterator reflectance_it,
-      std::vector<Double_t>::iterator transmittance_it) {
-    for (auto cit = lam_vac_cbegin; cit != lam_vac_cend; ++cit) {
-      Double_t r, t;
-      CoherentTMMMixed(th_0, *cit, r, t);
-      *reflectance_it = r;
-      *transmittance_it = t;
-      ++reflectance_it;
-      ++transmittance_it;
-    }
-  }
+  static ATMMWorkspace& GetTMMWorkspace(std::size_t num_layers);
+  void FillTMMIndices(ATMMWorkspace& ws, Double_t lam_vac,
+                      Bool_t reverse) const;
+  void FillTMMAngles(ATMMWorkspace& ws, std::complex<Double_t> th_0,
+                     Double_t lam_vac, Bool_t reverse,
+                     std::size_t first = 0) const;
+  ATMMWorkspace& PrepareCoherentTMM(std::complex<Double_t> th_0,
+                                    Double_t lam_vac, Bool_t reverse) const;
+  void TMMMixedGrid(Bool_t coherent, std::size_t n_lambda,
+                    const Double_t* lam_vac, std::size_t n_angle,
+                    const std::complex<Double_t>* th_0, Double_t* reflectance,
+                    Double_t* transmittance) const;
+  static void MultiplyTransferMatrices(EPolarization polarization,
+                                       const ATMMWorkspace& ws,
+                                       std::complex<Double_t> th_0,
+                                       Double_t& reflectance,
+                                       Double_t& transmittance,
+                                       Double_t* reflectance_bwd = nullptr,
+                                       Double_t* transmittance_bwd = nullptr);
+  static void DifferentiateTransferMatrices(
+      EPolarization polarization, ATMMWorkspace& ws,
+      std::complex<Double_t> th_0, Double_t& reflectance,
+      Double_t& transmittance, Double_t* reflectance_bwd = nullptr,
+      Double_t* transmittance_bwd = nullptr);
+  void IncoherentTMM(EPolarization polarization, std::complex<Double_t> th_0,
+                     Double_t lam_vac, Double_t& reflectance,
+                     Double_t& transmittance,
+                     std::vector<Double_t>* reflectance_grad,
+                     std::vector<Double_t>* transmittance_grad) const;
   void IncGroupLayers(std::vector<std::vector<Double_t>>& stack_d_list,
                       std::vector<std::vector<std::shared_ptr<ARefractiveIndex>>>& stack_n_list,
                       std::vector<std::size_t>& all_from_inc,
@@ -75,6 +84,13 @@ class AMultilayer : public TObject {
                       std::vector<std::size_t>& inc_from_stack,
                       std::vector<std::size_t>& stack_from_inc
                       ) const;
+  void UpdateIncoherentLayers();
+  void PreCalculateTMM(Bool_t coherent, Int_t lam_nbins, Double_t lam_min,
+                       Double_t lam_max, Int_t th_nbins, Double_t th_min,
+                       Double_t th_max, Bool_t in_cosine);
+  std::string GetCacheKey(Bool_t coherent,
+                          const AMultilayerTable& table) const;
+  void SetPreCalculatedTable(std::shared_ptr<const AMultilayerTable> table);
 
  public:
   AMultilayer(std::shared_ptr<ARefractiveIndex> top,
@@ -106,35 +122,52 @@ class AMultilayer : public TObject {
   void CoherentTMM(EPolarization polarization, std::complex<Double_t> th_0,
                    Double_t lam_vac, Double_t& reflectance,
                    Double_t& transmittance, Bool_t reverse = kFALSE) const;
+  void CoherentTMMSP(std::complex<Double_t> th_0, Double_t lam_vac,
+                     Double_t& reflectance_s, Double_t& transmittance_s,
+                     Double_t& reflectance_p, Double_t& transmittance_p,
+                     Bool_t reverse = kFALSE) const;
   void IncoherentTMM(EPolarization polarization,
                      std::complex<Double_t> th_0, Double_t lam_vac,
                      Double_t& reflectance,
                      Double_t& transmittance) const;
+  void CoherentTMMGradient(EPolarization polarization,
+                           std::complex<Double_t> th_0, Double_t lam_vac,
+                           Double_t& reflectance, Double_t& transmittance,
+                           std::vector<Double_t>& reflectance_grad,
+                           std::vector<Double_t>& transmittance_grad) const;
+  void IncoherentTMMGradient(EPolarization polarization,
+                             std::complex<Double_t> th_0, Double_t lam_vac,
+                             Double_t& reflectance, Double_t& transmittance,
+                             std::vector<Double_t>& reflectance_grad,
+                             std::vector<Double_t>& transmittance_grad) const;
 
   void CoherentTMMMixed(std::complex<Double_t> th_0, Double_t lam_vac,
                         Double_t& reflectance, Double_t& transmittance) const {
-    if(fPreCalculatedReflectanceMixed and fPreCalculatedTransmittanceMixed) {
-      reflectance = fPreCalculatedReflectanceMixed->Interpolate(lam_vac, th_0.real());
-      transmittance = fPreCalculatedTransmittanceMixed->Interpolate(lam_vac, th_0.real());
+    if (fPreCalculatedTable) {
+      fPreCalculatedTable->Interpolate(lam_vac, th_0.real(), reflectance,
+                                       transmittance);
       return;
     }
-    Double_t r = 0;
-    Double_t t = 0;
-    CoherentTMMP(th_0, lam_vac, reflectance, transmittance);
-    r += reflectance;
-    t += transmittance;
-    CoherentTMMS(th_0, lam_vac, reflectance, transmittance);
-    r += reflectance;
-    t += transmittance;
-
-    reflectance = r / 2.;
-    transmittance = t / 2.;
+    Double_t rs, ts, rp, tp;
+    CoherentTMMMixed(th_0, lam_vac, reflectance, transmittance, rs, ts, rp, tp);
+  }
+  void CoherentTMMMixed(std::complex<Double_t> th_0, Double_t lam_vac,
+                        Double_t& reflectance, Double_t& transmittance,
+                        Double_t& reflectance_s, Double_t& transmittance_s,
+                        Double_t& reflectance_p,
+                        Double_t& transmittance_p) const {
+    // Always calculated without the precalculated tables because they have
+    // only the mixed values
+    CoherentTMMSP(th_0, lam_vac, reflectance_s, transmittance_s, reflectance_p,
+                  transmittance_p);
+    reflectance = (reflectance_p + reflectance_s) / 2.;
+    transmittance = (transmittance_p + transmittance_s) / 2.;
   }
   void IncoherentTMMMixed(std::complex<Double_t> th_0, Double_t lam_vac,
                         Double_t& reflectance, Double_t& transmittance) const {
-    if(fPreCalculatedReflectanceMixed and fPreCalculatedTransmittanceMixed) {
-      reflectance = fPreCalculatedReflectanceMixed->Interpolate(lam_vac, th_0.real());
-      transmittance = fPreCalculatedTransmittanceMixed->Interpolate(lam_vac, th_0.real());
+    if (fPreCalculatedTable) {
+      fPreCalculatedTable->Interpolate(lam_vac, th_0.real(), reflectance,
+                                       transmittance);
       return;
     }
     Double_t r = 0;
@@ -152,77 +185,35 @@ class AMultilayer : public TObject {
   void CoherentTMMMixed(std::vector<std::complex<Double_t>>& th_0,
                         Double_t lam_vac, std::vector<Double_t>& reflectance,
                         std::vector<Double_t>& transmittance) const {
-    auto n = th_0.size();
-    reflectance.resize(n);
-    transmittance.resize(n);
-    if(fPreCalculatedReflectanceMixed and fPreCalculatedTransmittanceMixed) {
-      for(std::size_t i = 0; i < n; ++i){
-        auto th = th_0[i].real();
-        reflectance[i] =  fPreCalculatedReflectanceMixed->Interpolate(lam_vac, th);
-        transmittance[i] = fPreCalculatedTransmittanceMixed->Interpolate(lam_vac, th);
-      }
-      return;
-    }
-
-    std::vector<std::thread> threads(fNthreads);
-
-    auto th_0_cbegin = th_0.cbegin();
-    auto th_0_cend = th_0.end();
-    auto reflectance_begin = reflectance.begin();
-    auto transmittance_begin = transmittance.begin();
-
-    auto step = n / fNthreads;
-
-    for (std::size_t i = 0; i < fNthreads; ++i) {
-      if (i == fNthreads - 1) {
-        threads[i] =
-            std::thread(&AMultilayer::CoherentTMMMixedMultiAngle, *this,
-                        th_0_cbegin, th_0_cbegin + step, lam_vac,
-                        reflectance_begin, transmittance_begin);
-        th_0_cbegin += step;
-      } else {
-        threads[i] = std::thread(&AMultilayer::CoherentTMMMixedMultiAngle,
-                                 *this, th_0_cbegin, th_0_cend, lam_vac,
-                                 reflectance_begin, transmittance_begin);
-      }
-    }
-    for (std::size_t i = 0; i < fNthreads; ++i) {
-      threads[i].join();
-    }
+    reflectance.resize(th_0.size());
+    transmittance.resize(th_0.size());
+    CoherentTMMMixedGrid(1, &lam_vac, th_0.size(), th_0.data(),
+                         reflectance.data(), transmittance.data());
   }
   void CoherentTMMMixed(std::complex<Double_t> th_0,
                         std::vector<Double_t>& lam_vac,
                         std::vector<Double_t>& reflectance,
                         std::vector<Double_t>& transmittance) const {
-    auto n = lam_vac.size();
-    reflectance.resize(n);
-    transmittance.resize(n);
-
-    std::vector<std::thread> threads(fNthreads);
-
-    auto lam_vac_cbegin = lam_vac.cbegin();
-    auto lam_vac_cend = lam_vac.end();
-    auto reflectance_begin = reflectance.begin();
-    auto transmittance_begin = transmittance.begin();
-
-    auto step = n / fNthreads;
-
-    for (std::size_t i = 0; i < fNthreads; ++i) {
-      if (i == fNthreads - 1) {
-        threads[i] =
-            std::thread(&AMultilayer::CoherentTMMMixedMultiWavelength, *this,
-                        th_0, lam_vac_cbegin, lam_vac_cbegin + step,
-                        reflectance_begin, transmittance_begin);
-        lam_vac_cbegin += step;
-      } else {
-        threads[i] = std::thread(&AMultilayer::CoherentTMMMixedMultiWavelength,
-                                 *this, th_0, lam_vac_cbegin, lam_vac_cend,
-                                 reflectance_begin, transmittance_begin);
-      }
-    }
-    for (std::size_t i = 0; i < fNthreads; ++i) {
-      threads[i].join();
-    }
+    reflectance.resize(lam_vac.size());
+    transmittance.resize(lam_vac.size());
+    CoherentTMMMixedGrid(lam_vac.size(), lam_vac.data(), 1, &th_0,
+                         reflectance.data(), transmittance.data());
+  }
+  void CoherentTMMMixedGrid(std::size_t n_lambda, const Double_t* lam_vac,
+                            std::size_t n_angle,
+                            const std::complex<Double_t>* th_0,
+                            Double_t* reflectance,
+                            Double_t* transmittance) const {
+    TMMMixedGrid(kTRUE, n_lambda, lam_vac, n_angle, th_0, reflectance,
+                 transmittance);
+  }
+  void IncoherentTMMMixedGrid(std::size_t n_lambda, const Double_t* lam_vac,
+                              std::size_t n_angle,
+                              const std::complex<Double_t>* th_0,
+                              Double_t* reflectance,
+                              Double_t* transmittance) const {
+    TMMMixedGrid(kFALSE, n_lambda, lam_vac, n_angle, th_0, reflectance,
+                 transmittance);
   }
   void CoherentTMMP(std::complex<Double_t> th_0, Double_t lam_vac,
                     Double_t& reflectance, Double_t& transmittance) const {
@@ -240,46 +231,30 @@ class AMultilayer : public TObject {
                     Double_t& reflectance, Double_t& transmittance) const {
     IncoherentTMM(kS, th_0, lam_vac, reflectance, transmittance);
   }
-  void PreCalculateCoherentTMM(Int_t lam_nbins, Double_t lam_min, Double_t lam_max,
-                               Int_t th_nbins, Double_t th_min, Double_t th_max) {
-    // make temporary objects because CoherentTMMMixed checks if
-    // fPreCalculstedXXX are null or not
-    auto preReflectanceMixed = std::make_shared<TH2D>("", "", lam_nbins, lam_min, lam_max, th_nbins, th_min, th_max);
-    auto preTransmittanceMixed = std::make_shared<TH2D>("", "", lam_nbins, lam_min, lam_max, th_nbins, th_min, th_max);
-    for (Int_t j = 1; j <= th_nbins; ++j) {
-      Double_t th = preReflectanceMixed->GetYaxis()->GetBinCenter(j);
-      for (Int_t i = 1; i <= lam_nbins; ++i) {
-        Double_t lam = preReflectanceMixed->GetXaxis()->GetBinCenter(i);
-        Double_t reflectance, transmittance;
-        CoherentTMMMixed(th, lam, reflectance, transmittance);
-        preReflectanceMixed->SetBinContent(i, j, reflectance);
-        preTransmittanceMixed->SetBinContent(i, j, transmittance);
-      }
-    }
-
-    fPreCalculatedReflectanceMixed = preReflectanceMixed;
-    fPreCalculatedTransmittanceMixed = preTransmittanceMixed;
+  void PreCalculateCoherentTMM(Int_t lam_nbins, Double_t lam_min,
+                               Double_t lam_max, Int_t th_nbins,
+                               Double_t th_min, Double_t th_max,
+                               Bool_t in_cosine = kFALSE) {
+    PreCalculateTMM(kTRUE, lam_nbins, lam_min, lam_max, th_nbins, th_min,
+                    th_max, in_cosine);
   }
-  void PreCalculateIncoherentTMM(Int_t lam_nbins, Double_t lam_min, Double_t lam_max,
-                                 Int_t th_nbins, Double_t th_min, Double_t th_max) {
-    // make temporary objects because CoherentTMMMixed checks if
-    // fPreCalculstedXXX are null or not
-    auto preReflectanceMixed = std::make_shared<TH2D>("", "", lam_nbins, lam_min, lam_max, th_nbins, th_min, th_max);
-    auto preTransmittanceMixed = std::make_shared<TH2D>("", "", lam_nbins, lam_min, lam_max, th_nbins, th_min, th_max);
-    for (Int_t j = 1; j <= th_nbins; ++j) {
-      Double_t th = preReflectanceMixed->GetYaxis()->GetBinCenter(j);
-      for (Int_t i = 1; i <= lam_nbins; ++i) {
-        Double_t lam = preReflectanceMixed->GetXaxis()->GetBinCenter(i);
-        Double_t reflectance, transmittance;
-        IncoherentTMMMixed(th, lam, reflectance, transmittance);
-        preReflectanceMixed->SetBinContent(i, j, reflectance);
-        preTransmittanceMixed->SetBinContent(i, j, transmittance);
-      }
-    }
-
-    fPreCalculatedReflectanceMixed = preReflectanceMixed;
-    fPreCalculatedTransmittanceMixed = preTransmittanceMixed;
+  void PreCalculateIncoherentTMM(Int_t lam_nbins, Double_t lam_min,
+                                 Double_t lam_max, Int_t th_nbins,
+                                 Double_t th_min, Double_t th_max,
+                                 Bool_t in_cosine = kFALSE) {
+    PreCalculateTMM(kFALSE, lam_nbins, lam_min, lam_max, th_nbins, th_min,
+                    th_max, in_cosine);
+  }
+  void ClearPreCalculation() {
+    fPreCalculatedTable.reset();
+    fPreCalculatedReflectanceMixed.reset();
+    fPreCalculatedTransmittanceMixed.reset();
+  }
+  std::shared_ptr<const AMultilayerTable> GetPreCalculatedTable() const {
+    return fPreCalculatedTable;
   }
+  const char* GetCacheDirectory() const { return fCacheDirectory.c_str(); }
+  void SetCacheDirectory(const char* dir) { fCacheDirectory = dir ? dir : ""; }
   const std::shared_ptr<const TH2D> GetPrecalculatedReflectanceMixed() const {
     return fPreCalculatedReflectanceMixed;
   }
@@ -297,7 +272,7 @@ class AMultilayer : public TObject {
   TGraph* MakeIndexGraph(Double_t lambda, std::size_t stack_index = 0) const;
   void SetNthreads(std::size_t n);
 
-  ClassDef(AMultilayer, 1)
+  ClassDef(AMultilayer, 2)
 };
 
 #endif  // A_MULTILAYER_H
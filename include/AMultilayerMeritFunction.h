@@ -0,0 +1,79 @@
+// Author: Akira Okumura <mailto:oxon@mac.com>
+/******************************************************************************
+ * Copyright (C) 2006-, Akira Okumura                                         *
+ * All rights reserved.                                                       *
+ *****************************************************************************/
+
+#ifndef A_MULTILAYER_MERIT_FUNCTION_H
+#define A_MULTILAYER_MERIT_FUNCTION_H
+
+#include <vector>
+
+#include "Math/IFunction.h"
+
+#include "AMultilayer.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// AMultilayerMeritFunction
+//
+// Merit function of multilayer thicknesses with analytic gradients
+//
+///////////////////////////////////////////////////////////////////////////////
+
+class AMultilayerMeritFunction : public ROOT::Math::IGradientFunctionMultiDim {
+ public:
+  enum EPolarization { kS = AMultilayer::kS, kP = AMultilayer::kP, kMixed };
+  enum EQuantity { kReflectance, kTransmittance };
+  enum ETargetType { kEqual, kAtLeast, kAtMost };
+
+ private:
+  struct ATarget {
+    Double_t fLambda;       // Wavelength
+    Double_t fAngle;        // Incident angle (rad)
+    EQuantity fQuantity;    // Reflectance or transmittance
+    Double_t fValue;        // Target value
+    ETargetType fType;      // Penalize both sides or only one side
+    Double_t fWeight;       // Weight of the squared deviation
+  };
+
+  AMultilayer* fMultilayer;      // Multilayer to be optimized (not owned)
+  std::vector<std::size_t> fLayers;  // Layers whose thicknesses are varied
+  Bool_t fCoherent;              // Use CoherentTMM instead of IncoherentTMM
+  EPolarization fPolarization;   // Polarization of the incident light
+  std::vector<ATarget> fTargets;
+
+  // The last gradient, which is reused by DoDerivative
+  mutable std::vector<Double_t> fLastX;
+  mutable std::vector<Double_t> fLastGradient;
+
+  void Calculate(const double* x, double& f, double* df) const;
+  void CalculateTMM(EPolarization polarization, Double_t lambda,
+                    Double_t angle, Double_t& reflectance,
+                    Double_t& transmittance,
+                    std::vector<Double_t>* reflectance_grad,
+                    std::vector<Double_t>* transmittance_grad) const;
+  virtual double DoDerivative(const double* x, unsigned int icoord) const;
+  virtual double DoEval(const double* x) const;
+
+ public:
+  AMultilayerMeritFunction(AMultilayer& multi,
+                           const std::vector<std::size_t>& layers,
+                           Bool_t coherent = kFALSE);
+  virtual ~AMultilayerMeritFunction();
+
+  void AddTarget(Double_t lambda, Double_t angle, EQuantity quantity,
+                 Double_t value, ETargetType type = kEqual,
+                 Double_t weight = 1.);
+  void ClearTargets() { fTargets.clear(); }
+  virtual ROOT::Math::IBaseFunctionMultiDim* Clone() const;
+  virtual void FdF(const double* x, double& f, double* df) const;
+  std::size_t GetNtargets() const { return fTargets.size(); }
+  virtual void Gradient(const double* x, double* grad) const;
+  virtual unsigned int NDim() const { return fLayers.size(); }
+  void SetPolarization(EPolarization polarization) {
+    fPolarization = polarization;
+  }
+};
+
+#endif  // A_MULTILAYER_MERIT_FUNCTION_H
@@ -0,0 +1,71 @@
+// Author: Akira Okumura <mailto:oxon@mac.com>
+/******************************************************************************
+ * Copyright (C) 2006-, Akira Okumura                                         *
+ * All rights reserved.                                                       *
+ *****************************************************************************/
+
+#ifndef A_MULTILAYER_TABLE_H
+#define A_MULTILAYER_TABLE_H
+
+#include <vector>
+
+#include "TObject.h"
+
+class TH2D;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// AMultilayerTable
+//
+// Dense table of reflectance and transmittance of a multilayer
+//
+///////////////////////////////////////////////////////////////////////////////
+
+class AMultilayerTable : public TObject {
+ private:
+  Int_t fNlambda;         // Number of wavelength nodes
+  Int_t fNangle;          // Number of angle nodes
+  Double_t fLambdaMin;    // Lower edge of the wavelength range
+  Double_t fLambdaMax;    // Upper edge of the wavelength range
+  Double_t fAngleMin;     // Lower edge of the angle range (rad)
+  Double_t fAngleMax;     // Upper edge of the angle range (rad)
+  Bool_t fInCosine;       // Angle nodes are equally spaced in cos(theta)
+  Double_t fX0;           // First wavelength node
+  Double_t fInvDx;        // Inverse of the wavelength step
+  Double_t fY0;           // First angle (or cosine) node
+  Double_t fInvDy;        // Inverse of the angle (or cosine) step
+  std::vector<Double_t> fValues;  // (R, T) pairs [i_lambda][i_angle]
+
+  TH2D* MakeHist(Int_t offset) const;
+
+ public:
+  AMultilayerTable();
+  AMultilayerTable(Int_t lam_nbins, Double_t lam_min, Double_t lam_max,
+                   Int_t th_nbins, Double_t th_min, Double_t th_max,
+                   Bool_t in_cosine = kFALSE);
+  virtual ~AMultilayerTable();
+
+  Double_t GetAngle(Int_t j) const;
+  Double_t GetAngleMax() const { return fAngleMax; }
+  Double_t GetAngleMin() const { return fAngleMin; }
+  Double_t GetLambda(Int_t i) const { return fX0 + i / fInvDx; }
+  Double_t GetLambdaMax() const { return fLambdaMax; }
+  Double_t GetLambdaMin() const { return fLambdaMin; }
+  Int_t GetNangle() const { return fNangle; }
+  Int_t GetNlambda() const { return fNlambda; }
+  Double_t* GetValues() { return fValues.data(); }
+  const Double_t* GetValues() const { return fValues.data(); }
+  void Interpolate(Double_t lambda, Double_t angle, Double_t& reflectance,
+                   Double_t& transmittance) const;
+  Bool_t IsInCosine() const { return fInCosine; }
+  TH2D* MakeReflectanceHist() const { return MakeHist(0); }
+  TH2D* MakeTransmittanceHist() const { return MakeHist(1); }
+  void Set(Int_t i, Int_t j, Double_t reflectance, Double_t transmittance) {
+    fValues[2 * (i * fNangle + j)] = reflectance;
+    fValues[2 * (i * fNangle + j) + 1] = transmittance;
+  }
+
+  ClassDef(AMultilayerTable, 1)
+};
+
+#endif  // A_MULTILAYER_TABLE_H
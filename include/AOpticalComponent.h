@@ -22,6 +22,7 @@
 class AOpticalComponent : public TGeoVolume {
  private:
   TObjArray* fBorderSurfaceConditionArray;
+  static ULong64_t fgBorderSurfaceConditionVersion;  //! Changes of conditions
 
  public:
   AOpticalComponent();
@@ -32,6 +33,12 @@ class AOpticalComponent : public TGeoVolume {
   void AddBorderSurfaceCondition(ABorderSurfaceCondition* condition);
   ABorderSurfaceCondition* FindBorderSurfaceCondition(
       AOpticalComponent* component2);
+  const TObjArray* GetBorderSurfaceConditions() const {
+    return fBorderSurfaceConditionArray;
+  }
+  static ULong64_t GetBorderSurfaceConditionVersion() {
+    return fgBorderSurfaceConditionVersion;
+  }
   TGeoMaterial* GetOpaqueVacuumMaterial() const;
   TGeoMaterial* GetTransparentVacuumMaterial() const;
   TGeoMedium* GetOpaqueVacuumMedium() const;
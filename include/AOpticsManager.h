@@ -7,6 +7,10 @@
 #ifndef A_OPTICS_MANAGER_H
 #define A_OPTICS_MANAGER_H
 
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
 #include "TGeoManager.h"
 #include "TMath.h"
 
@@ -16,6 +20,11 @@
 #include "AObscuration.h"
 #include "AOpticalComponent.h"
 #include "ARayArray.h"
+#include "ARayBatch.h"
+#include "ATraceContext.h"
+#include "ATraceStatistics.h"
+
+class AThreadPool;
 
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -26,20 +35,52 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 class AOpticsManager : public TGeoManager {
+  friend class ASequentialTracer;
+
  private:
   Int_t fLimit;                      // Maximum number of crossing calculations
   Bool_t fDisableFresnelReflection;  // disable Fresnel reflection
+  Int_t fRecording;                  // Recording policy of ray tracks
+  Bool_t fWeightedTracing;  // Losses reduce the photon weight (no roulette)
   TClass* fClassList[5];
+  Int_t fChunkSize;                  //! Number of rays per work-stealing chunk
+  ULong64_t fSeed;                   //! Seed of random numbers (0 = gRandom)
+  ULong64_t fNtraces;                //! Number of tracing calls since SetSeed
+  AThreadPool* fThreadPool;          //! Persistent tracing threads
+  std::vector<std::unique_ptr<ATraceContext>>
+      fWorkerContexts;  //! Context of each thread
+  std::unique_ptr<ATraceContext>
+      fCallerContext;  //! Context used without the thread pool
+  std::vector<Int_t> fVolumeTypes;  //! Optical type indexed by volume number
+  std::vector<Bool_t>
+      fHasBorderConditions;  //! Volume has border conditions (by number)
+  std::unordered_map<ULong64_t, ABorderSurfaceCondition*>
+      fBorderConditions;  //! Conditions indexed by pairs of volume numbers
+  ULong64_t fBorderConditionVersion;  //! Version used to build the table
+  ATraceStatistics fTraceStatistics;  //! Counters summed over tracing calls
 
-  static void* Thread(void* args);
+  void BuildBorderSurfaceConditions();
+  void BuildReflectanceGrids();
+  void BuildVolumeTypes();
+  Int_t ClassifyVolume(const TGeoVolume* volume) const;
+  void DeleteThreadPool();
+  ATraceContext& GetCallerContext();
+  TGeoNavigator* GetCallerNavigator();
+  AThreadPool* GetThreadPool(Int_t nthreads);
+  ATraceContext& GetWorkerContext(std::size_t worker);
+  void MergeTraceStatistics(ATraceContext& context);
+  ULong64_t NextTraceKey();
+  void PrepareTracing();
+  void TraceRay(ARay* ray, ATraceContext& context);
 
   void DoFresnel(Double_t n1, Double_t n2, Double_t k2, ARay& ray,
-                 TGeoNavigator* nav, TGeoNode* currentNode, TGeoNode* nextNode);
-  void DoReflection(Double_t n1, ARay& ray, TGeoNavigator* nav,
-                    TGeoNode* currentNode, TGeoNode* nextNode,
+                 ATraceContext& context, TGeoNode* nextNode,
+                 ABorderSurfaceCondition* condition);
+  void DoReflection(Double_t n1, ARay& ray, ATraceContext& context,
+                    TGeoNode* nextNode, ABorderSurfaceCondition* condition,
                     TVector3* normal = 0);
-  TVector3 GetFacetNormal(TGeoNavigator* nav, TGeoNode* currentNode,
-                          TGeoNode* nextNode);
+  TVector3 GetFacetNormal(ATraceContext& context,
+                          ABorderSurfaceCondition* condition);
 
  public:
   enum {
@@ -70,9 +111,27 @@ class AOpticsManager : public TGeoManager {
   static Double_t deg() { return TMath::DegToRad(); };
   static Double_t rad() { return 1.; }
 
+  void CloseGeometry(Option_t* option = "d");
   void DisableFresnelReflection(Bool_t disable) {
     fDisableFresnelReflection = disable;
   }
+  static Double_t FresnelReflectance(Double_t n1, Double_t n2, Double_t k2,
+                                     Double_t cos1);
+  ABorderSurfaceCondition* GetBorderSurfaceCondition(
+      const TGeoNode* node1, const TGeoNode* node2) const;
+  Int_t GetChunkSize() const { return fChunkSize; }
+  Int_t GetOpticalType(const TGeoNode* node) const {
+    if (!node) return kNull;
+    const TGeoVolume* volume = node->GetVolume();
+    Int_t i = volume->GetNumber();
+    return 0 <= i and i < (Int_t)fVolumeTypes.size() ? fVolumeTypes[i]
+                                                      : ClassifyVolume(volume);
+  }
+  Int_t GetRecording() const { return fRecording; }
+  ULong64_t GetSeed() const { return fSeed; }
+  const ATraceStatistics& GetTraceStatistics() const {
+    return fTraceStatistics;
+  }
   Bool_t IsFocalSurface(TGeoNode* node) const {
     return node ? node->GetVolume()->IsA() == fClassList[kFocus] : kFALSE;
   };
@@ -88,7 +147,13 @@ class AOpticsManager : public TGeoManager {
   Bool_t IsOpticalComponent(TGeoNode* node) const {
     return node ? node->GetVolume()->IsA() == fClassList[kOpt] : kFALSE;
   };
+  Bool_t IsWeightedTracing() const { return fWeightedTracing; }
+  void ResetTraceStatistics() { fTraceStatistics.Clear(); }
+  void SetChunkSize(Int_t n);
   void SetLimit(Int_t n);
+  void SetRecording(ARay::ERecording recording);
+  void SetSeed(ULong64_t seed);
+  void SetWeightedTracing(Bool_t weighted);
   void TraceNonSequential(ARay& ray);
   void TraceNonSequential(ARay* ray) {
     if (ray) TraceNonSequential(*ray);
@@ -97,9 +162,13 @@ class AOpticsManager : public TGeoManager {
   void TraceNonSequential(ARayArray* array) {
     if (array) TraceNonSequential(*array);
   }
+  void TraceNonSequential(ARayBatch& batch);
+  void TraceNonSequential(ARayBatch* batch) {
+    if (batch) TraceNonSequential(*batch);
+  }
   void TraceNonSequential(TObjArray* array);
 
-  ClassDef(AOpticsManager, 1)
+  ClassDef(AOpticsManager, 3)
 };
 
 #endif  // A_OPTICS_MANAGER_H
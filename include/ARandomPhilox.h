@@ -0,0 +1,42 @@
+// Author: Akira Okumura <mailto:oxon@mac.com>
+/******************************************************************************
+ * Copyright (C) 2006-, Akira Okumura                                         *
+ * All rights reserved.                                                       *
+ *****************************************************************************/
+
+#ifndef A_RANDOM_PHILOX_H
+#define A_RANDOM_PHILOX_H
+
+#include "TRandom.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// ARandomPhilox
+//
+// Counter-based random number generator (Philox4x32-10)
+//
+///////////////////////////////////////////////////////////////////////////////
+
+class ARandomPhilox : public TRandom {
+ private:
+  UInt_t fKey[2];      // Key (seed) of the stream
+  UInt_t fCounter[4];  // Counter of the next block
+  UInt_t fBuffer[4];   // Current block of random numbers
+  Int_t fIndex;        // Index of the next unused word in fBuffer
+
+  void Generate();
+
+ public:
+  explicit ARandomPhilox(ULong64_t seed = 0);
+  virtual ~ARandomPhilox();
+
+  virtual Double_t Rndm();
+  virtual void RndmArray(Int_t n, Float_t* array);
+  virtual void RndmArray(Int_t n, Double_t* array);
+  virtual void SetSeed(ULong_t seed = 0);
+  void SetStream(ULong64_t key, ULong64_t stream);
+
+  ClassDef(ARandomPhilox, 1)
+};
+
+#endif  // A_RANDOM_PHILOX_H
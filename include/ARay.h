@@ -7,6 +7,8 @@
 #ifndef A_RAY_H
 #define A_RAY_H
 
+#include <vector>
+
 #include "TColor.h"
 #include "TGeoNode.h"
 #include "TGeoTrack.h"
@@ -22,12 +24,18 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 class ARay : public TGeoTrack {
+ public:
+  enum EStatus { kRun, kStop, kExit, kFocus, kSuspend, kAbsorb };
+  enum ERecording { kRecordAll, kRecordEndpoints, kRecordLastPoint };
+
  private:
-  enum { kRun, kStop, kExit, kFocus, kSuspend, kAbsorb };
   Double_t fLambda;        // Wavelength
   TVector3 fDirection;     // Current direction vector
   Int_t fStatus;           // status of ray
   TObjArray fNodeHisotry;  // History of nodes on which the photon has hi
+  Int_t fNsteps;           // Number of boundary crossings
+  std::vector<Int_t> fVolumeHistory;  // Numbers of volumes the photon has hit
+  Double_t fWeight;  // Photon weight (reduced by losses in weighted tracing)
 
  public:
   ARay();
@@ -36,12 +44,18 @@ class ARay : public TGeoTrack {
   virtual ~ARay();
 
   void Absorb() { fStatus = kAbsorb; }
+  void AddStep(Double_t x, Double_t y, Double_t z, Double_t t, TGeoNode* node,
+               Int_t recording);
   void Exit() { fStatus = kExit; }
   void Focus() { fStatus = kFocus; }
   void GetDirection(Double_t* d) const;
   const TObjArray* GetNodeHistory() const { return &fNodeHisotry; }
   Double_t GetLambda() const { return fLambda; }
   void GetLastPoint(Double_t* x) const;
+  Int_t GetNsteps() const { return fNsteps; }
+  Int_t GetStatus() const { return fStatus; }
+  const std::vector<Int_t>& GetVolumeHistory() const { return fVolumeHistory; }
+  Double_t GetWeight() const { return fWeight; }
   void AddNode(TGeoNode* node) { fNodeHisotry.Add(node); }
   TGeoNode* FindNode(const char* name) const {
     return (TGeoNode*)fNodeHisotry.FindObject(name);
@@ -58,13 +72,18 @@ class ARay : public TGeoTrack {
   TColor* MakeColor() const;
 #endif
   TPolyLine3D* MakePolyLine3D() const;
+  void Reset(Double_t lambda, Double_t x, Double_t y, Double_t z, Double_t t,
+             Double_t dx, Double_t dy, Double_t dz);
   void SetDirection(Double_t dx, Double_t dy, Double_t dz);
   void SetDirection(Double_t* d);
   void SetLambda(Double_t lambda) { fLambda = lambda; }
+  void SetLastPoint(Double_t x, Double_t y, Double_t z, Double_t t);
+  void SetStatus(Int_t status) { fStatus = status; }
+  void SetWeight(Double_t weight) { fWeight = weight; }
   void Stop() { fStatus = kStop; }
   void Suspend() { fStatus = kSuspend; }
 
-  ClassDef(ARay, 1)
+  ClassDef(ARay, 3)
 };
 
 #endif  // A_RAY_H
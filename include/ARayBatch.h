@@ -0,0 +1,105 @@
+// Author: Akira Okumura <mailto:oxon@mac.com>
+/******************************************************************************
+ * Copyright (C) 2006-, Akira Okumura                                         *
+ * All rights reserved.                                                       *
+ *****************************************************************************/
+
+#ifndef A_RAY_BATCH_H
+#define A_RAY_BATCH_H
+
+#include <vector>
+
+#include "TObject.h"
+
+#include "ARay.h"
+#include "ARayArray.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// ARayBatch
+//
+// Batch of photons stored as a structure of arrays
+//
+///////////////////////////////////////////////////////////////////////////////
+
+class ARayBatch : public TObject {
+ private:
+  std::vector<Double_t> fX;       // X coordinate of the last point
+  std::vector<Double_t> fY;       // Y coordinate of the last point
+  std::vector<Double_t> fZ;       // Z coordinate of the last point
+  std::vector<Double_t> fT;       // Time at the last point
+  std::vector<Double_t> fDx;      // X component of the current direction
+  std::vector<Double_t> fDy;      // Y component of the current direction
+  std::vector<Double_t> fDz;      // Z component of the current direction
+  std::vector<Double_t> fLambda;  // Wavelength
+  std::vector<Double_t> fWeight;  // Photon weight
+  std::vector<Int_t> fStatus;     // Status of each ray (ARay::EStatus)
+
+ public:
+  ARayBatch();
+  virtual ~ARayBatch();
+
+  std::size_t Add(Double_t lambda, Double_t x, Double_t y, Double_t z,
+                  Double_t t, Double_t dx, Double_t dy, Double_t dz,
+                  Double_t weight = 1.);
+  void Add(const ARay& ray, Double_t weight = 1.);
+  virtual void Clear(Option_t* option = "");
+  std::size_t Count(Int_t status) const;
+  std::size_t GetN() const { return fStatus.size(); }
+
+  // Bulk access to the arrays
+  const Double_t* GetX() const { return fX.data(); }
+  const Double_t* GetY() const { return fY.data(); }
+  const Double_t* GetZ() const { return fZ.data(); }
+  const Double_t* GetT() const { return fT.data(); }
+  const Double_t* GetDx() const { return fDx.data(); }
+  const Double_t* GetDy() const { return fDy.data(); }
+  const Double_t* GetDz() const { return fDz.data(); }
+  const Double_t* GetLambda() const { return fLambda.data(); }
+  const Double_t* GetWeight() const { return fWeight.data(); }
+  const Int_t* GetStatus() const { return fStatus.data(); }
+
+  // Access to a single ray
+  void GetDirection(std::size_t i, Double_t* d) const {
+    d[0] = fDx[i];
+    d[1] = fDy[i];
+    d[2] = fDz[i];
+  }
+  Double_t GetLambda(std::size_t i) const { return fLambda[i]; }
+  void GetLastPoint(std::size_t i, Double_t* x) const {
+    x[0] = fX[i];
+    x[1] = fY[i];
+    x[2] = fZ[i];
+    x[3] = fT[i];
+  }
+  Int_t GetStatus(std::size_t i) const { return fStatus[i]; }
+  Double_t GetWeight(std::size_t i) const { return fWeight[i]; }
+  Bool_t IsAbsorbed(std::size_t i) const { return fStatus[i] == ARay::kAbsorb; }
+  Bool_t IsExited(std::size_t i) const { return fStatus[i] == ARay::kExit; }
+  Bool_t IsFocused(std::size_t i) const { return fStatus[i] == ARay::kFocus; }
+  Bool_t IsRunning(std::size_t i) const { return fStatus[i] == ARay::kRun; }
+  Bool_t IsStopped(std::size_t i) const { return fStatus[i] == ARay::kStop; }
+  Bool_t IsSuspended(std::size_t i) const {
+    return fStatus[i] == ARay::kSuspend;
+  }
+  void SetDirection(std::size_t i, const Double_t* d) {
+    fDx[i] = d[0];
+    fDy[i] = d[1];
+    fDz[i] = d[2];
+  }
+  void SetLastPoint(std::size_t i, const Double_t* x) {
+    fX[i] = x[0];
+    fY[i] = x[1];
+    fZ[i] = x[2];
+    fT[i] = x[3];
+  }
+  void SetStatus(std::size_t i, Int_t status) { fStatus[i] = status; }
+  void SetWeight(std::size_t i, Double_t weight) { fWeight[i] = weight; }
+
+  ARayArray* MakeRayArray() const;
+  void Reserve(std::size_t n);
+
+  ClassDef(ARayBatch, 1)
+};
+
+#endif  // A_RAY_BATCH_H
@@ -12,6 +12,7 @@
 #include "TVector3.h"
 
 #include "ARayArray.h"
+#include "ARayBatch.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -53,6 +54,34 @@ class ARayShooter : public TObject {
                            TGeoRotation* rot = 0, TGeoTranslation* tr = 0,
                            TVector3* v = 0);
 
+  // The same generators appending photons to an existing batch
+  static void Circle(ARayBatch& batch, Double_t lambda, Double_t rmax, Int_t nr,
+                     Int_t nphi, TGeoRotation* rot = 0, TGeoTranslation* tr = 0,
+                     TVector3* v = 0);
+  static void RandomCircle(ARayBatch& batch, Double_t lambda, Double_t rmax,
+                           Int_t n, TGeoRotation* rot = 0,
+                           TGeoTranslation* tr = 0, TVector3* v = 0);
+  static void RandomCone(ARayBatch& batch, Double_t lambda, Double_t r,
+                         Double_t d, Int_t n, TGeoRotation* rot = 0,
+                         TGeoTranslation* tr = 0);
+  static void RandomRectangle(ARayBatch& batch, Double_t lambda, Double_t dx,
+                              Double_t dy, Int_t n, TGeoRotation* rot = 0,
+                              TGeoTranslation* tr = 0, TVector3* v = 0);
+  static void RandomSphere(ARayBatch& batch, Double_t lambda, Int_t n,
+                           TGeoTranslation* tr = 0);
+  static void RandomSphericalCone(ARayBatch& batch, Double_t lambda, Int_t n,
+                                  Double_t theta, TGeoRotation* rot = 0,
+                                  TGeoTranslation* tr = 0);
+  static void RandomSquare(ARayBatch& batch, Double_t lambda, Double_t d,
+                           Int_t n, TGeoRotation* rot = 0,
+                           TGeoTranslation* tr = 0, TVector3* v = 0);
+  static void Rectangle(ARayBatch& batch, Double_t lambda, Double_t dx,
+                        Double_t dy, Int_t nx, Int_t ny, TGeoRotation* rot = 0,
+                        TGeoTranslation* tr = 0, TVector3* v = 0);
+  static void Square(ARayBatch& batch, Double_t lambda, Double_t d, Int_t n,
+                     TGeoRotation* rot = 0, TGeoTranslation* tr = 0,
+                     TVector3* v = 0);
+
   ClassDef(ARayShooter, 1)
 };
 
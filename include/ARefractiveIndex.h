@@ -13,6 +13,7 @@
 #include <complex>
 #include <limits>
 #include <memory>
+#include <vector>
 
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -23,20 +24,50 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 class ARefractiveIndex : public TObject {
+ private:
+  Double_t fFrozenLambdaMin;             //! Range of the frozen tables
+  Double_t fFrozenLambdaMax;             //!
+  Double_t fFrozenInvStep;               //! Inverse of the wavelength step
+  std::vector<Double_t> fFrozenIndex;    //! Tabulated refractive index
+  std::vector<Double_t> fFrozenExtinct;  //! Tabulated extinction coefficient
+
+  Double_t InterpolateFrozen(const std::vector<Double_t>& table,
+                             Double_t lambda) const {
+    Double_t t = (lambda - fFrozenLambdaMin) * fFrozenInvStep;
+    std::size_t i = (std::size_t)t;
+    if (i > table.size() - 2) i = table.size() - 2;  // lambda == max
+    return table[i] + (t - i) * (table[i + 1] - table[i]);
+  }
+
  protected:
   std::shared_ptr<TGraph> fRefractiveIndex;
   std::shared_ptr<TGraph> fExtinctionCoefficient;
 
+  Double_t GetFrozenExtinctionCoefficient(Double_t lambda) const {
+    return InterpolateFrozen(fFrozenExtinct, lambda);
+  }
+  Double_t GetFrozenRefractiveIndex(Double_t lambda) const {
+    return InterpolateFrozen(fFrozenIndex, lambda);
+  }
+  Bool_t IsInFrozenRange(Double_t lambda) const {
+    return not fFrozenIndex.empty() and fFrozenLambdaMin <= lambda and
+           lambda <= fFrozenLambdaMax;
+  }
+
  public:
-  ARefractiveIndex(){};
+  ARefractiveIndex()
+      : fFrozenLambdaMin(0), fFrozenLambdaMax(0), fFrozenInvStep(0){};
   ARefractiveIndex(Double_t n, Double_t k = 0.);
   virtual ~ARefractiveIndex(){};
 
+  void Freeze(Double_t lambda_min, Double_t lambda_max, Int_t n);
   virtual Double_t GetAbbeNumber() const;
   virtual Double_t GetRefractiveIndex(Double_t lambda) const {
+    if (IsInFrozenRange(lambda)) return GetFrozenRefractiveIndex(lambda);
     return fRefractiveIndex ? fRefractiveIndex->Eval(lambda) : 1.;
   }
   virtual Double_t GetExtinctionCoefficient(Double_t lambda) const {
+    if (IsInFrozenRange(lambda)) return GetFrozenExtinctionCoefficient(lambda);
     return fExtinctionCoefficient ? fExtinctionCoefficient->Eval(lambda) : 0.;
   }
   virtual Double_t GetAbsorptionLength(Double_t lambda) const {
@@ -46,15 +77,29 @@ class ARefractiveIndex : public TObject {
   }
   virtual std::complex<Double_t> GetComplexRefractiveIndex(
       Double_t lambda) const {
+    if (IsInFrozenRange(lambda)) {
+      return std::complex<Double_t>(GetFrozenRefractiveIndex(lambda),
+                                    GetFrozenExtinctionCoefficient(lambda));
+    }
     return std::complex<Double_t>(GetRefractiveIndex(lambda),
                                   GetExtinctionCoefficient(lambda));
   }
+  void GetComplexRefractiveIndices(Int_t n, const Double_t* lambda,
+                                   std::complex<Double_t>* index) const;
+  void GetExtinctionCoefficients(Int_t n, const Double_t* lambda,
+                                 Double_t* k) const;
+  void GetRefractiveIndices(Int_t n, const Double_t* lambda,
+                            Double_t* index) const;
+  Bool_t IsFrozen() const { return not fFrozenIndex.empty(); }
   virtual void SetExtinctionCoefficient(std::shared_ptr<TGraph> graph) {
+    Unfreeze();
     fExtinctionCoefficient = graph;
   }
   virtual void SetRefractiveIndex(std::shared_ptr<TGraph> graph) {
+    Unfreeze();
     fRefractiveIndex = graph;
   }
+  void Unfreeze();
   static Double_t AbsorptionLengthToExtinctionCoefficient(Double_t a,
                                                           Double_t lambda) {
     return lambda / (4 * TMath::Pi() * a);
@@ -0,0 +1,66 @@
+// Author: Akira Okumura <mailto:oxon@mac.com>
+/******************************************************************************
+ * Copyright (C) 2006-, Akira Okumura                                         *
+ * All rights reserved.                                                       *
+ *****************************************************************************/
+
+#ifndef A_SEQUENTIAL_TRACER_H
+#define A_SEQUENTIAL_TRACER_H
+
+#include <vector>
+
+#include "TGeoMatrix.h"
+
+#include "ABorderSurfaceCondition.h"
+#include "AOpticsManager.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// ASequentialTracer
+//
+// Sequential ray tracer for optical systems with a known surface order
+//
+///////////////////////////////////////////////////////////////////////////////
+
+class ASequentialTracer : public TObject {
+ private:
+  // A surface that can be hit in a stage
+  struct ASurface {
+    TGeoNode* fNode;                       // Node of the component
+    Int_t fType;                           // AOpticsManager::kMirror etc.
+    TGeoHMatrix fMatrix;                   // Local-to-top matrix of the node
+    ABorderSurfaceCondition* fCondition;   // Condition with the mother volume
+  };
+
+  AOpticsManager* fManager;                 // Manager of the geometry
+  std::vector<std::vector<ASurface>> fStages;  // Surfaces of each stage
+  std::size_t fNfallback;  // Photons handed to the manager in the last call
+
+  const ASurface* FindNearestSurface(const std::vector<ASurface>& stage,
+                                     const Double_t* x, const Double_t* d,
+                                     Double_t& dist) const;
+  void GetNormal(const ASurface& surface, const Double_t* x,
+                 const Double_t* d, Double_t* n) const;
+  Bool_t Refract(Double_t n1, Double_t n2, Double_t k2, const Double_t* n,
+                 Double_t* d, ATraceContext& context) const;
+  Int_t TracePhoton(Double_t lambda, Double_t* x, Double_t* d,
+                    Double_t& weight, ATraceContext& context) const;
+
+ public:
+  ASequentialTracer(AOpticsManager* manager);
+  virtual ~ASequentialTracer();
+
+  void AddStage();
+  Bool_t AddSurface(const char* path);
+  void ClearStages() { fStages.clear(); }
+  std::size_t GetNfallback() const { return fNfallback; }
+  std::size_t GetNstages() const { return fStages.size(); }
+  void Trace(ARayBatch& batch);
+  void Trace(ARayBatch* batch) {
+    if (batch) Trace(*batch);
+  }
+
+  ClassDef(ASequentialTracer, 0)
+};
+
+#endif  // A_SEQUENTIAL_TRACER_H
@@ -0,0 +1,73 @@
+// Author: Akira Okumura <mailto:oxon@mac.com>
+/******************************************************************************
+ * Copyright (C) 2006-, Akira Okumura                                         *
+ * All rights reserved.                                                       *
+ *****************************************************************************/
+
+#ifndef A_THREAD_POOL_H
+#define A_THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Rtypes.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// AThreadPool
+//
+// Persistent pool of worker threads with work stealing
+//
+///////////////////////////////////////////////////////////////////////////////
+
+class AThreadPool {
+ public:
+  // func(worker, begin, end) processes the items [begin, end) on the worker
+  // thread whose index is "worker" (0 <= worker < GetNthreads())
+  typedef std::function<void(std::size_t, std::size_t, std::size_t)> Task_t;
+
+ private:
+  // Range of chunk indices [fFront, fBack) owned by a worker. The owner takes
+  // chunks from the front, and idle workers steal them from the back.
+  struct AChunkQueue {
+    std::mutex fMutex;
+    std::size_t fFront;
+    std::size_t fBack;
+  };
+
+  std::vector<std::thread> fThreads;
+  std::vector<std::unique_ptr<AChunkQueue>> fQueues;
+
+  std::mutex fCallMutex;  // serializes ParallelFor calls
+  std::mutex fMutex;      // protects the job state below
+  std::condition_variable fWakeUp;
+  std::condition_variable fDone;
+  const Task_t* fTask;
+  std::size_t fN;
+  std::size_t fChunkSize;
+  std::size_t fGeneration;
+  std::size_t fNactive;
+  Bool_t fStop;
+  std::exception_ptr fException;
+
+  Bool_t PopChunk(std::size_t worker, std::size_t& chunk);
+  void RunChunks(std::size_t worker);
+  void WorkerLoop(std::size_t worker);
+
+ public:
+  explicit AThreadPool(std::size_t nthreads);
+  AThreadPool(const AThreadPool&) = delete;
+  AThreadPool& operator=(const AThreadPool&) = delete;
+  virtual ~AThreadPool();
+
+  std::size_t GetNthreads() const { return fThreads.size(); }
+  void ParallelFor(std::size_t n, std::size_t chunk, const Task_t& func);
+};
+
+#endif  // A_THREAD_POOL_H
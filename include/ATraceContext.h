@@ -0,0 +1,69 @@
+// Author: Akira Okumura <mailto:oxon@mac.com>
+/******************************************************************************
+ * Copyright (C) 2006-, Akira Okumura                                         *
+ * All rights reserved.                                                       *
+ *****************************************************************************/
+
+#ifndef A_TRACE_CONTEXT_H
+#define A_TRACE_CONTEXT_H
+
+#include <vector>
+
+#include "TGeoNavigator.h"
+
+#include "ALens.h"
+#include "ARandomPhilox.h"
+#include "ARay.h"
+#include "ATraceStatistics.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// ATraceContext
+//
+// State owned by a single tracing thread
+//
+///////////////////////////////////////////////////////////////////////////////
+
+class ATraceContext {
+ private:
+  // Optical constants of a lens at the wavelength fLambda
+  struct ALensConstants {
+    Double_t fLambda;
+    Double_t fN;
+    Double_t fK;
+    Double_t fAbsorptionLength;
+  };
+
+  TGeoNavigator* fNavigator;  // Navigator used only by this thread
+  ARandomPhilox fRandom;      // Random number generator of the current ray
+  ARay fScratchRay;           // Reused for the photons of ARayBatch
+  std::vector<ALensConstants> fLensConstants;  // Indexed by volume number
+  ALensConstants fUnregistered;  // Used for a lens without volume number
+  ATraceStatistics fStatistics;  // Counters of this thread
+
+  const ALensConstants& GetLensConstants(const ALens* lens, Double_t lambda);
+
+ public:
+  explicit ATraceContext(TGeoNavigator* nav);
+  virtual ~ATraceContext();
+
+  void ClearCache() { fLensConstants.clear(); }
+  Double_t GetAbsorptionLength(const ALens* lens, Double_t lambda) {
+    return GetLensConstants(lens, lambda).fAbsorptionLength;
+  }
+  Double_t GetExtinctionCoefficient(const ALens* lens, Double_t lambda) {
+    return GetLensConstants(lens, lambda).fK;
+  }
+  TGeoNavigator* GetNavigator() const { return fNavigator; }
+  TRandom& GetRandom() { return fRandom; }
+  ARay& GetScratchRay() { return fScratchRay; }
+  ATraceStatistics& GetStatistics() { return fStatistics; }
+  Double_t GetRefractiveIndex(const ALens* lens, Double_t lambda) {
+    return GetLensConstants(lens, lambda).fN;
+  }
+  void StartRay(ULong64_t key, ULong64_t index) {
+    fRandom.SetStream(key, index);
+  }
+};
+
+#endif  // A_TRACE_CONTEXT_H
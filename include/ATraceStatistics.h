@@ -0,0 +1,134 @@
+// Author: Akira Okumura <mailto:oxon@mac.com>
+/******************************************************************************
+ * Copyright (C) 2006-, Akira Okumura                                         *
+ * All rights reserved.                                                       *
+ *****************************************************************************/
+
+#ifndef A_TRACE_STATISTICS_H
+#define A_TRACE_STATISTICS_H
+
+#include <chrono>
+#include <vector>
+
+#include "TGeoNode.h"
+#include "TGeoVolume.h"
+#include "TObject.h"
+#include "TString.h"
+
+#include "ARay.h"
+
+class TCollection;
+class TH1D;
+class TObjArray;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// ATraceStatistics
+//
+// Step, handler and timing counters of the tracing kernel
+//
+///////////////////////////////////////////////////////////////////////////////
+
+class ATraceStatistics : public TObject {
+ public:
+  enum EHandler {
+    kReflection,
+    kFresnel,
+    kMultilayer,
+    kFocalSurface,
+    kNhandlers
+  };
+  enum ETimer { kNavigation, kSurfacePhysics, kIndexLookup, kNtimers };
+  enum { kNstatus = ARay::kAbsorb + 1 };
+
+ private:
+  ULong64_t fNrays[kNstatus];           // Traced rays by final status
+  ULong64_t fNcalls[kNhandlers];        // Calls of each boundary handler
+  ULong64_t fTime[kNtimers];            // Cumulative time of each part (ns)
+  ULong64_t fNstepsOutside;             // Steps starting outside the top
+  std::vector<ULong64_t> fNsteps;       // Steps by volume number
+  std::vector<ULong64_t> fStepsPerRay;  // Rays by number of steps
+  std::vector<TString> fVolumeNames;    // Volume names by number
+  Long64_t fStart[kNtimers];            //! Start time of each timer (ns)
+  Int_t fNstepsAtStart;                 //! Steps of the ray before tracing
+
+  static Long64_t Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+ public:
+  ATraceStatistics();
+  virtual ~ATraceStatistics();
+
+  void Add(const ATraceStatistics& other);
+  virtual void Clear(Option_t* option = "");
+  void CountHandler(EHandler handler) { ++fNcalls[handler]; }
+  void CountRay(Int_t status) {
+    if (0 <= status and status < kNstatus) {
+      ++fNrays[status];
+    }
+  }
+  void CountStep(const TGeoNode* node) {
+    Int_t i = node ? node->GetVolume()->GetNumber() : -1;
+    if (i < 0) {
+      ++fNstepsOutside;
+      return;
+    }
+    if ((std::size_t)i >= fNsteps.size()) {
+      fNsteps.resize(i + 1, 0);
+    }
+    ++fNsteps[i];
+  }
+  void EndRay(const ARay& ray);
+  ULong64_t GetNcalls(EHandler handler) const { return fNcalls[handler]; }
+  ULong64_t GetNrays() const;
+  ULong64_t GetNrays(Int_t status) const {
+    return 0 <= status and status < kNstatus ? fNrays[status] : 0;
+  }
+  ULong64_t GetNsteps(Int_t number) const {
+    return 0 <= number and (std::size_t)number < fNsteps.size()
+               ? fNsteps[number]
+               : 0;
+  }
+  ULong64_t GetNstepsOutside() const { return fNstepsOutside; }
+  const std::vector<ULong64_t>& GetStepsPerRay() const { return fStepsPerRay; }
+  Double_t GetTime(ETimer timer) const { return fTime[timer] * 1e-9; }
+  static Bool_t IsEnabled();
+  TH1D* MakeStepsPerRayHist(const char* name = "stepsPerRay") const;
+  Long64_t Merge(TCollection* list);
+  virtual void Print(Option_t* option = "") const;
+  void SetVolumeNames(const TObjArray* volumes);
+  void StartRay(const ARay& ray) { fNstepsAtStart = ray.GetNsteps(); }
+  void StartTimer(ETimer timer) { fStart[timer] = Now(); }
+  void StopTimer(ETimer timer) { fTime[timer] += Now() - fStart[timer]; }
+  TString ToJSON() const;
+  Bool_t WriteJSON(const char* filename) const;
+
+  ClassDef(ATraceStatistics, 1)
+};
+
+// Hooks used in the tracing kernel. They expand to nothing unless ROBAST is
+// built with ROBAST_INSTRUMENTATION defined (make ROBASTFLAGS=-D...).
+#ifdef ROBAST_INSTRUMENTATION
+#define ROBAST_STATS(context, call) (context).GetStatistics().call
+#else
+#define ROBAST_STATS(context, call) ((void)0)
+#endif
+
+#define ROBAST_STATS_COUNT_HANDLER(context, handler) \
+  ROBAST_STATS(context, CountHandler(ATraceStatistics::handler))
+#define ROBAST_STATS_COUNT_RAY(context, status) \
+  ROBAST_STATS(context, CountRay(status))
+#define ROBAST_STATS_COUNT_STEP(context, node) \
+  ROBAST_STATS(context, CountStep(node))
+#define ROBAST_STATS_END_RAY(context, ray) ROBAST_STATS(context, EndRay(ray))
+#define ROBAST_STATS_START_RAY(context, ray) \
+  ROBAST_STATS(context, StartRay(ray))
+#define ROBAST_STATS_START_TIMER(context, timer) \
+  ROBAST_STATS(context, StartTimer(ATraceStatistics::timer))
+#define ROBAST_STATS_STOP_TIMER(context, timer) \
+  ROBAST_STATS(context, StopTimer(ATraceStatistics::timer))
+
+#endif  // A_TRACE_STATISTICS_H
@@ -18,27 +18,35 @@
 #pragma link C++ class ACorsikaIACTFile;
 #pragma link C++ class ACorsikaIACTRunHeader;
 #pragma link C++ class AFilmetrixDotCom;
-#pragma link C++ class AFocalSurface;
-#pragma link C++ class AGeoAsphericDisk;
+#pragma link C++ class AFocalSurface-;
+#pragma link C++ class AGeoAsphericDisk-;
+#pragma link C++ class AGeoBezierCone-;
+#pragma link C++ class AGeoBezierConePoly-;
 #pragma link C++ class AGeoBezierPcon;
 #pragma link C++ class AGeoBezierPgon;
-#pragma link C++ class AGeoWinstonCone2D;
-#pragma link C++ class AGeoWinstonConePoly;
+#pragma link C++ class AGeoWinstonCone2D-;
+#pragma link C++ class AGeoWinstonConePoly-;
 #pragma link C++ class AGlassCatalog;
 #pragma link C++ class ALens;
 #pragma link C++ class AMirror;
 #pragma link C++ class AMixedRefractiveIndex;
 #pragma link C++ class AMultilayer;
+#pragma link C++ class AMultilayerMeritFunction;
+#pragma link C++ class AMultilayerTable;
 #pragma link C++ class AObscuration;
 #pragma link C++ class AOpticalComponent;
 #pragma link C++ class AOpticsManager;
+#pragma link C++ class ARandomPhilox;
 #pragma link C++ class ARay;
 #pragma link C++ class ARayArray;
+#pragma link C++ class ARayBatch;
 #pragma link C++ class ARayShooter;
 #pragma link C++ class ARefractiveIndex;
 #pragma link C++ class ARefractiveIndexDotInfo;
 #pragma link C++ class ASchottFormula;
 #pragma link C++ class ASellmeierFormula;
+#pragma link C++ class ASequentialTracer;
+#pragma link C++ class ATraceStatistics;
 
 // for automatic loading
 #ifdef MAKE_MAPS
@@ -0,0 +1,350 @@
+/******************************************************************************
+ * Copyright (C) 2006-, Akira Okumura                                         *
+ * All rights reserved.                                                       *
+ *****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// ABezierProfile
+//
+// Polynomial form of the Bezier curve (r(u), z(u)), 0 <= u <= 1, which gives
+// the side surfaces of AGeoBezierCone and AGeoBezierConePoly. The curve starts
+// at (r2, -dz) and ends at (r1, +dz), and z(u) must increase monotonically so
+// that the radius is a function of z.
+//
+// A ray crosses a face of a polygonal surface where a polynomial of u of the
+// same degree as the curve becomes zero, and crosses a surface of revolution
+// where a polynomial of twice the degree does. Their real roots in [0, 1] are
+// isolated by those of the derivatives, and then are bracketed.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ABezierProfile.h"
+
+#include "TMath.h"
+
+//_____________________________________________________________________________
+ABezierProfile::ABezierProfile()
+    : fDegree(1), fDZ(0), fRmax(0), fSlopeMax(0) {
+  for (Int_t i = 0; i < 4; i++) {
+    fR[i] = 0;
+    fZ[i] = 0;
+  }
+}
+
+//_____________________________________________________________________________
+Int_t ABezierProfile::CrossFace(Double_t q, Double_t w, Double_t z0,
+                                Double_t dz, Double_t* u, Double_t* t) const {
+  // Find the crossings of a ray with a face s = r(u) at z = z(u), where s is
+  // the coordinate along the normal of the face in the XY plane. The ray
+  // starts at (s, z) = (q, z0) with the direction (w, dz). Substituting
+  // t = (z(u) - z0)/dz to q + w t = r(u) gives a polynomial of degree
+  // fDegree. Return the number of crossings, and fill their curve parameters
+  // and distances along the ray.
+  Double_t h[4];
+  for (Int_t i = 0; i < 4; i++) {
+    h[i] = w * fZ[i] - dz * fR[i];
+  }
+  h[0] += q * dz - w * z0;
+
+  Int_t n = FindRoots(fDegree, h, u);
+  for (Int_t i = 0; i < n; i++) {
+    t[i] = TMath::Abs(w) > TMath::Abs(dz) ? (GetR(u[i]) - q) / w
+                                          : (GetZ(u[i]) - z0) / dz;
+  }
+
+  return n;
+}
+
+//_____________________________________________________________________________
+Int_t ABezierProfile::CrossRevolved(const Double_t* point, const Double_t* dir,
+                                    Double_t* u, Double_t* t) const {
+  // Find the crossings of a ray with the surface of revolution
+  // x^2 + y^2 = r(u)^2 at z = z(u). Return the number of crossings (<= 6), and
+  // fill their curve parameters and distances along the ray.
+  Double_t a = dir[0] * dir[0] + dir[1] * dir[1];
+  Double_t b = point[0] * dir[0] + point[1] * dir[1];
+  Double_t c = point[0] * point[0] + point[1] * point[1];
+  Double_t dz = dir[2];
+  Int_t n = 0;
+
+  if (dz * dz >= 1e-6 * a) {
+    // Substituting t = w/dz, where w = z(u) - z0, to a t^2 + 2b t + c = r^2
+    // gives a w^2 + 2b dz w + (c - r^2) dz^2 = 0 of degree 2 fDegree
+    Double_t w[4] = {fZ[0] - point[2], fZ[1], fZ[2], fZ[3]};
+    Double_t g[7] = {c * dz * dz, 0, 0, 0, 0, 0, 0};
+    for (Int_t i = 0; i <= fDegree; i++) {
+      g[i] += 2 * b * dz * w[i];
+      for (Int_t j = 0; j <= fDegree; j++) {
+        g[i + j] += a * w[i] * w[j] - dz * dz * fR[i] * fR[j];
+      }
+    }
+
+    n = FindRoots(2 * fDegree, g, u);
+    for (Int_t i = 0; i < n; i++) {
+      t[i] = (GetZ(u[i]) - point[2]) / dz;
+      if (dz * dz < a) {
+        // The radial equation determines t better for shallow rays
+        Double_t r = GetR(u[i]);
+        Double_t sq = TMath::Sqrt(TMath::Max(0., b * b - a * (c - r * r)));
+        Double_t t1 = (-b - sq) / a;
+        Double_t t2 = (-b + sq) / a;
+        t[i] = TMath::Abs(t1 - t[i]) < TMath::Abs(t2 - t[i]) ? t1 : t2;
+      }
+    }
+
+    return n;
+  }
+
+  // z changes little along a nearly horizontal ray, and the above polynomial
+  // becomes ill-conditioned. Instead, solve a t^2 + 2b t + c = r^2 for the
+  // nearer and farther crossings repeatedly with r updated at the new z.
+  for (Int_t sign = -1; sign <= 1; sign += 2) {
+    Double_t tt = 0;
+    Double_t z = TMath::Max(-fDZ, TMath::Min(fDZ, point[2]));
+    Bool_t converged = kFALSE;
+    for (Int_t i = 0; i < 50; i++) {
+      Double_t r = CalcR(TMath::Max(-fDZ, TMath::Min(fDZ, z)));
+      Double_t disc = b * b - a * (c - r * r);
+      if (disc < 0) {
+        break;
+      }
+      Double_t tnew = (-b + sign * TMath::Sqrt(disc)) / a;
+      z = point[2] + tnew * dz;
+      converged = TMath::Abs(tnew - tt) <= 1e-12 * (TMath::Abs(tnew) + fDZ);
+      tt = tnew;
+      if (converged) {
+        break;
+      }
+    }
+    if (converged and TMath::Abs(z) <= fDZ) {
+      u[n] = FindU(z);
+      t[n] = tt;
+      n++;
+    }
+  }
+
+  return n;
+}
+
+//_____________________________________________________________________________
+Int_t ABezierProfile::FindRoots(Int_t n, const Double_t* c, Double_t* roots) {
+  // Find the real roots of Sum c[k] u^k (n <= 6) in [0, 1] in increasing
+  // order. The roots of the derivative split [0, 1] into intervals in which
+  // the polynomial is monotonic, and a root in each interval is found by the
+  // Newton method safeguarded by bisection.
+  Double_t cmax = 0;
+  for (Int_t i = 0; i <= n; i++) {
+    cmax = TMath::Max(cmax, TMath::Abs(c[i]));
+  }
+  while (n > 0 and TMath::Abs(c[n]) <= 1e-13 * cmax) {
+    n--;  // negligible leading coefficient
+  }
+  if (n == 0) {
+    return 0;
+  }
+
+  Double_t deriv[6];
+  for (Int_t i = 0; i < n; i++) {
+    deriv[i] = (i + 1) * c[i + 1];
+  }
+  Double_t edge[8];
+  edge[0] = 0;
+  Int_t nedges = 1 + FindRoots(n - 1, deriv, &edge[1]);
+  edge[nedges++] = 1;
+
+  Int_t nroots = 0;
+  Double_t flo = Polynomial(n, c, 0);
+  if (flo == 0) {
+    roots[nroots++] = 0;
+  }
+  for (Int_t i = 0; i < nedges - 1; i++) {
+    Double_t lo = edge[i];
+    Double_t hi = edge[i + 1];
+    Double_t fhi = Polynomial(n, c, hi);
+    if (fhi == 0) {
+      if (nroots == 0 or roots[nroots - 1] < hi) {
+        roots[nroots++] = hi;
+      }
+    } else if (flo != 0 and (flo < 0) != (fhi < 0)) {
+      Double_t sign = flo;
+      Double_t u = (lo + hi) / 2;
+      for (Int_t j = 0; j < 100; j++) {
+        Double_t df;
+        Double_t f = Polynomial(n, c, u, &df);
+        if (f == 0) {
+          break;
+        } else if ((f < 0) == (sign < 0)) {
+          lo = u;
+        } else {
+          hi = u;
+        }
+        Double_t next = u - f / df;
+        if (not(lo < next and next < hi)) {
+          next = (lo + hi) / 2;  // also when df = 0
+        }
+        Double_t step = TMath::Abs(next - u);
+        u = next;
+        if (step <= 1e-15 or hi - lo <= 1e-15) {
+          break;
+        }
+      }
+      roots[nroots++] = u;
+    }
+    flo = fhi;
+  }
+
+  return nroots;
+}
+
+//_____________________________________________________________________________
+Double_t ABezierProfile::FindU(Double_t z) const {
+  // Find u which gives z(u) = z. z is limited in [-fDZ, +fDZ].
+  if (z <= -fDZ) {
+    return 0;
+  } else if (z >= fDZ) {
+    return 1;
+  } else if (fDegree == 1) {
+    return (z - fZ[0]) / fZ[1];
+  }
+
+  Double_t lo = 0;
+  Double_t hi = 1;
+  Double_t u = (z + fDZ) / (2 * fDZ);
+  for (Int_t i = 0; i < 100; i++) {
+    Double_t f = GetZ(u) - z;
+    if (f == 0) {
+      break;
+    } else if (f < 0) {
+      lo = u;
+    } else {
+      hi = u;
+    }
+    Double_t next = u - f / GetdZ(u);
+    if (not(lo < next and next < hi)) {
+      next = (lo + hi) / 2;
+    }
+    Double_t step = TMath::Abs(next - u);
+    u = next;
+    if (step <= 1e-15 or hi - lo <= 1e-15) {
+      break;
+    }
+  }
+
+  return u;
+}
+
+//_____________________________________________________________________________
+Double_t ABezierProfile::GetSquareIntegral() const {
+  // Integral of r^2 dz over the curve. Pi times this is the volume of the
+  // surface of revolution.
+  Double_t integral = 0;
+  for (Int_t i = 0; i <= fDegree; i++) {
+    for (Int_t j = 0; j <= fDegree; j++) {
+      for (Int_t k = 1; k <= fDegree; k++) {
+        // r(u)^2 dz/du contains fR[i] fR[j] k fZ[k] u^(i + j + k - 1)
+        integral += fR[i] * fR[j] * k * fZ[k] / (i + j + k);
+      }
+    }
+  }
+
+  return integral;
+}
+
+//_____________________________________________________________________________
+Double_t ABezierProfile::Polynomial(Int_t n, const Double_t* c, Double_t u,
+                                    Double_t* deriv) {
+  // Evaluate Sum c[k] u^k and its derivative with the Horner method
+  Double_t f = c[n];
+  Double_t df = 0;
+  for (Int_t i = n - 1; i >= 0; i--) {
+    df = df * u + f;
+    f = f * u + c[i];
+  }
+  if (deriv) {
+    *deriv = df;
+  }
+
+  return f;
+}
+
+//_____________________________________________________________________________
+Bool_t ABezierProfile::Set(Double_t r1, Double_t r2, Double_t dz,
+                           Int_t ncontrol, const TVector2& p1,
+                           const TVector2& p2) {
+  // Set the curve from (r2, -dz) to (r1, +dz). The control points p1 and p2
+  // are given in the relative coordinates as in AGeoBezierPcon, and ncontrol
+  // (0, 1, or 2) of them are used. Return kFALSE if z(u) does not increase
+  // monotonically.
+  fDegree = ncontrol == 1 ? 2 : (ncontrol == 2 ? 3 : 1);
+  fDZ = dz;
+
+  // Relative coordinates of the control points from P0 = (0, 0) to (1, 1)
+  Double_t px[4] = {0, 1, 0, 0};
+  Double_t py[4] = {0, 1, 0, 0};
+  if (fDegree >= 2) {
+    px[1] = p1.X();
+    py[1] = p1.Y();
+    px[fDegree] = 1;
+    py[fDegree] = 1;
+  }
+  if (fDegree == 3) {
+    px[2] = p2.X();
+    py[2] = p2.Y();
+  }
+
+  // Bernstein polynomials to the power basis
+  // c[k] = nCk Sum_i (-1)^(k - i) kCi p[i]
+  const Double_t kBinom[4][4] = {
+      {1, 0, 0, 0}, {1, 1, 0, 0}, {1, 2, 1, 0}, {1, 3, 3, 1}};
+  for (Int_t k = 0; k < 4; k++) {
+    Double_t cx = 0;
+    Double_t cy = 0;
+    for (Int_t i = 0; i <= k and k <= fDegree; i++) {
+      Double_t sign = (k - i) % 2 == 0 ? 1 : -1;
+      cx += sign * kBinom[k][i] * px[i];
+      cy += sign * kBinom[k][i] * py[i];
+    }
+    Double_t binom = k <= fDegree ? kBinom[fDegree][k] : 0;
+    fR[k] = binom * cx * (r1 - r2);
+    fZ[k] = binom * cy * 2 * dz;
+  }
+  fR[0] += r2;
+  fZ[0] -= dz;
+
+  // The maximum radius is at either end or at a root of dr/du
+  Double_t dr[3] = {fR[1], 2 * fR[2], 3 * fR[3]};
+  Double_t u[2];
+  Int_t n = FindRoots(2, dr, u);
+  fRmax = TMath::Max(r1, r2);
+  for (Int_t i = 0; i < n; i++) {
+    fRmax = TMath::Max(fRmax, GetR(u[i]));
+  }
+
+  // dz/du is quadratic, and its minimum is at either end or at the vertex
+  Double_t dzmin = TMath::Min(GetdZ(0), GetdZ(1));
+  if (fZ[3] != 0) {
+    Double_t v = -fZ[2] / (3 * fZ[3]);
+    if (0 < v and v < 1) {
+      dzmin = TMath::Min(dzmin, GetdZ(v));
+    }
+  }
+  if (dzmin < -1e-12 * dz) {
+    return kFALSE;
+  }
+
+  // Slope of the curve, sampled finely with a small margin
+  const Int_t kN = 10000;
+  fSlopeMax = 0;
+  for (Int_t i = 0; i <= kN; i++) {
+    Double_t v = Double_t(i) / kN;
+    Double_t dzdu = GetdZ(v);
+    if (dzdu <= 0) {
+      fSlopeMax = TMath::Infinity();
+      break;
+    }
+    fSlopeMax = TMath::Max(fSlopeMax, 1.01 * TMath::Abs(GetdR(v)) / dzdu);
+  }
+
+  return kTRUE;
+}
@@ -9,14 +9,39 @@
 //
 // Focal surface
 //
+// The QE curves are resampled at equally spaced nodes when they are given, so
+// a lookup needs no search in the TGraph. TGraph::Eval is used only outside
+// the range of the data points, where it extrapolates the curve as before.
+//
+// When the QE is low, many photons are traced only to be discarded at the
+// focal surface. FoldQuantumEfficiency applies the wavelength QE to the
+// photons before tracing, by rejection or as photon weights. The surface must
+// then be told by SetQELambdaFolded(kTRUE) not to apply it again.
+//
+// The focal surface owns copies of the QE curves. The tables are not written
+// to a ROOT file, and are rebuilt by Streamer after the curves are read.
+//
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
+
+#include "TBuffer.h"
+#include "TRandom.h"
+
 #include "AFocalSurface.h"
 
 ClassImp(AFocalSurface);
 
+namespace {
+
+const Int_t kQETableNodes = 1001;
+
+}  // namespace
+
 AFocalSurface::AFocalSurface()
-    : fQuantumEfficiencyLambda(0), fQuantumEfficiencyAngle(0) {
+    : fQuantumEfficiencyLambda(0),
+      fQuantumEfficiencyAngle(0),
+      fQELambdaFolded(kFALSE) {
   // Default constructor
   SetLineColor(2);
 }
@@ -26,15 +51,101 @@ AFocalSurface::AFocalSurface(const char* name, const TGeoShape* shape,
                              const TGeoMedium* med)
     : AOpticalComponent(name, shape, med),
       fQuantumEfficiencyLambda(0),
-      fQuantumEfficiencyAngle(0) {
+      fQuantumEfficiencyAngle(0),
+      fQELambdaFolded(kFALSE) {
   // Constructor
   SetLineColor(2);
 }
 
+//_____________________________________________________________________________
+AFocalSurface::~AFocalSurface() {
+  SafeDelete(fQuantumEfficiencyLambda);
+  SafeDelete(fQuantumEfficiencyAngle);
+}
+
+//_____________________________________________________________________________
+Double_t AFocalSurface::Evaluate(const TGraph& graph, const AQETable& table,
+                                 Double_t x) {
+  // Linear interpolation in the table, or TGraph::Eval outside the table
+  if (not table.fValues.empty()) {
+    Double_t u = (x - table.fMin) * table.fInvStep;
+    Int_t n = table.fValues.size();
+    if (u >= 0 and u <= n - 1) {
+      Int_t i = std::min(Int_t(u), n - 2);
+      Double_t f = u - i;
+      return (1 - f) * table.fValues[i] + f * table.fValues[i + 1];
+    }
+  }
+
+  return graph.Eval(x);
+}
+
+//_____________________________________________________________________________
+void AFocalSurface::FoldQuantumEfficiency(ARayArray& array) const {
+  // Stop the running rays randomly with a probability of 1 - QE(lambda)
+  // before tracing. The stopped rays are moved to the stopped array.
+  if (not fQuantumEfficiencyLambda) {
+    return;
+  }
+
+  TObjArray* running = array.GetRunning();
+  TObjArray* stopped = array.GetStopped();
+  Int_t n = running->GetLast();
+  for (Int_t i = 0; i <= n; i++) {
+    ARay* ray = (ARay*)running->At(i);
+    if (!ray) continue;
+    Double_t qe = GetQuantumEfficiency(ray->GetLambda());
+    if (qe < 1 and gRandom->Uniform(0, 1) >= qe) {
+      running->RemoveAt(i);
+      ray->Stop();
+      stopped->Add(ray);
+    }
+  }
+  running->Compress();
+}
+
+//_____________________________________________________________________________
+void AFocalSurface::FoldQuantumEfficiency(ARayBatch& batch,
+                                          EFoldMode mode) const {
+  // Apply QE(lambda) to the running photons before tracing. With kRejection,
+  // a photon is stopped with a probability of 1 - QE. With kWeight, its weight
+  // is multiplied by QE instead, and every photon is traced.
+  if (not fQuantumEfficiencyLambda) {
+    return;
+  }
+
+  std::size_t n = batch.GetN();
+  for (std::size_t i = 0; i < n; ++i) {
+    if (not batch.IsRunning(i)) {
+      continue;
+    }
+    Double_t qe = GetQuantumEfficiency(batch.GetLambda(i));
+    if (mode == kWeight) {
+      batch.SetWeight(i, batch.GetWeight(i) * qe);
+    } else if (qe < 1 and gRandom->Uniform(0, 1) >= qe) {
+      batch.SetStatus(i, ARay::kStop);
+    }
+  }
+}
+
+//_____________________________________________________________________________
+Double_t AFocalSurface::GetDetectionProbability(Double_t lambda,
+                                                Double_t angle) const {
+  // Return the probability that a photon reaching the surface is focused.
+  // This is the QE excluding the wavelength dependence if it has been folded
+  // into the photon source.
+  Double_t qe = fQELambdaFolded ? 1. : GetQuantumEfficiency(lambda);
+  if (HasQEAngle()) {
+    qe *= Evaluate(*fQuantumEfficiencyAngle, fQEAngleTable, angle);
+  }
+
+  return qe;
+}
+
 //_____________________________________________________________________________
 Double_t AFocalSurface::GetQuantumEfficiency(Double_t lambda) const {
   if (fQuantumEfficiencyLambda) {
-    return fQuantumEfficiencyLambda->Eval(lambda);
+    return Evaluate(*fQuantumEfficiencyLambda, fQELambdaTable, lambda);
   } else {
     return 1.;
   }
@@ -45,8 +156,79 @@ Double_t AFocalSurface::GetQuantumEfficiency(Double_t lambda,
                                              Double_t angle) const {
   Double_t qe = GetQuantumEfficiency(lambda);
   if (HasQEAngle()) {
-    qe *= fQuantumEfficiencyAngle->Eval(angle);
+    qe *= Evaluate(*fQuantumEfficiencyAngle, fQEAngleTable, angle);
   }
 
   return qe;
 }
+
+//_____________________________________________________________________________
+void AFocalSurface::SetQuantumEfficiency(const TGraph* qe) {
+  // Set a copy of the QE curve as a function of wavelength
+  SafeDelete(fQuantumEfficiencyLambda);
+  if (qe) {
+    fQuantumEfficiencyLambda = new TGraph(*qe);
+  }
+  Tabulate(fQuantumEfficiencyLambda, fQELambdaTable);
+}
+
+//_____________________________________________________________________________
+void AFocalSurface::SetQuantumEfficiency(std::shared_ptr<const TGraph> qe) {
+  // Set a copy of the QE curve as a function of wavelength
+  SetQuantumEfficiency(qe.get());
+}
+
+//_____________________________________________________________________________
+void AFocalSurface::SetQuantumEfficiencyAngle(const TGraph* qe) {
+  // Set a copy of the QE curve as a function of the incident angle (rad)
+  SafeDelete(fQuantumEfficiencyAngle);
+  if (qe) {
+    fQuantumEfficiencyAngle = new TGraph(*qe);
+  }
+  Tabulate(fQuantumEfficiencyAngle, fQEAngleTable);
+}
+
+//_____________________________________________________________________________
+void AFocalSurface::SetQuantumEfficiencyAngle(
+    std::shared_ptr<const TGraph> qe) {
+  // Set a copy of the QE curve as a function of the incident angle (rad)
+  SetQuantumEfficiencyAngle(qe.get());
+}
+
+//_____________________________________________________________________________
+void AFocalSurface::Streamer(TBuffer& R__b) {
+  // Stream an object of class AFocalSurface. The QE tables are not written,
+  // and are rebuilt after reading.
+  if (R__b.IsReading()) {
+    R__b.ReadClassBuffer(AFocalSurface::Class(), this);
+    Tabulate(fQuantumEfficiencyLambda, fQELambdaTable);
+    Tabulate(fQuantumEfficiencyAngle, fQEAngleTable);
+  } else {
+    R__b.WriteClassBuffer(AFocalSurface::Class(), this);
+  }
+}
+
+//_____________________________________________________________________________
+void AFocalSurface::Tabulate(const TGraph* graph, AQETable& table) {
+  // Resample the graph at equally spaced nodes between its first and last
+  // data points. The table is left empty if the range is zero.
+  table.fValues.clear();
+  if (not graph or graph->GetN() < 2) {
+    return;
+  }
+
+  const Double_t* x = graph->GetX();
+  Int_t n = graph->GetN();
+  Double_t xmin = *std::min_element(x, x + n);
+  Double_t xmax = *std::max_element(x, x + n);
+  if (xmax <= xmin) {
+    return;
+  }
+
+  table.fMin = xmin;
+  table.fInvStep = (kQETableNodes - 1) / (xmax - xmin);
+  table.fValues.resize(kQETableNodes);
+  for (Int_t i = 0; i < kQETableNodes; ++i) {
+    table.fValues[i] = graph->Eval(xmin + i / table.fInvStep);
+  }
+}
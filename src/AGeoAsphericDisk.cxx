@@ -14,6 +14,7 @@
 #include "AGeoAsphericDisk.h"
 
 #include "Riostream.h"
+#include "TBuffer.h"
 #include "TBuffer3D.h"
 #include "TBuffer3DTypes.h"
 #include "TGeoCone.h"
@@ -27,6 +28,22 @@
 
 ClassImp(AGeoAsphericDisk);
 
+namespace {
+
+inline void EvalPolynomial(Int_t n, const Double_t* k, Double_t x,
+                           Double_t& p, Double_t& dp) {
+  // Evaluate p = sum_j k[j] x^(j+1) and dp/dx by Horner's method
+  p = 0;
+  dp = 0;
+  for (Int_t j = n - 1; j >= 0; j--) {
+    p = p * x + k[j];
+    dp = dp * x + (j + 1) * k[j];
+  }
+  p *= x;
+}
+
+}  // namespace
+
 //_____________________________________________________________________________
 AGeoAsphericDisk::AGeoAsphericDisk()
     : fConic1(0),
@@ -43,6 +60,12 @@ AGeoAsphericDisk::AGeoAsphericDisk()
   SetShapeBit(TGeoShape::kGeoBox);
   SetAsphDimensions(0, 0, 0, 0, 0, 0);
   ComputeBBox();
+  // The profiles are not streamed, and are recomputed by Streamer after the
+  // other members are read.
+  fSagMin[0] = fSagMin[1] = 1;
+  fSagMax[0] = fSagMax[1] = 0;
+  fSlope[0].clear();
+  fSlope[1].clear();
 }
 
 //_____________________________________________________________________________
@@ -98,13 +121,10 @@ Double_t AGeoAsphericDisk::CalcdF1dr(Double_t r) const noexcept(false) {
   Double_t p = r * r * fCurve1 * fCurve1 * fKappa1;
   if (1 - p <= 0) throw std::exception();
 
-  Double_t ret = r * fCurve1 / sqrt(1 - p);
-
-  for (Int_t i = 0; i < fNPol1; i++) {
-    ret += 2 * (i + 1) * fK1[i] * TMath::Power(r, 2 * (i + 1) - 1);
-  }
+  Double_t poly, dpoly;
+  EvalPolynomial(fNPol1, fK1, r * r, poly, dpoly);
 
-  return ret;
+  return r * fCurve1 / sqrt(1 - p) + 2 * r * dpoly;
 }
 
 //_____________________________________________________________________________
@@ -113,13 +133,10 @@ Double_t AGeoAsphericDisk::CalcdF2dr(Double_t r) const noexcept(false) {
   Double_t p = r * r * fCurve2 * fCurve2 * fKappa2;
   if (1 - p <= 0) throw std::exception();
 
-  Double_t ret = r * fCurve2 / sqrt(1 - p);
-
-  for (Int_t i = 0; i < fNPol2; i++) {
-    ret += 2 * (i + 1) * fK2[i] * pow(r, 2 * (i + 1) - 1);
-  }
+  Double_t poly, dpoly;
+  EvalPolynomial(fNPol2, fK2, r * r, poly, dpoly);
 
-  return ret;
+  return r * fCurve2 / sqrt(1 - p) + 2 * r * dpoly;
 }
 
 //_____________________________________________________________________________
@@ -128,13 +145,10 @@ Double_t AGeoAsphericDisk::CalcF1(Double_t r) const noexcept(false) {
   Double_t p = r * r * fCurve1 * fCurve1 * fKappa1;
   if (1 - p < 0) throw std::exception();
 
-  Double_t ret = fZ1 + r * r * fCurve1 / (1 + sqrt(1 - p));
-
-  for (Int_t i = 0; i < fNPol1; i++) {
-    ret += fK1[i] * pow(r, 2 * (i + 1));
-  }
+  Double_t poly, dpoly;
+  EvalPolynomial(fNPol1, fK1, r * r, poly, dpoly);
 
-  return ret;
+  return fZ1 + r * r * fCurve1 / (1 + sqrt(1 - p)) + poly;
 }
 
 //_____________________________________________________________________________
@@ -143,13 +157,33 @@ Double_t AGeoAsphericDisk::CalcF2(Double_t r) const noexcept(false) {
   Double_t p = r * r * fCurve2 * fCurve2 * fKappa2;
   if (1 - p < 0) throw std::exception();
 
-  Double_t ret = fZ2 + r * r * fCurve2 / (1 + sqrt(1 - p));
+  Double_t poly, dpoly;
+  EvalPolynomial(fNPol2, fK2, r * r, poly, dpoly);
 
-  for (Int_t i = 0; i < fNPol2; i++) {
-    ret += fK2[i] * pow(r, 2 * (i + 1));
+  return fZ2 + r * r * fCurve2 / (1 + sqrt(1 - p)) + poly;
+}
+
+//_____________________________________________________________________________
+Bool_t AGeoAsphericDisk::CalcSag(Int_t n, Double_t h2, Double_t& sag,
+                                 Double_t& dsag) const {
+  // Calculate the sag Fn - fZn of surface n and its derivative with respect to
+  // h2 = r^2. Return kFALSE if the conic is not defined at h2.
+  Double_t curve = n == 1 ? fCurve1 : fCurve2;
+  Double_t kappa = n == 1 ? fKappa1 : fKappa2;
+  Double_t arg = 1 - kappa * curve * curve * h2;
+  if (arg < 0) return kFALSE;
+
+  Double_t l = TMath::Sqrt(arg);
+  Double_t poly, dpoly;
+  if (n == 1) {
+    EvalPolynomial(fNPol1, fK1, h2, poly, dpoly);
+  } else {
+    EvalPolynomial(fNPol2, fK2, h2, poly, dpoly);
   }
+  sag = curve * h2 / (1 + l) + poly;
+  dsag = (l > 0 ? curve / (2 * l) : 0) + dpoly;
 
-  return ret;
+  return kTRUE;
 }
 
 //_____________________________________________________________________________
@@ -240,6 +274,88 @@ void AGeoAsphericDisk::ComputeBBox() {
   fDX = fRmax;
   fDY = fRmax;
   fDZ = (zmax - zmin) / 2;
+
+  ComputeProfiles();
+}
+
+//_____________________________________________________________________________
+void AGeoAsphericDisk::ComputeProfiles() {
+  // Compute the profiles of the surfaces between fRmin and fRmax sampled at
+  // fSteps + 1 radii. The range of the sag limits the search for intersections
+  // in DistToAsphere, and the bounds of the slope are used by Safety.
+  //
+  // The range of the sag is widened by the largest difference between
+  // neighboring points, so that an extremum between the points is still
+  // inside. The slope in each bin is bounded likewise by the larger of those
+  // at the bin edges plus the largest difference of the slope between
+  // neighboring points. If the slope of a surface cannot be evaluated at all
+  // the points, its slope bounds are left empty and Safety returns only the
+  // distance to the cylinder and the z range of the shape.
+  for (Int_t n = 1; n <= 2; n++) {
+    Double_t smin = TGeoShape::Big();
+    Double_t smax = -TGeoShape::Big();
+    Double_t margin = 0;
+    Double_t prev = 0;
+    Bool_t hasPrev = kFALSE;
+    std::vector<Double_t> slope;
+    Bool_t hasSlope = fRmax > fRmin and fSteps > 0;
+    for (Int_t j = 0; j <= fSteps; j++) {
+      Double_t r = fRmin + (fRmax - fRmin) * j / fSteps;
+      Double_t sag, dsag;
+      if (not CalcSag(n, r * r, sag, dsag)) {
+        hasPrev = kFALSE;
+        hasSlope = kFALSE;
+        continue;
+      }
+      smin = TMath::Min(smin, sag);
+      smax = TMath::Max(smax, sag);
+      if (hasPrev) {
+        margin = TMath::Max(margin, TMath::Abs(sag - prev));
+      }
+      prev = sag;
+      hasPrev = kTRUE;
+
+      if (hasSlope) {
+        try {
+          slope.push_back(n == 1 ? CalcdF1dr(r) : CalcdF2dr(r));
+        } catch (...) {
+          hasSlope = kFALSE;  // vertical at the edge of a conic
+        }
+      }
+    }
+    fSagMin[n - 1] = smin - margin;
+    fSagMax[n - 1] = smax + margin;
+
+    fSlope[n - 1].clear();
+    fSlopeMax[n - 1] = 0;
+    if (not hasSlope) continue;
+
+    Double_t slopeMargin = 0;
+    for (Int_t j = 0; j < fSteps; j++) {
+      slopeMargin =
+          TMath::Max(slopeMargin, TMath::Abs(slope[j + 1] - slope[j]));
+    }
+    fSlope[n - 1].resize(fSteps);
+    for (Int_t j = 0; j < fSteps; j++) {
+      fSlope[n - 1][j] =
+          TMath::Max(TMath::Abs(slope[j]), TMath::Abs(slope[j + 1])) +
+          slopeMargin;
+      fSlopeMax[n - 1] = TMath::Max(fSlopeMax[n - 1], fSlope[n - 1][j]);
+    }
+  }
+
+  if (fSlope[0].empty() or fSlope[1].empty()) return;
+
+  Double_t sag, dsag;
+  for (Int_t i = 0; i < 2; i++) {
+    Double_t r = i == 0 ? fRmin : fRmax;
+    CalcSag(1, r * r, sag, dsag);
+    Double_t z1 = fZ1 + sag;
+    CalcSag(2, r * r, sag, dsag);
+    Double_t z2 = fZ2 + sag;
+    fWallZ[i][0] = TMath::Min(z1, z2);
+    fWallZ[i][1] = TMath::Max(z1, z2);
+  }
 }
 
 //_____________________________________________________________________________
@@ -414,115 +530,164 @@ Double_t AGeoAsphericDisk::DistFromOutside(CONST53410 Double_t* point,
 //_____________________________________________________________________________
 Double_t AGeoAsphericDisk::DistToAsphere(Int_t n, CONST53410 Double_t* point,
                                          CONST53410 Double_t* dir) const {
+  // Compute the distance along dir to surface n (1 or 2) between fRmin and
+  // fRmax, or TGeoShape::Big() if the ray does not hit it.
+  //
+  // The ray is point + t * dir, and a hit is a root of
+  //   f(t) = z(t) - Fn(r(t))
+  // First t is limited to the interval where the ray is inside the cylinder
+  // of fRmax and inside the z slab of the surface (see ComputeProfiles). The
+  // interval is split at the point closest to the z axis, and the segments
+  // are searched from the start for a sign change of f. A segment without a
+  // sign change may still have two roots if f approaches zero from both
+  // ends, so it is halved up to kMaxDepth times. A bracketed root is found by
+  // Newton's method safeguarded by bisection, which usually converges in a few
+  // iterations. Unlike the older iteration from a conic guess, this works at
+  // any incident angle.
   if (n != 1 and n != 2) return TGeoShape::Big();
 
-  // following calculations are based on Y.Matsui's text book pp 42-45
-  // Matsui (x, y, z) -> in this function (z, x, y)
-  // !WARNING! this method cannot handle with large incident angles nor
-  // complicated surfaces which have many extremums. I strongly recommend you
-  // to check 3D view of rays. In most cases using Ashra optics, this will not
-  // limit your application.
-  Double_t H2 = point[0] * point[0] + point[1] * point[1];
-  Double_t d = n == 1 ? fZ1 : fZ2;
-  Double_t p =
-      -((point[2] - d) * dir[2] + point[0] * dir[0] + point[1] * dir[1]);
-  Double_t M = p * dir[2] + point[2] - d;
-  Double_t M2 = (point[2] - d) * (point[2] - d) + H2 - p * p;
-
-  Double_t check = n == 1
-                       ? 1 - (M2 * fCurve1 - 2 * M) * fCurve1 / dir[2] / dir[2]
-                       : 1 - (M2 * fCurve2 - 2 * M) * fCurve2 / dir[2] / dir[2];
-
-  if (check < 0) {
-    // Actually, the ray still has a chance to cross the surface. But this is
-    // the limitation of this function.
-    return TGeoShape::Big();
-  }
+  const Int_t kMaxDepth = 6;
+  const Int_t kMaxIterations = 50;
+  const Double_t kTolerance = 1e-10;
 
-  Double_t q =
-      n == 1 ? p + (M2 * fCurve1 - 2 * M) / (dir[2] * (1 + TMath::Sqrt(check)))
-             : p + (M2 * fCurve2 - 2 * M) / (dir[2] * (1 + TMath::Sqrt(check)));
+  Double_t zn = n == 1 ? fZ1 : fZ2;
+  Double_t curve = n == 1 ? fCurve1 : fCurve2;
+  Double_t kappa = n == 1 ? fKappa1 : fKappa2;
 
-  Double_t npoint[3] = {point[0] + q * dir[0], point[1] + q * dir[1],
-                        point[2] + q * dir[2] - d};
+  // r(t)^2 = h0 + 2bt + at^2
+  Double_t a = dir[0] * dir[0] + dir[1] * dir[1];
+  Double_t b = point[0] * dir[0] + point[1] * dir[1];
+  Double_t h0 = point[0] * point[0] + point[1] * point[1];
 
-  for (Int_t i = 0;; i++) {
-    if (i > 100) {
-      return TGeoShape::Big();
-    }
-    H2 = npoint[0] * npoint[0] + npoint[1] * npoint[1];
-    check = n == 1 ? (1 - fKappa1 * H2 * fCurve1 * fCurve1)
-                   : (1 - fKappa2 * H2 * fCurve2 * fCurve2);
-    if (check < 0) {
-      // This is a limitation too
-      return TGeoShape::Big();
-    }
+  // The conic is not defined beyond r^2 = 1 / (kappa * c^2)
+  Double_t rmax2 = fRmax * fRmax;
+  if (kappa * curve * curve * rmax2 > 1) {
+    rmax2 = 1 / (kappa * curve * curve);
+  }
 
-    Double_t l = sqrt(check);
+  Double_t tmin = 0;
+  Double_t tmax = TGeoShape::Big();
+  if (a > 0) {
+    Double_t disc = b * b - a * (h0 - rmax2);
+    if (disc < 0) return TGeoShape::Big();
+    Double_t q = -(b + (b < 0 ? -1 : 1) * TMath::Sqrt(disc));
+    Double_t t1 = q / a;
+    Double_t t2 = q != 0 ? (h0 - rmax2) / q : -t1;
+    tmin = TMath::Max(tmin, TMath::Min(t1, t2));
+    tmax = TMath::Min(tmax, TMath::Max(t1, t2));
+  } else if (h0 > rmax2) {
+    return TGeoShape::Big();
+  }
 
-    Double_t x = 0;
-    if (n == 1) {
-      if (fCurve1 != 0) x += (1 - l) / fCurve1 / fKappa1;
-      for (Int_t j = 0; j < fNPol1; j++) {
-        x += fK1[j] * TMath::Power(H2, j + 1);
-      }
-    } else {
-      if (fCurve2 != 0) x += (1 - l) / fCurve2 / fKappa2;
-      for (int j = 0; j < fNPol2; j++) {
-        x += fK2[j] * TMath::Power(H2, j + 1);
+  Double_t zlo, zhi;
+  if (fSagMin[n - 1] <= fSagMax[n - 1]) {
+    zlo = zn + fSagMin[n - 1] - kTolerance;
+    zhi = zn + fSagMax[n - 1] + kTolerance;
+  } else {  // not computed yet
+    zlo = fOrigin[2] - fDZ - kTolerance;
+    zhi = fOrigin[2] + fDZ + kTolerance;
+  }
+  if (dir[2] != 0) {
+    Double_t t1 = (zlo - point[2]) / dir[2];
+    Double_t t2 = (zhi - point[2]) / dir[2];
+    tmin = TMath::Max(tmin, TMath::Min(t1, t2));
+    tmax = TMath::Min(tmax, TMath::Max(t1, t2));
+  } else if (point[2] < zlo or zhi < point[2]) {
+    return TGeoShape::Big();
+  }
+
+  if (tmin > tmax) return TGeoShape::Big();
+
+  // f(t) and df/dt at a point on the ray
+  struct APoint {
+    Double_t fT, fF, fDF;
+  };
+  auto eval = [&](Double_t t) {
+    Double_t h2 = TMath::Min(h0 + t * (2 * b + a * t), rmax2);
+    Double_t sag, dsag;
+    CalcSag(n, TMath::Max(h2, 0.), sag, dsag);
+    APoint pt = {t, point[2] + t * dir[2] - zn - sag,
+                 dir[2] - 2 * (a * t + b) * dsag};
+    return pt;
+  };
+
+  // Segments to be searched. The one at the end is searched first.
+  struct ASegment {
+    APoint fP1, fP2;
+    Int_t fDepth;
+  } stack[kMaxDepth + 3];
+  Int_t nstack = 0;
+
+  APoint p1 = eval(tmin);
+  APoint p2 = eval(tmax);
+  Double_t tc = a > 0 ? -b / a : tmin;  // closest to the z axis
+  if (tmin < tc and tc < tmax) {
+    APoint pc = eval(tc);
+    stack[nstack++] = {pc, p2, 0};
+    stack[nstack++] = {p1, pc, 0};
+  } else {
+    stack[nstack++] = {p1, p2, 0};
+  }
+
+  while (nstack > 0) {
+    ASegment seg = stack[--nstack];
+    p1 = seg.fP1;
+    p2 = seg.fP2;
+
+    if (p1.fF * p2.fF > 0) {
+      // No sign change. Look into the segment only if f approaches zero from
+      // both ends.
+      if (seg.fDepth < kMaxDepth and p1.fF * p1.fDF < 0 and
+          p2.fF * p2.fDF > 0) {
+        APoint pm = eval((p1.fT + p2.fT) / 2);
+        stack[nstack++] = {pm, p2, seg.fDepth + 1};
+        stack[nstack++] = {p1, pm, seg.fDepth + 1};
       }
+      continue;
     }
 
-    Double_t v = 0;
-    if (n == 1) {
-      for (int j = 0; j < fNPol1; j++) {
-        v += 2 * (j + 1) * fK1[j] * TMath::Power(H2, j);
+    // Safeguarded Newton iteration keeping f(lo) <= 0 <= f(hi)
+    Double_t lo = p1.fF <= 0 ? p1.fT : p2.fT;
+    Double_t hi = p1.fF <= 0 ? p2.fT : p1.fT;
+    APoint pt = TMath::Abs(p1.fF) < TMath::Abs(p2.fF) ? p1 : p2;
+    Double_t dt = TMath::Abs(p2.fT - p1.fT);
+    Double_t dtold = dt;
+    for (Int_t i = 0; i < kMaxIterations and pt.fF != 0; i++) {
+      Double_t t = pt.fT;
+      if (((t - hi) * pt.fDF - pt.fF) * ((t - lo) * pt.fDF - pt.fF) > 0 or
+          TMath::Abs(2 * pt.fF) > TMath::Abs(dtold * pt.fDF)) {
+        dtold = dt;
+        dt = (hi - lo) / 2;
+        t = lo + dt;
+      } else {
+        dtold = dt;
+        dt = pt.fF / pt.fDF;
+        t -= dt;
       }
-      v = fCurve1 * fKappa1 + l * v;
-    } else {
-      for (Int_t j = 0; j < fNPol2; j++) {
-        v += 2 * (j + 1) * fK2[j] * TMath::Power(H2, j);
+      if (TMath::Abs(dt) < kTolerance) {
+        pt.fT = t;
+        break;
+      }
+      pt = eval(t);
+      if (pt.fF < 0) {
+        lo = t;
+      } else {
+        hi = t;
       }
-      v = fCurve2 * fKappa2 + l * v;
     }
 
-    Double_t m = -npoint[0] * v;
-    Double_t n = -npoint[1] * v;
-    Double_t norm = TMath::Sqrt(l * l + m * m + n * n);
-    l /= norm;
-    m /= norm;
-    n /= norm;
-
-    check = dir[2] * l + dir[0] * m + dir[1] * n;
-    if (check == 0) {
-      return TGeoShape::Big();
+    Double_t t = pt.fT;
+    if (h0 + t * (2 * b + a * t) >= fRmin * fRmin) {
+      return t;
     }
 
-    Double_t e = l * (x - npoint[2]) / check;
-
-    for (Int_t j = 0; j < 3; j++) {
-      npoint[j] += e * dir[j];
+    // The root is inside fRmin. Search the rest of the segment.
+    if (t + kTolerance < p2.fT) {
+      stack[nstack++] = {eval(t + kTolerance), p2, seg.fDepth};
     }
-
-    if (TMath::Abs(e) < 1e-10) break;
-  }
-
-  npoint[2] += d;
-  check = dir[0] * (npoint[0] - point[0]) + dir[1] * (npoint[1] - point[1]) +
-          dir[2] * (npoint[2] - point[2]);
-  if (check < 0) {
-    return TGeoShape::Big();
-  }
-
-  Double_t dist_to_zaxis =
-      TMath::Power(npoint[0] * npoint[0] + npoint[1] * npoint[1], 0.5);
-  if (dist_to_zaxis < fRmin or dist_to_zaxis > fRmax) {
-    return TGeoShape::Big();
   }
 
-  return TMath::Sqrt(TMath::Power(npoint[0] - point[0], 2) +
-                     TMath::Power(npoint[1] - point[1], 2) +
-                     TMath::Power(npoint[2] - point[2], 2));
+  return TGeoShape::Big();
 }
 
 //_____________________________________________________________________________
@@ -817,110 +982,73 @@ TBuffer3D* AGeoAsphericDisk::MakeBuffer3D() const {
 
 //_____________________________________________________________________________
 Double_t AGeoAsphericDisk::Safety(CONST53410 Double_t* point, Bool_t in) const {
-  Double_t safe;
-
-  Double_t rad2 = point[0] * point[0] + point[1] * point[1];
-  Double_t rad = sqrt(rad2);
-
-  Double_t dist[4];
-
-  if (!in) {
-    Double_t f1rmax, f1rmin, f2rmax, f2rmin;
-    try {
-      f1rmax = CalcF1(fRmax);
-    } catch (...) {
-      f1rmax = -TGeoShape::Big();
-    }
-    try {
-      f1rmin = CalcF1(fRmin);
-    } catch (...) {
-      f1rmin = -TGeoShape::Big();
-    }
-    try {
-      f2rmax = CalcF2(fRmax);
-    } catch (...) {
-      f2rmax = TGeoShape::Big();
-    }
-    try {
-      f2rmin = CalcF2(fRmin);
-    } catch (...) {
-      f2rmin = TGeoShape::Big();
-    }
-
-    if (rad < fRmin and (f1rmin < point[2] or point[2] < f2rmin)) {
-      return fRmin - rad;
-    } else if (rad > fRmax and (f1rmax < point[2] or point[2] < f2rmax)) {
-      return rad - fRmax;
+  // Return a lower bound of the distance from the point to the boundary of the
+  // shape. The distance to each surface is bounded in O(1) by using the slope
+  // bounds computed in ComputeBBox (see SafetyToSurface), and that to the walls
+  // at fRmin and fRmax by the distance to the line segments between the two
+  // surfaces. The bound is the same for points inside and outside.
+  Double_t rad = TMath::Sqrt(point[0] * point[0] + point[1] * point[1]);
+
+  if (fSlope[0].empty() or fSlope[1].empty()) {
+    // The slope of a surface is not bounded (e.g., a conic vertical at fRmax).
+    // Only the distance to the cylinder and the z range of the surfaces is a
+    // lower bound, which is zero inside.
+    if (in) return 0;
+    Double_t safe = TMath::Max(rad - fRmax, fRmin - rad);
+    if (fSagMin[0] <= fSagMax[0] and fSagMin[1] <= fSagMax[1]) {
+      Double_t zlo = TMath::Min(fZ1 + fSagMin[0], fZ2 + fSagMin[1]);
+      Double_t zhi = TMath::Max(fZ1 + fSagMax[0], fZ2 + fSagMax[1]);
+      safe = TMath::Max(safe, TMath::Max(zlo - point[2], point[2] - zhi));
     }
+    return TMath::Max(safe, 0.);
   }
 
-  // calc distance between point and lower surface
-  Double_t r1 = fRmin;
-  Double_t r2 = fRmax;
-  dist[0] = TGeoShape::Big();
-  for (Int_t i = 0; i < fRepeat; i++) {
-    Double_t step = (r2 - r1) / fSteps;
-    Double_t r_ = r1;
-    for (Int_t j = 0; j <= fSteps + 1; j++) {
-      Double_t r = r1 + j * step;
-      Double_t f;
-      try {
-        f = CalcF1(r);
-      } catch (...) {
-        f = -TGeoShape::Big();
-      }
-      Double_t d2 = (f - point[2]) * (f - point[2]) + (r - rad) * (r - rad);
-      if (d2 < dist[0]) {
-        dist[0] = d2;
-        r_ = r;
-      }
-    }
-    r1 = r_ == fRmin ? fRmin : r_ - step;
-    r2 = r_ == fRmax ? fRmax : r_ + step;
-  }
-  dist[0] = TMath::Sqrt(dist[0]);
-
-  // calc distance between point and upper surface
-  r1 = fRmin;
-  r2 = fRmax;
-  dist[1] = TGeoShape::Big();
-  for (Int_t i = 0; i < fRepeat; i++) {
-    Double_t step = (r2 - r1) / fSteps;
-    Double_t r_ = r1;
-    for (Int_t j = 0; j <= fSteps + 1; j++) {
-      Double_t r = r1 + j * step;
-      Double_t f;
-      try {
-        f = CalcF2(r);
-      } catch (...) {
-        f = TGeoShape::Big();
-      }
-      Double_t d2 = (f - point[2]) * (f - point[2]) + (r - rad) * (r - rad);
-      if (d2 < dist[1]) {
-        dist[1] = d2;
-        r_ = r;
-      }
-    }
-    r1 = r_ == fRmin ? fRmin : r_ - step;
-    r2 = r_ == fRmax ? fRmax : r_ + step;
-  }
-  dist[1] = sqrt(dist[1]);
+  Double_t safe = TMath::Min(SafetyToSurface(1, rad, point[2]),
+                             SafetyToSurface(2, rad, point[2]));
 
-  if (in) {
-    dist[2] = rad - fRmin;  // distance to rmin
-    dist[3] = fRmax - rad;  // distance to rmax
-
-    safe = dist[0];
-    for (Int_t i = 1; i < 4; i++) {
-      safe = dist[i] < safe ? dist[i] : safe;
-    }
-  } else {
-    safe = dist[0] < dist[1] ? dist[0] : dist[1];
+  for (Int_t i = fRmin > 0 ? 0 : 1; i < 2; i++) {
+    Double_t dr = rad - (i == 0 ? fRmin : fRmax);
+    Double_t dz = point[2] < fWallZ[i][0]
+                      ? fWallZ[i][0] - point[2]
+                      : (point[2] > fWallZ[i][1] ? point[2] - fWallZ[i][1] : 0);
+    safe = TMath::Min(safe, TMath::Sqrt(dr * dr + dz * dz));
   }
 
   return safe;
 }
 
+//_____________________________________________________________________________
+Double_t AGeoAsphericDisk::SafetyToSurface(Int_t n, Double_t rad,
+                                           Double_t z) const {
+  // Return a lower bound of the distance from (rad, z) to surface n in the r-z
+  // plane. Let L be a bound of |dFn/dr| and rc be rad clamped to
+  // [fRmin, fRmax]. Every point (r, Fn(r)) of the surface satisfies
+  //   |z - Fn(rc)| <= |z - Fn(r)| + L|r - rc| <= |z - Fn(r)| + L|r - rad|
+  //                <= sqrt(1 + L^2) * distance to (r, Fn(r)),
+  // so |z - Fn(rc)| / sqrt(1 + L^2) is a lower bound. It is computed with L of
+  // the whole surface, and with L of the bins around rc for the points within
+  // one bin width h from rad, where the points farther than h are farther than
+  // h. The distance in r to [fRmin, fRmax] is another lower bound.
+  const std::vector<Double_t>& slope = fSlope[n - 1];
+  Int_t nbins = slope.size();
+  Double_t h = (fRmax - fRmin) / nbins;
+  Double_t rc = rad < fRmin ? fRmin : (rad > fRmax ? fRmax : rad);
+
+  Double_t sag, dsag;
+  CalcSag(n, rc * rc, sag, dsag);
+  Double_t dz = TMath::Abs(z - (n == 1 ? fZ1 : fZ2) - sag);
+
+  Int_t k = TMath::Min(Int_t((rc - fRmin) / h), nbins - 1);
+  Double_t local = slope[k];
+  if (k > 0) local = TMath::Max(local, slope[k - 1]);
+  if (k < nbins - 1) local = TMath::Max(local, slope[k + 1]);
+
+  Double_t safe = dz / TMath::Sqrt(1 + fSlopeMax[n - 1] * fSlopeMax[n - 1]);
+  safe = TMath::Max(safe, TMath::Min(h, dz / TMath::Sqrt(1 + local * local)));
+
+  return TMath::Max(safe, TMath::Abs(rad - rc));
+}
+
 //_____________________________________________________________________________
 void AGeoAsphericDisk::SavePrimitive(std::ostream& out, Option_t*) {
   // Save a primitive as a C++ statement(s) on output stream "out".
@@ -997,6 +1125,11 @@ void AGeoAsphericDisk::SetAsphDimensions(Double_t z1, Double_t curve1,
   if (fRmin > 0) {
     SetShapeBit(kGeoRSeg);
   }
+  // Unknown until ComputeBBox is called
+  fSagMin[0] = fSagMin[1] = 1;
+  fSagMax[0] = fSagMax[1] = 0;
+  fSlope[0].clear();
+  fSlope[1].clear();
   fNPol1 = 0;
   fNPol2 = 0;
   fK1 = 0;
@@ -1391,6 +1524,18 @@ void AGeoAsphericDisk::SetSegsAndPols(TBuffer3D& buff) const {
   }
 }
 
+//_____________________________________________________________________________
+void AGeoAsphericDisk::Streamer(TBuffer& R__b) {
+  // Stream an object of class AGeoAsphericDisk. The profiles are not written,
+  // and are recomputed after reading.
+  if (R__b.IsReading()) {
+    R__b.ReadClassBuffer(AGeoAsphericDisk::Class(), this);
+    ComputeProfiles();
+  } else {
+    R__b.WriteClassBuffer(AGeoAsphericDisk::Class(), this);
+  }
+}
+
 //_____________________________________________________________________________
 void AGeoAsphericDisk::Sizeof3D() const {
   ///// obsolete - to be removed
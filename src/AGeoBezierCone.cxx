@@ -0,0 +1,319 @@
+/******************************************************************************
+ * Copyright (C) 2006-, Akira Okumura                                         *
+ * All rights reserved.                                                       *
+ *****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// AGeoBezierCone
+//
+// Geometry class for a solid of revolution whose side surface is defined by a
+// Bezier curve as in AGeoBezierPcon. The curve and its control points are set
+// in the same way, but the distances, the normals, and the safety distances
+// are calculated with the exact surface of revolution (see ABezierProfile).
+// The conical sections are used only for drawing, and thus a small number of
+// sections is enough.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "AGeoBezierCone.h"
+
+#include "Riostream.h"
+#include "TBuffer.h"
+#include "TMath.h"
+
+ClassImp(AGeoBezierCone);
+
+//_____________________________________________________________________________
+AGeoBezierCone::AGeoBezierCone() : AGeoBezierPcon() {
+  // Default constructor
+}
+
+//_____________________________________________________________________________
+AGeoBezierCone::AGeoBezierCone(Double_t r1, Double_t r2, Double_t dz,
+                               Int_t nz)
+    : AGeoBezierPcon(0, 360, nz, r1, r2, dz) {
+  SetSections();
+}
+
+//_____________________________________________________________________________
+AGeoBezierCone::AGeoBezierCone(const char* name, Double_t r1, Double_t r2,
+                               Double_t dz, Int_t nz)
+    : AGeoBezierPcon(name, 0, 360, nz, r1, r2, dz) {
+  SetSections();
+}
+
+//_____________________________________________________________________________
+AGeoBezierCone::~AGeoBezierCone() {
+  // Destructor
+}
+
+//_____________________________________________________________________________
+void AGeoBezierCone::CacheConstants() {
+  // Convert the Bezier curve to polynomials
+  if (not fProfile.Set(fR1, fR2, fLength / 2., fNcontrol, fP1, fP2)) {
+    Error("CacheConstants",
+          "Z of the Bezier curve must increase monotonically");
+  }
+}
+
+//_____________________________________________________________________________
+Double_t AGeoBezierCone::Capacity() const {
+  // Compute capacity of the shape
+  return TMath::Pi() * fProfile.GetSquareIntegral();
+}
+
+//_____________________________________________________________________________
+void AGeoBezierCone::ComputeBBox() {
+  // Compute bounding box of the shape. The curve can be outside the sections.
+  fDX = fProfile.GetRmax();
+  fDY = fProfile.GetRmax();
+  fDZ = fLength / 2.;
+  fOrigin[0] = 0;
+  fOrigin[1] = 0;
+  fOrigin[2] = 0;
+}
+
+//_____________________________________________________________________________
+void AGeoBezierCone::ComputeNormal(CONST53410 Double_t* point,
+                                   CONST53410 Double_t* dir, Double_t* norm) {
+  // Compute normal to closest surface from POINT.
+
+  // Following calculation assumes that the point is very close to surfaces.
+  Double_t dz = fLength / 2.;
+  Double_t z = TMath::Max(-dz, TMath::Min(dz, point[2]));
+  Double_t rad = TMath::Sqrt(point[0] * point[0] + point[1] * point[1]);
+  Double_t u = fProfile.FindU(z);
+
+  Double_t saf[2];
+  saf[0] = TMath::Abs(dz - TMath::Abs(point[2]));
+  saf[1] = TMath::Abs(fProfile.GetR(u) - rad);
+
+  if (saf[0] < saf[1] or rad == 0) {  // on the XY surface
+    norm[0] = 0;
+    norm[1] = 0;
+    norm[2] = 1;
+  } else {
+    // The curve (r(u), z(u)) has the normal (dz/du, -dr/du)
+    Double_t dzdu = fProfile.GetdZ(u);
+    norm[0] = dzdu * point[0] / rad;
+    norm[1] = dzdu * point[1] / rad;
+    norm[2] = -fProfile.GetdR(u);
+    Double_t mag = TMath::Sqrt(norm[0] * norm[0] + norm[1] * norm[1] +
+                               norm[2] * norm[2]);
+    norm[0] /= mag;
+    norm[1] /= mag;
+    norm[2] /= mag;
+  }
+
+  if (norm[0] * dir[0] + norm[1] * dir[1] + norm[2] * dir[2] < 0) {
+    norm[0] = -norm[0];
+    norm[1] = -norm[1];
+    norm[2] = -norm[2];
+  }
+}
+
+//_____________________________________________________________________________
+Bool_t AGeoBezierCone::Contains(CONST53410 Double_t* point) const {
+  // Test if point is in this shape
+  if (TMath::Abs(point[2]) > fLength / 2.) {
+    return kFALSE;
+  }
+
+  Double_t r = fProfile.CalcR(point[2]);
+
+  return point[0] * point[0] + point[1] * point[1] <= r * r;
+}
+
+//_____________________________________________________________________________
+TGeoVolume* AGeoBezierCone::Divide(TGeoVolume*, const char*, Int_t, Int_t,
+                                   Double_t, Double_t) {
+  Error("Divide", "Division of a Bezier cone is not implemented");
+  return 0;
+}
+
+//_____________________________________________________________________________
+Double_t AGeoBezierCone::DistFromInside(CONST53410 Double_t* point,
+                                        CONST53410 Double_t* dir, Int_t iact,
+                                        Double_t step, Double_t* safe) const {
+  // compute distance from inside point to surface of the shape
+
+  // compute safe distance
+  if (iact < 3 and safe) {
+    *safe = Safety(point, kTRUE);
+    if (iact == 0) return TGeoShape::Big();
+    if (iact == 1 && step < *safe) return TGeoShape::Big();
+  }
+
+  // calculate distance
+  Double_t dz = fLength / 2.;
+  Double_t dist = TGeoShape::Big();
+  if (dir[2] < 0) {
+    dist = TMath::Max(0., (-point[2] - dz) / dir[2]);
+  } else if (dir[2] > 0) {
+    dist = TMath::Max(0., (dz - point[2]) / dir[2]);
+  }
+
+  return TMath::Min(dist, DistToSurface(point, dir, kTRUE));
+}
+
+//_____________________________________________________________________________
+Double_t AGeoBezierCone::DistFromOutside(CONST53410 Double_t* point,
+                                         CONST53410 Double_t* dir, Int_t iact,
+                                         Double_t step, Double_t* safe) const {
+  // compute distance from outside point to surface of the shape
+
+  // compute safe distance
+  if (iact < 3 and safe) {
+    *safe = Safety(point, kFALSE);
+    if (iact == 0) return TGeoShape::Big();
+    if (iact == 1 && step < *safe) return TGeoShape::Big();
+  }
+
+  // calculate distance to the bottom or top surface
+  Double_t dz = fLength / 2.;
+  if (point[2] <= -dz or point[2] >= dz) {
+    Double_t zcap = point[2] <= -dz ? -dz : dz;
+    if (dir[2] * zcap >= 0) {
+      return TGeoShape::Big();
+    }
+    Double_t snxt = (zcap - point[2]) / dir[2];
+    // find extrapolated X and Y
+    Double_t xnew = point[0] + snxt * dir[0];
+    Double_t ynew = point[1] + snxt * dir[1];
+    Double_t r = zcap < 0 ? fR2 : fR1;
+    if (xnew * xnew + ynew * ynew <= r * r) {
+      return snxt;
+    }
+  }
+
+  return DistToSurface(point, dir, kFALSE);
+}
+
+//_____________________________________________________________________________
+Double_t AGeoBezierCone::DistToSurface(CONST53410 Double_t* point,
+                                       CONST53410 Double_t* dir,
+                                       Bool_t in) const {
+  // Distance to the side surface. Only the crossings where the ray goes out of
+  // (into) the shape are taken for an inside (outside) point, so that a ray
+  // starting on the surface does not stop there.
+  const Double_t kTol = 1e-9 * fLength;
+  Double_t u[6], t[6];
+  Int_t n = fProfile.CrossRevolved(point, dir, u, t);
+
+  Double_t dist = TGeoShape::Big();
+  for (Int_t i = 0; i < n; i++) {
+    if (t[i] < -kTol or t[i] >= dist) {
+      continue;
+    }
+    Double_t x = point[0] + t[i] * dir[0];
+    Double_t y = point[1] + t[i] * dir[1];
+    Double_t rad = TMath::Sqrt(x * x + y * y);
+    if (rad == 0) {
+      continue;
+    }
+    // Component of the direction along the outward normal
+    Double_t dn = fProfile.GetdZ(u[i]) * (x * dir[0] + y * dir[1]) / rad -
+                  fProfile.GetdR(u[i]) * dir[2];
+    if ((dn > 0) == in) {
+      dist = TMath::Max(0., t[i]);
+    }
+  }
+
+  return dist;
+}
+
+//_____________________________________________________________________________
+void AGeoBezierCone::GetBoundingCylinder(Double_t* param) const {
+  //--- Fill vector param[4] with the bounding cylinder parameters. The order
+  // is the following : Rmin, Rmax, Phi1, Phi2
+  param[0] = 0;
+  param[1] = fProfile.GetRmax() * fProfile.GetRmax();
+  param[2] = 0;
+  param[3] = 360;
+}
+
+//_____________________________________________________________________________
+void AGeoBezierCone::InspectShape() const {
+  // print shape parameters
+  printf("*** Shape %s: AGeoBezierCone ***\n", GetName());
+  printf("    R1     = %11.5f\n", fR1);
+  printf("    R2     = %11.5f\n", fR2);
+  printf("    DZ     = %11.5f\n", fLength / 2.);
+  if (fNcontrol >= 1) {
+    printf("    P1     = (%f, %f)\n", fP1.X(), fP1.Y());
+  }
+  if (fNcontrol == 2) {
+    printf("    P2     = (%f, %f)\n", fP2.X(), fP2.Y());
+  }
+  printf(" Bounding box:\n");
+  TGeoBBox::InspectShape();
+}
+
+//_____________________________________________________________________________
+Double_t AGeoBezierCone::Safety(CONST53410 Double_t* point, Bool_t in) const {
+  // Compute safe distance from either outside or inside to a boundary of
+  // this shape. The distance to the side surface is not shorter than
+  // |rad - R(z)|/Sqrt(1 + S^2), where S is the maximum slope |dR/dz|.
+  Double_t dz = fLength / 2.;
+  Double_t z = point[2];
+  Double_t rad = TMath::Sqrt(point[0] * point[0] + point[1] * point[1]);
+  Double_t slope = fProfile.GetSlopeMax();
+  Double_t k = 1. / TMath::Sqrt(1 + slope * slope);
+
+  if (in) {
+    Double_t safe = dz - TMath::Abs(z);
+    if (TMath::Abs(z) <= dz) {
+      safe = TMath::Min(safe, (fProfile.CalcR(z) - rad) * k);
+    }
+    return TMath::Max(0., safe);
+  } else if (TMath::Abs(z) > dz) {
+    return TMath::Max(TMath::Abs(z) - dz, rad - fProfile.GetRmax());
+  }
+
+  return TMath::Max(0., (rad - fProfile.CalcR(z)) * k);
+}
+
+//_____________________________________________________________________________
+void AGeoBezierCone::SavePrimitive(std::ostream& out, Option_t*) {
+  // Save a primitive as a C++ statement(s) on output stream "out".
+  if (TObject::TestBit(kGeoSavePrimitive)) return;
+
+  out << "   // Shape: " << GetName() << " type: " << ClassName() << std::endl;
+  out << "   r1 = " << fR1 << ";" << std::endl;
+  out << "   r2 = " << fR2 << ";" << std::endl;
+  out << "   dz = " << fLength / 2. << ";" << std::endl;
+  out << "   nz = " << fNz << ";" << std::endl;
+  out << "   AGeoBezierCone* cone = new AGeoBezierCone(\"" << GetName()
+      << "\", r1, r2, dz, nz);" << std::endl;
+  if (fNcontrol == 1) {
+    out << "   cone->SetControlPoints(" << fP1.X() << ", " << fP1.Y() << ");"
+        << std::endl;
+  } else if (fNcontrol == 2) {
+    out << "   cone->SetControlPoints(" << fP1.X() << ", " << fP1.Y() << ", "
+        << fP2.X() << ", " << fP2.Y() << ");" << std::endl;
+  }
+
+  out << "   TGeoShape* " << GetPointerName() << " = cone;" << std::endl;
+  TObject::SetBit(TGeoShape::kGeoSavePrimitive);
+}
+
+//_____________________________________________________________________________
+void AGeoBezierCone::SetSections() {
+  // Update the polynomials before the sections, with which the bounding box
+  // is recomputed
+  CacheConstants();
+  AGeoBezierPcon::SetSections();
+}
+
+//_____________________________________________________________________________
+void AGeoBezierCone::Streamer(TBuffer& R__b) {
+  // Stream an object of class AGeoBezierCone. The polynomials are not written,
+  // and are recomputed after reading.
+  if (R__b.IsReading()) {
+    R__b.ReadClassBuffer(AGeoBezierCone::Class(), this);
+    CacheConstants();
+  } else {
+    R__b.WriteClassBuffer(AGeoBezierCone::Class(), this);
+  }
+}
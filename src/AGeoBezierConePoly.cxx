@@ -0,0 +1,360 @@
+/******************************************************************************
+ * Copyright (C) 2006-, Akira Okumura                                         *
+ * All rights reserved.                                                       *
+ *****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// AGeoBezierConePoly
+//
+// Geometry class for a polygonal solid whose side faces are defined by a
+// Bezier curve as in AGeoBezierPgon. The curve gives the distance of each
+// face from the Z axis, i.e., the radius of the inscribed circle as in
+// TGeoPgon, and the first edge starts at phi = 0. The distances, the normals,
+// and the safety distances are calculated with the exact faces (see
+// ABezierProfile), and the polygonal sections are used only for drawing.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "AGeoBezierConePoly.h"
+
+#include "Riostream.h"
+#include "TBuffer.h"
+#include "TMath.h"
+
+ClassImp(AGeoBezierConePoly);
+
+//_____________________________________________________________________________
+AGeoBezierConePoly::AGeoBezierConePoly() : AGeoBezierPgon(), fTanSector(0) {
+  // Default constructor
+}
+
+//_____________________________________________________________________________
+AGeoBezierConePoly::AGeoBezierConePoly(Int_t nedges, Double_t r1, Double_t r2,
+                                       Double_t dz, Int_t nz)
+    : AGeoBezierPgon(0, 360, nedges, nz, r1, r2, dz) {
+  SetSections();
+}
+
+//_____________________________________________________________________________
+AGeoBezierConePoly::AGeoBezierConePoly(const char* name, Int_t nedges,
+                                       Double_t r1, Double_t r2, Double_t dz,
+                                       Int_t nz)
+    : AGeoBezierPgon(name, 0, 360, nedges, nz, r1, r2, dz) {
+  SetSections();
+}
+
+//_____________________________________________________________________________
+AGeoBezierConePoly::~AGeoBezierConePoly() {
+  // Destructor
+}
+
+//_____________________________________________________________________________
+void AGeoBezierConePoly::CacheConstants() {
+  // Convert the Bezier curve to polynomials, and cache the direction of each
+  // face
+  if (not fProfile.Set(fR1, fR2, fLength / 2., fNcontrol, fP1, fP2)) {
+    Error("CacheConstants",
+          "Z of the Bezier curve must increase monotonically");
+  }
+
+  fCosPhi.resize(fNedges);
+  fSinPhi.resize(fNedges);
+  for (Int_t i = 0; i < fNedges; i++) {
+    fCosPhi[i] = TMath::Cos((i + 0.5) * TMath::TwoPi() / fNedges);
+    fSinPhi[i] = TMath::Sin((i + 0.5) * TMath::TwoPi() / fNedges);
+  }
+  fTanSector = TMath::Tan(TMath::Pi() / fNedges);
+}
+
+//_____________________________________________________________________________
+Double_t AGeoBezierConePoly::Capacity() const {
+  // Compute capacity of the shape
+  return fNedges * fTanSector * fProfile.GetSquareIntegral();
+}
+
+//_____________________________________________________________________________
+void AGeoBezierConePoly::ComputeBBox() {
+  // Compute bounding box of the shape. The curve can be outside the sections.
+  Double_t r = fProfile.GetRmax() / TMath::Cos(TMath::Pi() / fNedges);
+
+  fDX = 0;
+  fDY = 0;
+  for (Int_t i = 0; i < fNedges; i++) {  // vertices
+    Double_t phi = i * TMath::TwoPi() / fNedges;
+    fDX = TMath::Max(TMath::Abs(r * TMath::Cos(phi)), fDX);
+    fDY = TMath::Max(TMath::Abs(r * TMath::Sin(phi)), fDY);
+  }
+  fDZ = fLength / 2.;
+  fOrigin[0] = 0;
+  fOrigin[1] = 0;
+  fOrigin[2] = 0;
+}
+
+//_____________________________________________________________________________
+void AGeoBezierConePoly::ComputeNormal(CONST53410 Double_t* point,
+                                       CONST53410 Double_t* dir,
+                                       Double_t* norm) {
+  // Compute normal to closest surface from POINT.
+
+  // Following calculation assumes that the point is very close to surfaces.
+  Double_t dz = fLength / 2.;
+  Double_t z = TMath::Max(-dz, TMath::Min(dz, point[2]));
+  Int_t k = FindSector(point[0], point[1]);
+  Double_t s = point[0] * fCosPhi[k] + point[1] * fSinPhi[k];
+  Double_t u = fProfile.FindU(z);
+
+  Double_t saf[2];
+  saf[0] = TMath::Abs(dz - TMath::Abs(point[2]));
+  saf[1] = TMath::Abs(fProfile.GetR(u) - s);
+
+  if (saf[0] < saf[1]) {  // on the XY surface
+    norm[0] = 0;
+    norm[1] = 0;
+    norm[2] = 1;
+  } else {
+    // The curve (r(u), z(u)) has the normal (dz/du, -dr/du)
+    Double_t dzdu = fProfile.GetdZ(u);
+    norm[0] = dzdu * fCosPhi[k];
+    norm[1] = dzdu * fSinPhi[k];
+    norm[2] = -fProfile.GetdR(u);
+    Double_t mag = TMath::Sqrt(dzdu * dzdu + norm[2] * norm[2]);
+    norm[0] /= mag;
+    norm[1] /= mag;
+    norm[2] /= mag;
+  }
+
+  if (norm[0] * dir[0] + norm[1] * dir[1] + norm[2] * dir[2] < 0) {
+    norm[0] = -norm[0];
+    norm[1] = -norm[1];
+    norm[2] = -norm[2];
+  }
+}
+
+//_____________________________________________________________________________
+Bool_t AGeoBezierConePoly::Contains(CONST53410 Double_t* point) const {
+  // Test if point is in this shape
+  if (TMath::Abs(point[2]) > fLength / 2.) {
+    return kFALSE;
+  }
+
+  Int_t k = FindSector(point[0], point[1]);
+
+  return point[0] * fCosPhi[k] + point[1] * fSinPhi[k] <=
+         fProfile.CalcR(point[2]);
+}
+
+//_____________________________________________________________________________
+TGeoVolume* AGeoBezierConePoly::Divide(TGeoVolume*, const char*, Int_t, Int_t,
+                                       Double_t, Double_t) {
+  Error("Divide", "Division of a polygonal Bezier cone is not implemented");
+  return 0;
+}
+
+//_____________________________________________________________________________
+Double_t AGeoBezierConePoly::DistFromInside(CONST53410 Double_t* point,
+                                            CONST53410 Double_t* dir,
+                                            Int_t iact, Double_t step,
+                                            Double_t* safe) const {
+  // compute distance from inside point to surface of the shape
+
+  // compute safe distance
+  if (iact < 3 and safe) {
+    *safe = Safety(point, kTRUE);
+    if (iact == 0) return TGeoShape::Big();
+    if (iact == 1 && step < *safe) return TGeoShape::Big();
+  }
+
+  // calculate distance
+  Double_t dz = fLength / 2.;
+  Double_t dist = TGeoShape::Big();
+  if (dir[2] < 0) {
+    dist = TMath::Max(0., (-point[2] - dz) / dir[2]);
+  } else if (dir[2] > 0) {
+    dist = TMath::Max(0., (dz - point[2]) / dir[2]);
+  }
+
+  return TMath::Min(dist, DistToSurface(point, dir, kTRUE));
+}
+
+//_____________________________________________________________________________
+Double_t AGeoBezierConePoly::DistFromOutside(CONST53410 Double_t* point,
+                                             CONST53410 Double_t* dir,
+                                             Int_t iact, Double_t step,
+                                             Double_t* safe) const {
+  // compute distance from outside point to surface of the shape
+
+  // compute safe distance
+  if (iact < 3 and safe) {
+    *safe = Safety(point, kFALSE);
+    if (iact == 0) return TGeoShape::Big();
+    if (iact == 1 && step < *safe) return TGeoShape::Big();
+  }
+
+  // calculate distance to the bottom or top surface
+  Double_t dz = fLength / 2.;
+  if (point[2] <= -dz or point[2] >= dz) {
+    Double_t zcap = point[2] <= -dz ? -dz : dz;
+    if (dir[2] * zcap >= 0) {
+      return TGeoShape::Big();
+    }
+    Double_t snxt = (zcap - point[2]) / dir[2];
+    // find extrapolated X and Y
+    Double_t xnew = point[0] + snxt * dir[0];
+    Double_t ynew = point[1] + snxt * dir[1];
+    Int_t k = FindSector(xnew, ynew);
+    if (xnew * fCosPhi[k] + ynew * fSinPhi[k] <= (zcap < 0 ? fR2 : fR1)) {
+      return snxt;
+    }
+  }
+
+  return DistToSurface(point, dir, kFALSE);
+}
+
+//_____________________________________________________________________________
+Double_t AGeoBezierConePoly::DistToSurface(CONST53410 Double_t* point,
+                                           CONST53410 Double_t* dir,
+                                           Bool_t in) const {
+  // Distance to the side faces. Only the crossings where the ray goes out of
+  // (into) the shape are taken for an inside (outside) point, so that a ray
+  // starting on a face does not stop there. A crossing is valid only inside
+  // the sector of the face, which is widened by a small tolerance so that a
+  // ray hitting an edge is not missed by both faces.
+  const Double_t kTol = 1e-9 * fLength;
+  Double_t dist = TGeoShape::Big();
+
+  for (Int_t k = 0; k < fNedges; k++) {
+    Double_t q = point[0] * fCosPhi[k] + point[1] * fSinPhi[k];
+    Double_t w = dir[0] * fCosPhi[k] + dir[1] * fSinPhi[k];
+    Double_t u[3], t[3];
+    Int_t n = fProfile.CrossFace(q, w, point[2], dir[2], u, t);
+    for (Int_t i = 0; i < n; i++) {
+      if (t[i] < -kTol or t[i] >= dist) {
+        continue;
+      }
+      // Component of the direction along the outward normal
+      Double_t dn = fProfile.GetdZ(u[i]) * w - fProfile.GetdR(u[i]) * dir[2];
+      if ((dn > 0) != in) {
+        continue;
+      }
+      Double_t l = (point[1] + t[i] * dir[1]) * fCosPhi[k] -
+                   (point[0] + t[i] * dir[0]) * fSinPhi[k];
+      if (TMath::Abs(l) <= fProfile.GetR(u[i]) * fTanSector * (1 + 1e-9)) {
+        dist = TMath::Max(0., t[i]);
+      }
+    }
+  }
+
+  return dist;
+}
+
+//_____________________________________________________________________________
+Int_t AGeoBezierConePoly::FindSector(Double_t x, Double_t y) const {
+  // Find the face whose sector contains (x, y). Its normal gives the largest
+  // projection of (x, y) among the faces.
+  Double_t width = TMath::TwoPi() / fNedges;
+  Int_t k = TMath::FloorNint(TMath::ATan2(y, x) / width);
+
+  return ((k % fNedges) + fNedges) % fNedges;
+}
+
+//_____________________________________________________________________________
+void AGeoBezierConePoly::GetBoundingCylinder(Double_t* param) const {
+  //--- Fill vector param[4] with the bounding cylinder parameters. The order
+  // is the following : Rmin, Rmax, Phi1, Phi2
+  param[0] = 0;
+  Double_t r = fProfile.GetRmax() / TMath::Cos(TMath::Pi() / fNedges);
+  param[1] = r * r;
+  param[2] = 0;
+  param[3] = 360;
+}
+
+//_____________________________________________________________________________
+void AGeoBezierConePoly::InspectShape() const {
+  // print shape parameters
+  printf("*** Shape %s: AGeoBezierConePoly ***\n", GetName());
+  printf("    N      = %d\n", fNedges);
+  printf("    R1     = %11.5f\n", fR1);
+  printf("    R2     = %11.5f\n", fR2);
+  printf("    DZ     = %11.5f\n", fLength / 2.);
+  if (fNcontrol >= 1) {
+    printf("    P1     = (%f, %f)\n", fP1.X(), fP1.Y());
+  }
+  if (fNcontrol == 2) {
+    printf("    P2     = (%f, %f)\n", fP2.X(), fP2.Y());
+  }
+  printf(" Bounding box:\n");
+  TGeoBBox::InspectShape();
+}
+
+//_____________________________________________________________________________
+Double_t AGeoBezierConePoly::Safety(CONST53410 Double_t* point,
+                                    Bool_t in) const {
+  // Compute safe distance from either outside or inside to a boundary of
+  // this shape. s - R(z), where s is the largest projection of the point on
+  // the face normals, changes at most Sqrt(1 + S^2) times the distance, where
+  // S is the maximum slope |dR/dz|.
+  Double_t dz = fLength / 2.;
+  Double_t z = point[2];
+  Int_t k = FindSector(point[0], point[1]);
+  Double_t s = point[0] * fCosPhi[k] + point[1] * fSinPhi[k];
+  Double_t slope = fProfile.GetSlopeMax();
+  Double_t c = 1. / TMath::Sqrt(1 + slope * slope);
+
+  if (in) {
+    Double_t safe = dz - TMath::Abs(z);
+    if (TMath::Abs(z) <= dz) {
+      safe = TMath::Min(safe, (fProfile.CalcR(z) - s) * c);
+    }
+    return TMath::Max(0., safe);
+  } else if (TMath::Abs(z) > dz) {
+    return TMath::Max(TMath::Abs(z) - dz, s - fProfile.GetRmax());
+  }
+
+  return TMath::Max(0., (s - fProfile.CalcR(z)) * c);
+}
+
+//_____________________________________________________________________________
+void AGeoBezierConePoly::SavePrimitive(std::ostream& out, Option_t*) {
+  // Save a primitive as a C++ statement(s) on output stream "out".
+  if (TObject::TestBit(kGeoSavePrimitive)) return;
+
+  out << "   // Shape: " << GetName() << " type: " << ClassName() << std::endl;
+  out << "   n  = " << fNedges << ";" << std::endl;
+  out << "   r1 = " << fR1 << ";" << std::endl;
+  out << "   r2 = " << fR2 << ";" << std::endl;
+  out << "   dz = " << fLength / 2. << ";" << std::endl;
+  out << "   nz = " << fNz << ";" << std::endl;
+  out << "   AGeoBezierConePoly* cone = new AGeoBezierConePoly(\""
+      << GetName() << "\", n, r1, r2, dz, nz);" << std::endl;
+  if (fNcontrol == 1) {
+    out << "   cone->SetControlPoints(" << fP1.X() << ", " << fP1.Y() << ");"
+        << std::endl;
+  } else if (fNcontrol == 2) {
+    out << "   cone->SetControlPoints(" << fP1.X() << ", " << fP1.Y() << ", "
+        << fP2.X() << ", " << fP2.Y() << ");" << std::endl;
+  }
+
+  out << "   TGeoShape* " << GetPointerName() << " = cone;" << std::endl;
+  TObject::SetBit(TGeoShape::kGeoSavePrimitive);
+}
+
+//_____________________________________________________________________________
+void AGeoBezierConePoly::SetSections() {
+  // Update the polynomials before the sections, with which the bounding box
+  // is recomputed
+  CacheConstants();
+  AGeoBezierPgon::SetSections();
+}
+
+//_____________________________________________________________________________
+void AGeoBezierConePoly::Streamer(TBuffer& R__b) {
+  // Stream an object of class AGeoBezierConePoly. The polynomials and the
+  // directions of the faces are not written, and are recomputed after reading.
+  if (R__b.IsReading()) {
+    R__b.ReadClassBuffer(AGeoBezierConePoly::Class(), this);
+    CacheConstants();
+  } else {
+    R__b.WriteClassBuffer(AGeoBezierConePoly::Class(), this);
+  }
+}
@@ -14,6 +14,7 @@
 #include "AGeoWinstonCone2D.h"
 
 #include "Riostream.h"
+#include "TBuffer.h"
 #include "TBuffer3D.h"
 #include "TBuffer3DTypes.h"
 #include "TGeoCone.h"
@@ -28,7 +29,13 @@
 ClassImp(AGeoWinstonCone2D);
 
 //_____________________________________________________________________________
-AGeoWinstonCone2D::AGeoWinstonCone2D() : TGeoBBox(0, 0, 0) {
+AGeoWinstonCone2D::AGeoWinstonCone2D()
+    : TGeoBBox(0, 0, 0),
+      fCosTheta(1),
+      fSinTheta(0),
+      fInvF(0),
+      fFcos(0),
+      fF2(0) {
   // Default constructor
   SetShapeBit(TGeoShape::kGeoBox);
 }
@@ -61,19 +68,9 @@ Double_t AGeoWinstonCone2D::CalcdRdZ(Double_t z) const noexcept(false) {
     throw std::exception();
   }
 
-  Double_t sint = TMath::Sin(fTheta);
-  Double_t cost = TMath::Cos(fTheta);
-
   Double_t t = z + fDZ;
-  Double_t a0 = t * t * sint * sint - 4. * fF * (t * cost + fF);
-  Double_t a1 = 2. * t * sint * cost + 4. * fF * sint;
-  Double_t a2 = cost * cost;
-  Double_t da0dt = 2 * t * sint * sint - 4 * fF * cost;
-  Double_t da1dt = 2 * sint * cost;
-
-  Double_t drdz = (-da1dt + (a1 * da1dt - 2 * da0dt * a2) /
-                                TMath::Sqrt(a1 * a1 - 4 * a0 * a2)) /
-                  (2 * a2);
+  Double_t drdz =
+      fRconst[1] + fRconst[2] * fFcos / (2 * TMath::Sqrt(fFcos * t + fF2));
 
   return drdz;
 }
@@ -84,19 +81,33 @@ Double_t AGeoWinstonCone2D::CalcR(Double_t z) const noexcept(false) {
     throw std::exception();
   }
 
-  Double_t sint = TMath::Sin(fTheta);
-  Double_t cost = TMath::Cos(fTheta);
-
   Double_t t = z + fDZ;
-  Double_t a0 = t * t * sint * sint - 4. * fF * (t * cost + fF);
-  Double_t a1 = 2. * t * sint * cost + 4. * fF * sint;
-  Double_t a2 = cost * cost;
-
-  Double_t r = (-a1 + TMath::Sqrt(a1 * a1 - 4. * a0 * a2)) / (2 * a2) - fR2;
+  Double_t r = fRconst[0] + fRconst[1] * t +
+               fRconst[2] * TMath::Sqrt(fFcos * t + fF2);
 
   return r;
 }
 
+//_____________________________________________________________________________
+void AGeoWinstonCone2D::CacheConstants() {
+  // Cache the constants derived from the shape parameters. Called whenever
+  // the dimensions are changed and after the shape is read from a file.
+  //
+  // With t = z + fDZ, R(z) + fR2 is the positive root of a2 r^2 + a1 r + a0,
+  // where a0 = t^2 sin^2 - 4f(t cos + f), a1 = 2t sin cos + 4f sin and
+  // a2 = cos^2. The discriminant reduces to 16f(t cos + f), and thus
+  //   R(z) = -2f sin/cos^2 - fR2 - (sin/cos)t + (2/cos^2)Sqrt(f cos t + f^2)
+  fCosTheta = TMath::Cos(fTheta);
+  fSinTheta = TMath::Sin(fTheta);
+  fInvF = fF != 0 ? 1 / fF : 0;
+  Double_t cos2 = fCosTheta * fCosTheta;
+  fRconst[0] = -2 * fF * fSinTheta / cos2 - fR2;
+  fRconst[1] = -fSinTheta / fCosTheta;
+  fRconst[2] = 2 / cos2;
+  fFcos = fF * fCosTheta;
+  fF2 = fF * fF;
+}
+
 //_____________________________________________________________________________
 Double_t AGeoWinstonCone2D::Capacity() const {
   // Compute capacity of the shape in [length^3]
@@ -231,8 +242,8 @@ Double_t AGeoWinstonCone2D::DistFromInside(CONST53410 Double_t* point,
   Double_t d[4];
   d[0] = dz;
   d[1] = dy;
-  d[2] = DistToParabola(point, dir, 0., TMath::Pi());
-  d[3] = DistToParabola(point, dir, TMath::Pi(), TMath::Pi());
+  d[2] = DistToRotatedParabola(point, dir, 1, 0, 0, 1);   // phi = 0
+  d[3] = DistToRotatedParabola(point, dir, -1, 0, 0, 1);  // phi = Pi
 
   return d[TMath::LocMin(4, d)];
 }
@@ -302,7 +313,7 @@ Double_t AGeoWinstonCone2D::DistFromOutside(CONST53410 Double_t* point,
   }
 
   Double_t d[2];
-  Double_t snxt = DistToParabola(point, dir, 0., TMath::Pi());
+  Double_t snxt = DistToRotatedParabola(point, dir, 1, 0, 0, 1);
   Double_t ynew = point[1] + snxt * dir[1];
   if (TMath::Abs(ynew) <= fDY) {
     d[0] = snxt;
@@ -310,7 +321,7 @@ Double_t AGeoWinstonCone2D::DistFromOutside(CONST53410 Double_t* point,
     d[0] = TGeoShape::Big();
   }
 
-  snxt = DistToParabola(point, dir, TMath::Pi(), TMath::Pi());
+  snxt = DistToRotatedParabola(point, dir, -1, 0, 0, 1);
   ynew = point[1] + snxt * dir[1];
   if (TMath::Abs(ynew) <= fDY) {
     d[1] = snxt;
@@ -325,106 +336,8 @@ Double_t AGeoWinstonCone2D::DistFromOutside(CONST53410 Double_t* point,
 Double_t AGeoWinstonCone2D::DistToParabola(CONST53410 Double_t* point,
                                            CONST53410 Double_t* dir,
                                            Double_t phi, Double_t open) const {
-  Double_t x = TMath::Cos(phi) * point[0] + TMath::Sin(phi) * point[1];
-  Double_t y = -TMath::Sin(phi) * point[0] + TMath::Cos(phi) * point[1];
-  Double_t z = point[2];
-  Double_t px = TMath::Cos(phi) * dir[0] + TMath::Sin(phi) * dir[1];
-  Double_t py = -TMath::Sin(phi) * dir[0] + TMath::Cos(phi) * dir[1];
-  Double_t pz = dir[2];
-
-  if (px == 0 and pz == 0) {
-    return TGeoShape::Big();
-  }
-
-  Double_t cost = TMath::Cos(fTheta);
-  Double_t sint = TMath::Sin(fTheta);
-  // coordinates in the parabola frame inside the 1st quadrant
-  // The focal point is at (X, Z) = (0, f)
-  Double_t X = cost * (x + fR2) + (z + fDZ) * sint;
-  Double_t Z = -sint * (x + fR2) + (z + fDZ) * cost + fF;
-  Double_t alpha = TMath::ATan2(pz, px);  // inclination in the x-z plane
-  Double_t ALPHA = alpha - fTheta;        // inclination in the X-Z plane
-  Double_t tanA = TMath::Tan(ALPHA);
-
-  Double_t dist[2];
-
-  Double_t tmp = tanA * tanA - (X * tanA - Z) / fF;
-  if (tmp < 0) {
-    dist[0] = TGeoShape::Big();
-    dist[1] = TGeoShape::Big();
-  } else {
-    Double_t X_cross_p, X_cross_m;
-    if (fDZ * 2 / TMath::Abs(tanA) <
-        TGeoShape::Tolerance()) {  // direction is almost parallel to Z axis
-      X_cross_p = X;
-      X_cross_m = X;
-    } else {
-      X_cross_p = 2 * fF * (tanA + TMath::Sqrt(tmp));
-      X_cross_m = 2 * fF * (tanA - TMath::Sqrt(tmp));
-    }
-    Double_t Z_cross_p = X_cross_p * X_cross_p / 4. / fF;
-    Double_t Z_cross_m = X_cross_m * X_cross_m / 4. / fF;
-
-    Double_t x_cross_p = cost * X_cross_p - sint * (Z_cross_p - fF) - fR2;
-    Double_t x_cross_m = cost * X_cross_m - sint * (Z_cross_m - fF) - fR2;
-    Double_t z_cross_p = sint * X_cross_p + cost * (Z_cross_p - fF) - fDZ;
-    Double_t z_cross_m = sint * X_cross_m + cost * (Z_cross_m - fF) - fDZ;
-    Double_t y_cross_p;
-    Double_t y_cross_m;
-
-    // Avoid using meaningless values
-    // such as py/pz when |py| << 1 and |pz| << 1
-    // and py/px when |py| << 1 and |px| << 1
-    if (TMath::Abs(px) <= TMath::Abs(pz) and TMath::Abs(py) <= TMath::Abs(pz)) {
-      y_cross_p = y + (z_cross_p - z) * py / pz;
-      y_cross_m = y + (z_cross_m - z) * py / pz;
-    } else if (TMath::Abs(py) <= TMath::Abs(px) and
-               TMath::Abs(pz) <= TMath::Abs(px)) {
-      y_cross_p = y + (x_cross_p - x) * py / px;
-      y_cross_m = y + (x_cross_m - x) * py / px;
-    } else {
-      // Checking (px == 0) is not enough because x is sometime, e.g., 1e-17,
-      // which makes the y_cross_p/m too big.
-      // In the case of |px| << 1 and |pz| << 1, |py| is almost 1, and thus
-      // the photon will not cross the parabolas
-      y_cross_p = y + (TMath::Abs(px) < 1e-5 ? (z_cross_p - z) * py / pz
-                                             : (x_cross_p - x) * py / px);
-      y_cross_m = y + (TMath::Abs(px) < 1e-5 ? (z_cross_m - z) * py / pz
-                                             : (x_cross_m - x) * py / px);
-    }
-
-    Double_t dx = x_cross_p - x;
-    Double_t dy = y_cross_p - y;
-    Double_t dz = z_cross_p - z;
-
-    if (x_cross_p < fR2 or fR1 < x_cross_p or z_cross_p < -fDZ or
-        fDZ < z_cross_p or dx * px + dz * pz < 0) {
-      dist[0] = TGeoShape::Big();
-    } else {
-      if (TMath::Abs(TMath::ATan2(y_cross_p, x_cross_p)) <= open / 2.) {
-        dist[0] = TMath::Sqrt(dx * dx + dy * dy + dz * dz);
-      } else {
-        dist[0] = TGeoShape::Big();
-      }
-    }
-
-    dx = x_cross_m - x;
-    dy = y_cross_m - y;
-    dz = z_cross_m - z;
-
-    if (x_cross_m < fR2 or fR1 < x_cross_m or z_cross_m < -fDZ or
-        fDZ < z_cross_m or dx * px + dz * pz < 0) {
-      dist[1] = TGeoShape::Big();
-    } else {
-      if (TMath::Abs(TMath::ATan2(y_cross_m, x_cross_m)) <= open / 2.) {
-        dist[1] = TMath::Sqrt(dx * dx + dy * dy + dz * dz);
-      } else {
-        dist[1] = TGeoShape::Big();
-      }
-    }
-  }
-
-  return TMath::Min(dist[0], dist[1]);
+  return DistToRotatedParabola(point, dir, TMath::Cos(phi), TMath::Sin(phi),
+                               TMath::Cos(open / 2), TMath::Sin(open / 2));
 }
 
 //_____________________________________________________________________________
@@ -564,6 +477,8 @@ void AGeoWinstonCone2D::SetWinstonDimensions(Double_t r1, Double_t r2,
   fDZ = (fR1 + fR2) / TMath::Tan(fTheta) / 2.;
 
   fF = fR2 * (1 + TMath::Sin(fTheta));
+
+  CacheConstants();
 }
 
 //_____________________________________________________________________________
@@ -735,6 +650,18 @@ void AGeoWinstonCone2D::SetSegsAndPols(TBuffer3D& buff) const {
   buff.fPols[index++] = 8 * n + 0;
 }
 
+//_____________________________________________________________________________
+void AGeoWinstonCone2D::Streamer(TBuffer& R__b) {
+  // Stream an object of class AGeoWinstonCone2D. The cached constants are not
+  // written, and are recomputed after reading.
+  if (R__b.IsReading()) {
+    R__b.ReadClassBuffer(AGeoWinstonCone2D::Class(), this);
+    AGeoWinstonCone2D::CacheConstants();
+  } else {
+    R__b.WriteClassBuffer(AGeoWinstonCone2D::Class(), this);
+  }
+}
+
 //_____________________________________________________________________________
 void AGeoWinstonCone2D::Sizeof3D() const {
   ///// obsolete - to be removed
@@ -14,6 +14,7 @@
 #include "AGeoWinstonConePoly.h"
 
 #include "Riostream.h"
+#include "TBuffer.h"
 #include "TBuffer3D.h"
 #include "TBuffer3DTypes.h"
 #include "TGeoCone.h"
@@ -28,7 +29,8 @@
 ClassImp(AGeoWinstonConePoly);
 
 //_____________________________________________________________________________
-AGeoWinstonConePoly::AGeoWinstonConePoly() : AGeoWinstonCone2D() {
+AGeoWinstonConePoly::AGeoWinstonConePoly()
+    : AGeoWinstonCone2D(), fCosSector(1), fSinSector(0), fRcirc(0) {
   // Default constructor
 }
 
@@ -52,6 +54,23 @@ AGeoWinstonConePoly::~AGeoWinstonConePoly() {
   // Destructor
 }
 
+//_____________________________________________________________________________
+void AGeoWinstonConePoly::CacheConstants() {
+  // Cache the rotation of each face in addition to the constants of the base
+  // class
+  AGeoWinstonCone2D::CacheConstants();
+
+  fCosPhi.resize(fPolyN);
+  fSinPhi.resize(fPolyN);
+  for (Int_t i = 0; i < fPolyN; i++) {
+    fCosPhi[i] = TMath::Cos(i * TMath::TwoPi() / fPolyN);
+    fSinPhi[i] = TMath::Sin(i * TMath::TwoPi() / fPolyN);
+  }
+  fCosSector = TMath::Cos(TMath::Pi() / fPolyN);
+  fSinSector = TMath::Sin(TMath::Pi() / fPolyN);
+  fRcirc = fR1 / fCosSector;
+}
+
 //_____________________________________________________________________________
 void AGeoWinstonConePoly::ComputeBBox() {
   // Compute bounding box of the shape
@@ -161,20 +180,24 @@ Double_t AGeoWinstonConePoly::DistFromInside(CONST53410 Double_t* point,
   }
 
   // calculate distance
-  Double_t d[1 + fPolyN];
-  d[0] = TGeoShape::Big();
+  Double_t dist = TGeoShape::Big();
   if (dir[2] < 0) {
-    d[0] = (-point[2] - fDZ) / dir[2];
+    dist = (-point[2] - fDZ) / dir[2];
   } else if (dir[2] > 0) {
-    d[0] = (fDZ - point[2]) / dir[2];
+    dist = (fDZ - point[2]) / dir[2];
   }
 
-  for (Int_t i = 0; i < fPolyN; i++) {
-    d[1 + i] =
-        DistToParabola(point, dir, i * TMath::TwoPi() / fPolyN, TMath::Pi());
+  // The ray exits through the face of the sector where it leaves the shape,
+  // and no face can be crossed before that
+  Int_t first;
+  Int_t n = FindFaces(point, dir, kTRUE, first);
+  for (Int_t i = 0; i < n; i++) {
+    Int_t j = (first + i) % fPolyN;
+    dist = TMath::Min(dist, DistToRotatedParabola(point, dir, fCosPhi[j],
+                                                  fSinPhi[j], 0, 1));
   }
 
-  return d[TMath::LocMin(1 + fPolyN, d)];
+  return dist;
 }
 
 //_____________________________________________________________________________
@@ -216,13 +239,102 @@ Double_t AGeoWinstonConePoly::DistFromOutside(CONST53410 Double_t* point,
     }
   }
 
-  Double_t d[fPolyN];
-  for (Int_t i = 0; i < fPolyN; i++) {
-    d[i] = DistToParabola(point, dir, i * TMath::TwoPi() / fPolyN,
-                          TMath::TwoPi() / fPolyN);
+  Double_t dist = TGeoShape::Big();
+  Int_t first;
+  Int_t n = FindFaces(point, dir, kFALSE, first);
+  for (Int_t i = 0; i < n; i++) {
+    Int_t j = (first + i) % fPolyN;
+    dist = TMath::Min(dist,
+                      DistToRotatedParabola(point, dir, fCosPhi[j], fSinPhi[j],
+                                            fCosSector, fSinSector));
   }
 
-  return d[TMath::LocMin(fPolyN, d)];
+  return dist;
+}
+
+//_____________________________________________________________________________
+Int_t AGeoWinstonConePoly::FindFaces(CONST53410 Double_t* point,
+                                     CONST53410 Double_t* dir, Bool_t in,
+                                     Int_t& first) const {
+  // Find the faces that the ray can cross. A face is crossed only inside its
+  // own sector (|phi - phi_i| <= Pi/fPolyN), inside the z slab and inside the
+  // circumscribed cylinder, so the candidates are the sectors swept by the XY
+  // projection of the ray segment within the slab and the cylinder. The sweep
+  // is widened by a small tolerance to keep both faces at an edge.
+  //
+  // Return the number of candidate faces counted counterclockwise from
+  // "first". All the faces are returned if the sweep is ambiguous, e.g., the
+  // segment passes near the Z axis, if an inside point is found outside the
+  // slab or the cylinder, or if the ray leaves a face that it starts on. The
+  // first crossing need not be the exit point in these cases. No face is
+  // returned if an outside ray misses them.
+  first = 0;
+  const Double_t kTol = 1e-9 * (fDZ + fRcirc);
+  const Int_t kNone = in ? fPolyN : 0;
+
+  if (in) {
+    Double_t width = TMath::TwoPi() / fPolyN;
+    Double_t phi = TMath::ATan2(point[1], point[0]);
+    Int_t k = TMath::FloorNint((phi + width / 2) / width);
+    k = ((k % fPolyN) + fPolyN) % fPolyN;
+    Double_t z = TMath::Max(-fDZ, TMath::Min(fDZ, point[2]));
+    if (point[0] * fCosPhi[k] + point[1] * fSinPhi[k] > CalcR(z) - kTol) {
+      // On the face. Still fine if the ray goes inside, e.g., after reflection
+      Double_t dn = dir[0] * fCosPhi[k] + dir[1] * fSinPhi[k] -
+                    dir[2] * CalcdRdZ(z);
+      if (dn > -1e-6) return fPolyN;
+    }
+  }
+
+  Double_t tmin = -kTol;
+  Double_t tmax = TGeoShape::Big();
+  if (dir[2] != 0) {
+    Double_t t1 = (-fDZ - kTol - point[2]) / dir[2];
+    Double_t t2 = (fDZ + kTol - point[2]) / dir[2];
+    tmin = TMath::Max(tmin, TMath::Min(t1, t2));
+    tmax = TMath::Min(tmax, TMath::Max(t1, t2));
+  } else if (TMath::Abs(point[2]) > fDZ + kTol) {
+    return kNone;
+  }
+
+  Double_t a = dir[0] * dir[0] + dir[1] * dir[1];
+  Double_t b = point[0] * dir[0] + point[1] * dir[1];
+  Double_t c = point[0] * point[0] + point[1] * point[1] -
+               (fRcirc + kTol) * (fRcirc + kTol);
+  if (a > 0) {
+    Double_t disc = b * b - a * c;
+    if (disc < 0) return kNone;
+    Double_t sq = TMath::Sqrt(disc);
+    tmin = TMath::Max(tmin, (-b - sq) / a);
+    tmax = TMath::Min(tmax, (-b + sq) / a);
+  } else if (c > 0) {
+    return kNone;
+  }
+  if (tmin > tmax) return kNone;
+
+  Double_t phi1 =
+      TMath::ATan2(point[1] + tmin * dir[1], point[0] + tmin * dir[0]);
+  Double_t phi2 =
+      TMath::ATan2(point[1] + tmax * dir[1], point[0] + tmax * dir[0]);
+  Double_t sweep = phi2 - phi1;
+  if (sweep > TMath::Pi()) {
+    sweep -= TMath::TwoPi();
+  } else if (sweep < -TMath::Pi()) {
+    sweep += TMath::TwoPi();
+  }
+  if (TMath::Abs(sweep) > TMath::Pi() - 0.1) return fPolyN;
+
+  Double_t eps = 1e-9 + kTol / fR2;
+  Double_t lo = TMath::Min(phi1, phi1 + sweep) - eps;
+  Double_t hi = TMath::Max(phi1, phi1 + sweep) + eps;
+  Double_t width = TMath::TwoPi() / fPolyN;
+  Int_t klo = TMath::FloorNint((lo + width / 2) / width);
+  Int_t khi = TMath::FloorNint((hi + width / 2) / width);
+  if (khi - klo + 1 >= fPolyN) return fPolyN;
+
+  first = ((klo % fPolyN) + fPolyN) % fPolyN;
+
+  return khi - klo + 1;
 }
 
 //_____________________________________________________________________________
@@ -292,6 +404,14 @@ Int_t AGeoWinstonConePoly::GetNmeshVertices() const {
 //_____________________________________________________________________________
 Bool_t AGeoWinstonConePoly::InsidePolygon(Double_t x, Double_t y,
                                           Double_t r) const {
+  // Inside the inscribed circle, or outside the circumscribed one with margin
+  Double_t rad = TMath::Sqrt(x * x + y * y);
+  if (rad <= r) {
+    return kTRUE;
+  } else if (rad * fCosSector > r + 1e-9 * rad) {
+    return kFALSE;
+  }
+
   Double_t theta = TMath::ATan2(y, x);
 
   while (theta > TMath::Pi() / fPolyN) {
@@ -301,7 +421,7 @@ Bool_t AGeoWinstonConePoly::InsidePolygon(Double_t x, Double_t y,
     theta += TMath::TwoPi() / fPolyN;
   }
 
-  if (TMath::Sqrt(x * x + y * y) * TMath::Cos(theta) > r) {
+  if (rad * TMath::Cos(theta) > r) {
     return kFALSE;
   }
 
@@ -383,6 +503,8 @@ void AGeoWinstonConePoly::SetWinstonDimensions(Double_t r1, Double_t r2,
   fDZ = (fR1 + fR2) / TMath::Tan(fTheta) / 2.;
 
   fF = fR2 * (1 + TMath::Sin(fTheta));
+
+  CacheConstants();
 }
 
 //_____________________________________________________________________________
@@ -539,6 +661,18 @@ void AGeoWinstonConePoly::SetSegsAndPols(TBuffer3D& buff) const {
   }
 }
 
+//_____________________________________________________________________________
+void AGeoWinstonConePoly::Streamer(TBuffer& R__b) {
+  // Stream an object of class AGeoWinstonConePoly. The cached constants are
+  // not written, and are recomputed after reading.
+  if (R__b.IsReading()) {
+    R__b.ReadClassBuffer(AGeoWinstonConePoly::Class(), this);
+    CacheConstants();
+  } else {
+    R__b.WriteClassBuffer(AGeoWinstonConePoly::Class(), this);
+  }
+}
+
 //_____________________________________________________________________________
 void AGeoWinstonConePoly::Sizeof3D() const {
   ///// obsolete - to be removed
@@ -9,8 +9,19 @@
 //
 // Mirror class
 //
+// The reflectance can be given as a constant, a TGraph (v.s. wavelength), a
+// TH2 or a TGraph2D (v.s. wavelength and angle). TGraph2D::Interpolate does a
+// Delaunay search and modifies the graph internally in every call, so it is
+// slow and cannot be used by several threads at the same time. If
+// UseReflectanceGrid() is called, the reflectance data are resampled on a
+// dense regular grid of wavelength x angle when the geometry is closed (or
+// before tracing if the data have been changed), and GetReflectance does only
+// an O(1) bilinear interpolation without modifying anything.
+//
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
+
 #include "AMirror.h"
 #include "TGraph.h"
 #include "TGraph2D.h"
@@ -18,7 +29,14 @@
 ClassImp(AMirror);
 
 //_____________________________________________________________________________
-AMirror::AMirror() {
+AMirror::AMirror()
+    : fGridNlambda(0),
+      fGridNangle(0),
+      fGridLambdaMin(0),
+      fGridInvDlambda(0),
+      fGridAngleMin(0),
+      fGridInvDangle(0),
+      fGridNcolumns(0) {
   // Default constructor
   fReflectance = 1.0;
   SetLineColor(16);
@@ -27,7 +45,14 @@ AMirror::AMirror() {
 //_____________________________________________________________________________
 AMirror::AMirror(const char* name, const TGeoShape* shape,
                  const TGeoMedium* med)
-    : AOpticalComponent(name, shape, med) {
+    : AOpticalComponent(name, shape, med),
+      fGridNlambda(0),
+      fGridNangle(0),
+      fGridLambdaMin(0),
+      fGridInvDlambda(0),
+      fGridAngleMin(0),
+      fGridInvDangle(0),
+      fGridNcolumns(0) {
   fReflectance = 1.0;
   SetLineColor(16);
 }
@@ -36,15 +61,90 @@ AMirror::AMirror(const char* name, const TGeoShape* shape,
 AMirror::~AMirror() {}
 
 //_____________________________________________________________________________
-Double_t AMirror::GetReflectance(Double_t lambda, Double_t angle) {
+void AMirror::BuildReflectanceGrid() {
+  // Resample the reflectance data on the grid specified by UseReflectanceGrid.
+  // The grid covers the range of the data, i.e., the data points of TGraph
+  // and TGraph2D, or the bin centers of TH2. This is called by
+  // AOpticsManager::CloseGeometry and before tracing when the grid is missing,
+  // but must be called by hand if the data have been modified in place.
+  fReflectanceGrid.clear();
+  if (fGridNlambda <= 0 or not(fReflectance2D or fReflectanceTH2 or
+                               fReflectance1D)) {
+    return;
+  }
+
+  Double_t lambda_min, lambda_max, angle_min = 0, angle_max = 0;
+  Int_t n_angle = fGridNangle;
+  if (fReflectance2D) {
+    lambda_min = fReflectance2D->GetXmin();
+    lambda_max = fReflectance2D->GetXmax();
+    angle_min = fReflectance2D->GetYmin();
+    angle_max = fReflectance2D->GetYmax();
+  } else if (fReflectanceTH2) {
+    const TAxis* xaxis = fReflectanceTH2->GetXaxis();
+    const TAxis* yaxis = fReflectanceTH2->GetYaxis();
+    lambda_min = xaxis->GetBinCenter(1);
+    lambda_max = xaxis->GetBinCenter(xaxis->GetNbins());
+    angle_min = yaxis->GetBinCenter(1);
+    angle_max = yaxis->GetBinCenter(yaxis->GetNbins());
+  } else {
+    const Double_t* x = fReflectance1D->GetX();
+    Int_t n = fReflectance1D->GetN();
+    if (n == 0) {
+      return;
+    }
+    lambda_min = *std::min_element(x, x + n);
+    lambda_max = *std::max_element(x, x + n);
+    n_angle = 1;  // independent of the angle
+  }
+
+  if (lambda_max <= lambda_min or (n_angle > 1 and angle_max <= angle_min)) {
+    return;  // too few data points to make a grid
+  }
+
+  fGridLambdaMin = lambda_min;
+  fGridInvDlambda = (fGridNlambda - 1) / (lambda_max - lambda_min);
+  fGridAngleMin = angle_min;
+  fGridInvDangle = n_angle > 1 ? (n_angle - 1) / (angle_max - angle_min) : 0;
+
+  // Evaluate the data directly because GetReflectance would use the grid
+  std::vector<Double_t> grid(fGridNlambda * n_angle);
+  for (Int_t i = 0; i < fGridNlambda; ++i) {
+    Double_t lambda = lambda_min + i / fGridInvDlambda;
+    for (Int_t j = 0; j < n_angle; ++j) {
+      Double_t angle = n_angle > 1 ? angle_min + j / fGridInvDangle : 0;
+      Double_t ref;
+      if (fReflectance2D) {
+        ref = fReflectance2D->Interpolate(lambda, angle);
+      } else if (fReflectanceTH2) {
+        ref = fReflectanceTH2->Interpolate(lambda, angle);
+      } else {
+        ref = fReflectance1D->Eval(lambda);
+      }
+      grid[i * n_angle + j] = ref;
+    }
+  }
+
+  fGridNcolumns = n_angle;
+  fReflectanceGrid.swap(grid);
+}
+
+//_____________________________________________________________________________
+Double_t AMirror::GetReflectance(Double_t lambda, Double_t angle) const {
   // Return mirror reflectance for a photon whose wavelength is lambda, and
   // whose incident angle is "angle" (rad)
-  // This method should be const but TGraph2D::Interpolate and TH2::Interpolate
-  // are non-const methods.
+  // If the reflectance grid is available, this method is thread safe. Without
+  // the grid, TGraph2D::Interpolate modifies the graph internally and must not
+  // be called from several threads at the same time.
   Double_t ret;
 
-  if (fReflectance2D) {
-    ret = fReflectance2D->Interpolate(lambda, angle); // non-const as of 6.18
+  if (InterpolateReflectanceGrid(lambda, angle, ret)) {
+    // done
+  } else if (fReflectance2D) {
+    // A TGraph2D gives 0 outside the data points. The graph is not touched
+    // at all once the grid is made.
+    ret = HasReflectanceGrid() ? 0
+                               : fReflectance2D->Interpolate(lambda, angle);
   } else if (fReflectanceTH2) {
     ret = fReflectanceTH2->Interpolate(lambda, angle); // const since ROOT 6.19
   } else if (fReflectance1D) {
@@ -58,3 +158,51 @@ Double_t AMirror::GetReflectance(Double_t lambda, Double_t angle) {
 
   return ret;
 }
+
+//_____________________________________________________________________________
+Bool_t AMirror::InterpolateReflectanceGrid(Double_t lambda, Double_t angle,
+                                           Double_t& reflectance) const {
+  // Bilinear interpolation on the reflectance grid. Return kFALSE if the grid
+  // is not available or (lambda, angle) is outside the grid.
+  if (fReflectanceGrid.empty()) {
+    return kFALSE;
+  }
+
+  Double_t x = (lambda - fGridLambdaMin) * fGridInvDlambda;
+  Double_t y =
+      fGridNcolumns > 1 ? (angle - fGridAngleMin) * fGridInvDangle : 0;
+  if (not(x >= 0 and x <= fGridNlambda - 1 and y >= 0 and
+          y <= fGridNcolumns - 1)) {
+    return kFALSE;
+  }
+
+  Int_t i = std::min(Int_t(x), fGridNlambda - 2);
+  Double_t fx = x - i;
+  const Double_t* v0 = &fReflectanceGrid[i * fGridNcolumns];
+  const Double_t* v1 = v0 + fGridNcolumns;
+
+  if (fGridNcolumns == 1) {
+    reflectance = (1 - fx) * v0[0] + fx * v1[0];
+  } else {
+    Int_t j = std::min(Int_t(y), fGridNcolumns - 2);
+    Double_t fy = y - j;
+    reflectance = (1 - fx) * ((1 - fy) * v0[j] + fy * v0[j + 1]) +
+                  fx * ((1 - fy) * v1[j] + fy * v1[j + 1]);
+  }
+
+  return kTRUE;
+}
+
+//_____________________________________________________________________________
+void AMirror::UseReflectanceGrid(Int_t n_lambda, Int_t n_angle) {
+  // Use a reflectance grid of n_lambda x n_angle nodes (see
+  // BuildReflectanceGrid). The angle nodes are not used for a TGraph.
+  // n_lambda = 0 disables the grid.
+  if (n_lambda != 0 and (n_lambda < 2 or n_angle < 2)) {
+    Error("UseReflectanceGrid", "At least 2 x 2 nodes are needed");
+    return;
+  }
+  fGridNlambda = n_lambda;
+  fGridNangle = n_angle;
+  fReflectanceGrid.clear();
+}
@@ -9,12 +9,16 @@
 //
 ///////////////////////////////////////////////////////////////////////////////
 
-#include "TMatrixDSym.h"
+#include "TDirectory.h"
+#include "TError.h"
+#include "TFile.h"
+#include "TMD5.h"
+#include "TSystem.h"
 
 #include "AMultilayer.h"
-#include "A2x2ComplexMatrix.h"
 #include "AOpticsManager.h"
 
+#include <algorithm>
 #include <complex>
 #include <iostream>
 
@@ -55,6 +59,90 @@ void interface_rt(AMultilayer::EPolarization polarization,
   }
 }
 
+namespace {
+
+void interface_rt_cos(AMultilayer::EPolarization polarization,
+                      std::complex<Double_t> n_i,
+                      std::complex<Double_t> n_f,
+                      std::complex<Double_t> cos_th_i,
+                      std::complex<Double_t> cos_th_f,
+                      std::complex<Double_t>& r,
+                      std::complex<Double_t>& t) {
+  // Same as interface_rt but takes precalculated cos(th_i) and cos(th_f)
+  auto ii = n_i * cos_th_i;
+  if (polarization == AMultilayer::kS) {
+    auto ff = n_f * cos_th_f;
+    r = (ii - ff) / (ii + ff);
+    t = 2. * ii / (ii + ff);
+  } else {
+    auto fi = n_f * cos_th_i;
+    auto _if = n_i * cos_th_f;
+    r = (fi - _if) / (fi + _if);
+    t = 2. * ii / (fi + _if);
+  }
+}
+
+std::shared_ptr<const AMultilayerTable> ReadTableCache(const char* path) {
+  // Read a table written by WriteTableCache. Return null if not available.
+  if (gSystem->AccessPathName(path)) {  // kTRUE if the file does not exist
+    return nullptr;
+  }
+
+  TDirectory::TContext context;  // restore gDirectory at return
+  std::unique_ptr<TFile> file(TFile::Open(path, "READ"));
+  if (not file or file->IsZombie()) {
+    return nullptr;
+  }
+
+  AMultilayerTable* table = 0;
+  file->GetObject("table", table);
+
+  return std::shared_ptr<const AMultilayerTable>(table);
+}
+
+void WriteTableCache(const char* path, const char* dir,
+                     const AMultilayerTable& table) {
+  // Write a table into a temporary file first and rename it, so that other
+  // processes sharing the cache directory never read an incomplete file
+  gSystem->mkdir(dir, kTRUE);
+  std::string tmp = Form("%s.%d.tmp", path, gSystem->GetPid());
+
+  TDirectory::TContext context;  // restore gDirectory at return
+  std::unique_ptr<TFile> file(TFile::Open(tmp.c_str(), "RECREATE"));
+  if (not file or file->IsZombie()) {
+    Error("WriteTableCache", "Cannot create %s", tmp.c_str());
+    return;
+  }
+  table.Write("table");
+  file->Close();
+
+  if (gSystem->Rename(tmp.c_str(), path) != 0) {
+    gSystem->Unlink(tmp.c_str());
+  }
+}
+
+}  // namespace
+
+struct AMultilayer::ATMMWorkspace {
+  // Intermediate values of CoherentTMM reused among calls in the same thread
+  std::vector<std::complex<Double_t>> fN;         // refractive indices
+  std::vector<std::complex<Double_t>> fTh;        // propagation angles
+  std::vector<std::complex<Double_t>> fCosTh;     // cosines of the angles
+  std::vector<std::complex<Double_t>> fPhaseNeg;  // exp(-j delta)
+  std::vector<std::complex<Double_t>> fPhasePos;  // exp(j delta)
+  std::vector<std::complex<Double_t>> fKz;        // d(delta)/d(thickness)
+  std::vector<std::complex<Double_t>> fIncN;   // indices in IncoherentTMM
+  std::vector<std::complex<Double_t>> fIncTh;  // angles in IncoherentTMM
+
+  // Used only by the gradient calculations
+  std::vector<std::complex<Double_t>> fPrefix;  // A_0 M_1 ... M_{i-1}
+  std::vector<std::complex<Double_t>> fM;       // M_i
+  std::vector<Double_t> fGrad;     // dR, dT, dR_bwd and dT_bwd of each layer
+  std::vector<Double_t> fIncL;     // L_k and the product before it
+  std::vector<Double_t> fIncRT;    // R_fwd, T_fwd, R_bwd, T_bwd and dP/P
+  std::vector<Double_t> fIncGrad;  // derivatives of R_fwd, T_fwd, etc.
+};
+
 Double_t R_from_r(std::complex<Double_t> r) {
   /*
   Calculate reflected power R, starting with reflection amplitude r.
@@ -105,7 +193,7 @@ void interface_RT(AMultilayer::EPolarization polarization,
 
 AMultilayer::AMultilayer(std::shared_ptr<ARefractiveIndex> top,
                          std::shared_ptr<ARefractiveIndex> bottom)
-    : fNthreads(1) {
+    : fNthreads(1), fThreadPool(nullptr) {
   fRefractiveIndexList.push_back(bottom);
   fThicknessList.push_back(inf);
   Bool_t coherent = kFALSE;
@@ -151,25 +239,24 @@ Bool_t AMultilayer::IsForwardAngle(std::complex<Double_t> n,
     answer = ncostheta.real() > 0;
   }
   // double-check the answer ... can't be too careful!
-  std::string error_string(
-      Form("It's not clear which beam is incoming vs outgoing. Weird"
-           " index maybe?\n"
-           "n: %.3e + %.3ei   angle: %.3e + %.3ei",
-           n.real(), n.imag(), theta.real(), theta.imag()));
+  // The error message is formatted only when it is needed because this
+  // function is called several times per TMM calculation
+  Bool_t consistent;
   if (answer == true) {
-    if (ncostheta.imag() <= -100 * EPSILON)
-      Error("IsForwardAngle", "%s", error_string.c_str());
-    if (ncostheta.real() <= -100 * EPSILON)
-      Error("IsForwardAngle", "%s", error_string.c_str());
-    if ((n * std::cos(std::conj(theta))).real() <= -100 * EPSILON)
-      Error("IsForwardAngle", "%s", error_string.c_str());
+    consistent = ncostheta.imag() > -100 * EPSILON and
+                 ncostheta.real() > -100 * EPSILON and
+                 (n * std::cos(std::conj(theta))).real() > -100 * EPSILON;
   } else {
-    if (ncostheta.imag() >= 100 * EPSILON)
-      Error("IsForwardAngle", "%s", error_string.c_str());
-    if (ncostheta.real() >= 100 * EPSILON)
-      Error("IsForwardAngle", "%s", error_string.c_str());
-    if ((n * std::cos(std::conj(theta))).real() < 100 * EPSILON)
-      Error("IsForwardAngle", "%s", error_string.c_str());
+    consistent = ncostheta.imag() < 100 * EPSILON and
+                 ncostheta.real() < 100 * EPSILON and
+                 (n * std::cos(std::conj(theta))).real() >= 100 * EPSILON;
+  }
+  if (not consistent) {
+    Error("IsForwardAngle",
+          "It's not clear which beam is incoming vs outgoing. Weird"
+          " index maybe?\n"
+          "n: %.3e + %.3ei   angle: %.3e + %.3ei",
+          n.real(), n.imag(), theta.real(), theta.imag());
   }
   return answer;
 }
@@ -185,7 +272,7 @@ void AMultilayer::ListSnell(
   // using Snell's law. n_list is index of refraction of each layer. Note that
   // "angles" may be complex!!
 
-  auto num_layers = fRefractiveIndexList.size();
+  auto num_layers = n_list.size();
   th_list.resize(num_layers);
   {
     auto n_i = n_list.cbegin();
@@ -220,6 +307,7 @@ void AMultilayer::AddLayer(std::shared_ptr<ARefractiveIndex> idx,
   fRefractiveIndexList.insert(fRefractiveIndexList.begin() + 1, idx);
   fThicknessList.insert(fThicknessList.begin() + 1, thickness);
   fCoherentList.insert(fCoherentList.begin() + 1, coherent);
+  UpdateIncoherentLayers();
 }
 
 //______________________________________________________________________________
@@ -234,61 +322,63 @@ void AMultilayer::InsertLayer(std::shared_ptr<ARefractiveIndex> idx,
   fRefractiveIndexList.insert(fRefractiveIndexList.end() - 1, idx);
   fThicknessList.insert(fThicknessList.end() - 1, thickness);
   fCoherentList.insert(fCoherentList.end() - 1, coherent);
+  UpdateIncoherentLayers();
 }
 
 //______________________________________________________________________________
-void AMultilayer::CoherentTMM(AMultilayer::EPolarization polarization,
-                              std::complex<Double_t> th_0, Double_t lam_vac,
-                              Double_t& reflectance,
-                              Double_t& transmittance,
-                              Bool_t reverse) const {
-  // Copied from tmm.ch_tmm
-
-  // Main "coherent transfer matrix method" calc. Given parameters of a stack,
-  // calculates everything you could ever want to know about how light
-  // propagates in it. (If performance is an issue, you can delete some of the
-  // calculations without affecting the rest.)
-  //
-  // pol is light polarization, "s" or "p".
-  //
-  // n_list is the list of refractive indices, in the order that the light would
-  // pass through them. The 0'th element of the list should be the semi-infinite
-  // medium from which the light enters, the last element should be the semi-
-  // infinite medium to which the light exits (if any exits).
-  //
-  // th_0 is the angle of incidence: 0 for normal, pi/2 for glancing.
-  // Remember, for a dissipative incoming medium (n_list[0] is not real), th_0
-  // should be complex so that n0 sin(th0) is real (intensity is constant as
-  // a function of lateral position).
-  //
-  // d_list is the list of layer thicknesses (front to back). Should correspond
-  // one-to-one with elements of n_list. First and last elements should be
-  // "inf".
-  //
-  // lam_vac is vacuum wavelength of the light.
-
-  auto reversedRefractiveIndexList = fRefractiveIndexList;
-  std::reverse(reversedRefractiveIndexList.begin(),
-               reversedRefractiveIndexList.end());
-  auto _RefractiveIndexList = reverse ? reversedRefractiveIndexList : fRefractiveIndexList;
-
-  auto reversedThicknessList = fThicknessList;
-  std::reverse(reversedThicknessList.begin(),
-               reversedThicknessList.end());
-  auto _ThicknessList = reverse ? reversedThicknessList : fThicknessList;
+void AMultilayer::UpdateIncoherentLayers() {
+  // Cache the indices of the incoherent layers, which include the top and
+  // bottom media. The layers between two neighboring incoherent layers form a
+  // coherent stack (or just an interface if there is none), so IncoherentTMM
+  // does not need to group the layers on every call.
+  fIncoherentLayers.clear();
+  for (std::size_t i = 0; i < fCoherentList.size(); ++i) {
+    if (not fCoherentList[i]) {
+      fIncoherentLayers.push_back(i);
+    }
+  }
+}
 
-  auto num_layers = _RefractiveIndexList.size();
-  std::vector<std::complex<Double_t>> n_list(num_layers);
+//______________________________________________________________________________
+AMultilayer::ATMMWorkspace& AMultilayer::GetTMMWorkspace(
+    std::size_t num_layers) {
+  // Return the workspace of the current thread. resize() never shrinks the
+  // capacity, so no heap allocation happens once the workspace has grown to
+  // the number of layers.
+  static thread_local ATMMWorkspace ws;
+  ws.fN.resize(num_layers);
+  ws.fTh.resize(num_layers);
+  ws.fCosTh.resize(num_layers);
+  ws.fPhaseNeg.resize(num_layers);
+  ws.fPhasePos.resize(num_layers);
+  ws.fKz.resize(num_layers);
+
+  return ws;
+}
 
-  {
-    auto n_i = n_list.begin();
-    auto ref_i = _RefractiveIndexList.cbegin();
-    for (std::size_t i = 0; i < num_layers; ++i) {
-      *n_i = (*ref_i)->GetComplexRefractiveIndex(lam_vac);
-      ++n_i;
-      ++ref_i;
-    }
+//______________________________________________________________________________
+void AMultilayer::FillTMMIndices(ATMMWorkspace& ws, Double_t lam_vac,
+                                 Bool_t reverse) const {
+  // Fill the complex refractive indices of the layers at lam_vac. The reversed
+  // stack (reverse = kTRUE) is accessed through reversed indices instead of a
+  // reversed copy of the layer lists.
+  auto num_layers = fRefractiveIndexList.size();
+  for (std::size_t i = 0; i < num_layers; ++i) {
+    auto layer = reverse ? num_layers - 1 - i : i;
+    ws.fN[i] = fRefractiveIndexList[layer]->GetComplexRefractiveIndex(lam_vac);
   }
+}
+
+//______________________________________________________________________________
+void AMultilayer::FillTMMAngles(ATMMWorkspace& ws, std::complex<Double_t> th_0,
+                                Double_t lam_vac, Bool_t reverse,
+                                std::size_t first) const {
+  // Fill the propagation angles and the phase factors of the layers using the
+  // refractive indices filled by FillTMMIndices. The workspace may also hold a
+  // part of the stack starting from the first-th layer, which is used for the
+  // coherent stacks in IncoherentTMM.
+  auto num_layers = ws.fN.size();
+  auto& n_list = ws.fN;
 
   // Input tests
   if (std::abs((n_list[0] * std::sin(th_0)).imag()) >= 100 * EPSILON ||
@@ -299,184 +389,367 @@ void AMultilayer::CoherentTMM(AMultilayer::EPolarization polarization,
   // th_list is a list with, for each layer, the angle that the light travels
   // through the layer. Computed with Snell's law. Note that the "angles" may be
   // complex!
-  std::vector<std::complex<Double_t>> th_list;
-  ListSnell(th_0, n_list, th_list);
+  ListSnell(th_0, n_list, ws.fTh);
 
-  // kz is the z-component of (complex) angular wavevector for forward-moving
-  // wave. Positive imaginary part means decaying.
-  std::vector<std::complex<Double_t>> kz_list(num_layers);
-  std::vector<std::complex<Double_t>> cos_th_list(num_layers);
-  {
-    auto kz_i = kz_list.begin();
-    auto n_i = n_list.cbegin();
-    auto th_i = th_list.cbegin();
-    auto cos_th_i = cos_th_list.begin();
-    for (std::size_t i = 0; i < num_layers; ++i) {
-      *cos_th_i = std::cos(*th_i);
-      *kz_i = TMath::TwoPi() * (*n_i) * (*cos_th_i) / lam_vac;
-      ++kz_i;
-      ++n_i;
-      ++th_i;
-      ++cos_th_i;
-    }
-  }
-
-  // delta is the total phase accrued by traveling through a given layer.
-  std::vector<std::complex<Double_t>> delta(num_layers);
-  {
-    auto delta_i = delta.begin();
-    auto kz_i = kz_list.cbegin();
-    auto thickness_i = _ThicknessList.cbegin();
-    for (std::size_t i = 0; i < num_layers; ++i) {
-      *delta_i = (*kz_i) * (*thickness_i);
-      ++delta_i;
-      ++kz_i;
-      ++thickness_i;
-    }
+  for (std::size_t i = 0; i < num_layers; ++i) {
+    ws.fCosTh[i] = std::cos(ws.fTh[i]);
   }
 
-  // For a very opaque layer, reset delta to avoid divide-by-0 and similar
-  // errors. The criterion imag(delta) > 35 corresponds to single-pass
-  // transmission < 1e-30 --- small enough that the exact value doesn't
-  // matter.
   static Bool_t opacity_warning = kFALSE;
-  {
-    auto delta_i = delta.begin();
-    ++delta_i;  // start from i = 1
-    for (std::size_t i = 1; i < num_layers - 1; ++i) {
-      if ((*delta_i).imag() > 35) {
-        *delta_i = (*delta_i).real() + std::complex<Double_t>(0, 35);
-        if (opacity_warning == kFALSE) {
-          opacity_warning = kTRUE;
-          Error("CoherentTMM",
-                "Warning: Layers that are almost perfectly opaque "
-                "are modified to be slightly transmissive, "
-                "allowing 1 photon in 10^30 to pass through. It's "
-                "for numerical stability. This warning will not "
-                "be shown again.");
-        }
+  const std::complex<Double_t> j(0, 1);
+  for (std::size_t i = 1; i < num_layers - 1; ++i) {
+    // kz is the z-component of (complex) angular wavevector for
+    // forward-moving wave. Positive imaginary part means decaying.
+    auto layer = first + (reverse ? num_layers - 1 - i : i);
+    auto kz = TMath::TwoPi() * n_list[i] * ws.fCosTh[i] / lam_vac;
+
+    // delta is the total phase accrued by traveling through a given layer.
+    auto delta = kz * fThicknessList[layer];
+    ws.fKz[i] = kz;
+
+    // For a very opaque layer, reset delta to avoid divide-by-0 and similar
+    // errors. The criterion imag(delta) > 35 corresponds to single-pass
+    // transmission < 1e-30 --- small enough that the exact value doesn't
+    // matter.
+    if (delta.imag() > 35) {
+      delta = delta.real() + std::complex<Double_t>(0, 35);
+      ws.fKz[i] = kz.real();  // only the real part depends on the thickness
+      if (opacity_warning == kFALSE) {
+        opacity_warning = kTRUE;
+        Error("CoherentTMM",
+              "Warning: Layers that are almost perfectly opaque "
+              "are modified to be slightly transmissive, "
+              "allowing 1 photon in 10^30 to pass through. It's "
+              "for numerical stability. This warning will not "
+              "be shown again.");
       }
-      ++delta_i;
     }
-  }
-
-  // t_list[i,j] and r_list[i,j] are transmission and reflection amplitudes,
-  // respectively, coming from i, going to j. Only need to calculate this when
-  // j=i+1. (2D array is overkill but helps avoid confusion.)
-  std::vector<std::complex<Double_t>> t_list(num_layers);
-  std::vector<std::complex<Double_t>> r_list(num_layers);
 
-  {
-    auto t_i = t_list.begin();
-    auto r_i = r_list.begin();
-    auto th_i = th_list.cbegin();
-    auto th_f = th_list.cbegin();
-    ++th_f;  // increment to access th_f (th[i + 1])
-    auto n_i = n_list.cbegin();
-    auto n_f = n_list.cbegin();
-    ++n_f;                                 // increment to access n_f (n[i + 1])
-    auto cos_th_i = cos_th_list.cbegin();  // cos(th_i)
-    auto cos_th_f = cos_th_list.cbegin();
-    ++cos_th_f;  // increment to access cos(th_f)
-
-    for (std::size_t i = 0; i < num_layers - 1; ++i) {
-      std::complex<Double_t> r, t;
-      interface_rt(polarization, *n_i, *n_f, *th_i, *th_f, r, t);
-      *r_i = r;
-      *t_i = t;
-
-      ++t_i;
-      ++r_i;
-      ++th_i;
-      ++th_f;
-      ++n_i;
-      ++n_f;
-      ++cos_th_i;
-      ++cos_th_f;
-    }
+    ws.fPhaseNeg[i] = std::exp(-j * delta);
+    ws.fPhasePos[i] = std::exp(j * delta);
   }
+}
+
+//______________________________________________________________________________
+AMultilayer::ATMMWorkspace& AMultilayer::PrepareCoherentTMM(
+    std::complex<Double_t> th_0, Double_t lam_vac, Bool_t reverse) const {
+  // Calculate the polarization-independent part of CoherentTMM, i.e., the
+  // refractive indices, the propagation angles and the phase factors of all
+  // the layers, in the workspace of the current thread
+  auto& ws = GetTMMWorkspace(fRefractiveIndexList.size());
+  FillTMMIndices(ws, lam_vac, reverse);
+  FillTMMAngles(ws, th_0, lam_vac, reverse);
+
+  return ws;
+}
 
+//______________________________________________________________________________
+void AMultilayer::MultiplyTransferMatrices(
+    AMultilayer::EPolarization polarization, const ATMMWorkspace& ws,
+    std::complex<Double_t> th_0, Double_t& reflectance,
+    Double_t& transmittance, Double_t* reflectance_bwd,
+    Double_t* transmittance_bwd) {
+  // Calculate the polarization-dependent part of CoherentTMM using the values
+  // given by PrepareCoherentTMM. If reflectance_bwd and transmittance_bwd are
+  // given, the values for the light coming from the last layer are also
+  // calculated from the same matrices.
+  //
   // At the interface between the (n-1)st and nth material, let v_n be the
   // amplitude of the wave on the nth side heading forwards (away from the
   // boundary), and let w_n be the amplitude on the nth side heading backwards
-  // (towards the boundary). Then (v_n,w_n) = M_n (v_{n+1},w_{n+1}). M_n is
-  // M_list[n]. M_0 and M_{num_layers-1} are not defined.
-  // My M is a bit different than Sernelius's, but Mtilde is the same.
-
-  // M_list[0] and M_list[-1] are filled with (0, 0, 0, 0) by default
-  std::vector<A2x2ComplexMatrix> M_list(num_layers);
-  {
-    const std::complex<Double_t> j(0, 1);
-    auto M_i = M_list.begin();
-    ++M_i;  // start i from 1
-    auto t_i = t_list.cbegin();
-    ++t_i;
-    auto r_i = r_list.cbegin();
-    ++r_i;
-    auto delta_i = delta.cbegin();
-    ++delta_i;
-    for (std::size_t i = 1; i < num_layers - 1; ++i) {
-      auto j_delta_i = j * (*delta_i);
-      *M_i =
-          1. / (*t_i) *
-          A2x2ComplexMatrix(std::exp(-j_delta_i), 0, 0, std::exp(j_delta_i)) *
-          A2x2ComplexMatrix(1, *r_i, *r_i, 1);
-      ++M_i;
-      ++t_i;
-      ++r_i;
-      ++delta_i;
+  // (towards the boundary). Then (v_n,w_n) = M_n (v_{n+1},w_{n+1}), where
+  //
+  //   M_n = 1/t_n (exp(-j delta_n), 0; 0, exp(j delta_n)) (1, r_n; r_n, 1)
+  //
+  // and Mtilde = (1, r_0; r_0, 1) / t_0 M_1 M_2 ... M_{num_layers-2}.
+  // r_n and t_n are the reflection and transmission amplitudes from n to
+  // n+1. Each M_n is multiplied as soon as it is computed instead of being
+  // stored in a list.
+  auto num_layers = ws.fN.size();
+  const auto& n_list = ws.fN;
+  const auto& cos_th_list = ws.fCosTh;
+  Bool_t backward = reflectance_bwd and transmittance_bwd;
+
+  std::complex<Double_t> m00, m01, m10, m11;
+  std::complex<Double_t> det = 1.;  // det(Mtilde), used only if backward
+  for (std::size_t i = 0; i < num_layers - 1; ++i) {
+    std::complex<Double_t> r, t;
+    interface_rt_cos(polarization, n_list[i], n_list[i + 1], cos_th_list[i],
+                     cos_th_list[i + 1], r, t);
+
+    if (backward) {
+      // det(M_i) = (1 - r^2) / t^2 because the phase matrix has det = 1
+      det *= (1. - r * r) / (t * t);
     }
-  }
 
-  A2x2ComplexMatrix Mtilde(1, 0, 0, 1);
-  {
-    auto M_i = M_list.cbegin();
-    ++M_i;  // start i from 1
-    for (std::size_t i = 1; i < num_layers - 1; ++i) {
-      Mtilde = Mtilde * (*M_i);
-      ++M_i;
+    if (i == 0) {
+      m00 = 1. / t;
+      m01 = r / t;
+      m10 = m01;
+      m11 = m00;
+      continue;
     }
-  }
 
-  Mtilde = A2x2ComplexMatrix(1, r_list[0], r_list[0], 1) / t_list[0] * Mtilde;
+    // M_i = (a, a r; b r, b) with a = exp(-j delta) / t, b = exp(j delta) / t
+    auto a = ws.fPhaseNeg[i] / t;
+    auto b = ws.fPhasePos[i] / t;
+    auto ar = a * r;
+    auto br = b * r;
+    auto tmp00 = m00 * a + m01 * br;
+    auto tmp01 = m00 * ar + m01 * b;
+    auto tmp10 = m10 * a + m11 * br;
+    auto tmp11 = m10 * ar + m11 * b;
+    m00 = tmp00;
+    m01 = tmp01;
+    m10 = tmp10;
+    m11 = tmp11;
+  }
 
   // Net complex transmission and reflection amplitudes
-  auto r = Mtilde.Get10() / Mtilde.Get00();
-  auto t = 1. / Mtilde.Get00();
-
-  // vw_list[n] = [v_n, w_n]. v_0 and w_0 are undefined because the 0th medium
-  // has no left interface.
-  /* Will not be used at the moment (A.O.)
-  std::vector<std::array<std::complex<Double_t>, 2>> vw_list(num_layers);
-
-  std::complex<Double_t> vw[2] = {t, 0.};
-  vw_list.back()[0] = vw[0];
-  vw_list.back()[1] = vw[1];
-
-  for(std::size_t i = num_layers - 2; i > 0; --i) {
-    auto v = M_list[i].Get00() * vw[0] + M_list[i].Get01() * vw[1];
-    auto w = M_list[i].Get10() * vw[0] + M_list[i].Get11() * vw[1];
-    vw[0] = v;
-    vw[1] = w;
-    vw_list[i][0] = vw[0];
-    vw_list[i][1] = vw[1];
-  }
-  */
+  auto r = m10 / m00;
+  auto t = 1. / m00;
 
   // Net transmitted and reflected power, as a proportion of the incoming light
   // power.
   reflectance = std::abs(r) * std::abs(r);
   auto n_i = n_list[0];
-  auto n_f = n_list.back();
-  auto th_i = th_0;
-  auto th_f = th_list.back();
+  auto n_f = n_list[num_layers - 1];
+  auto cos_th_i = std::cos(th_0);
+  auto cos_th_f = cos_th_list[num_layers - 1];
   if (polarization == kS) {
-    transmittance = std::abs(t * t) * (((n_f * std::cos(th_f)).real()) /
-                                       (n_i * std::cos(th_i)).real());
+    transmittance = std::abs(t * t) *
+                    ((n_f * cos_th_f).real() / (n_i * cos_th_i).real());
   } else {
-    transmittance =
-        std::abs(t * t) * (((n_f * std::conj(std::cos(th_f))).real()) /
-                           (n_i * std::conj(std::cos(th_i))).real());
+    transmittance = std::abs(t * t) * ((n_f * std::conj(cos_th_f)).real() /
+                                       (n_i * std::conj(cos_th_i)).real());
+  }
+
+  if (not backward) {
+    return;
+  }
+
+  // For the light coming from the last layer, (0, w_0) = Mtilde (v_N, w_N)
+  // gives r' = v_N / w_N = -m01 / m00 and t' = w_0 / w_N = det(Mtilde) / m00,
+  // which is the same as the result of the reversed stack because r and t of
+  // each interface satisfy the Stokes relations r' = -r and t t' = 1 - r^2.
+  auto r_bwd = -m01 / m00;
+  auto t_bwd = det / m00;
+  *reflectance_bwd = std::abs(r_bwd) * std::abs(r_bwd);
+  auto cos_th_0 = cos_th_list[0];
+  if (polarization == kS) {
+    *transmittance_bwd = std::abs(t_bwd * t_bwd) *
+                         ((n_i * cos_th_0).real() / (n_f * cos_th_f).real());
+  } else {
+    *transmittance_bwd =
+        std::abs(t_bwd * t_bwd) * ((n_i * std::conj(cos_th_0)).real() /
+                                   (n_f * std::conj(cos_th_f)).real());
+  }
+}
+
+//______________________________________________________________________________
+void AMultilayer::DifferentiateTransferMatrices(
+    AMultilayer::EPolarization polarization, ATMMWorkspace& ws,
+    std::complex<Double_t> th_0, Double_t& reflectance,
+    Double_t& transmittance, Double_t* reflectance_bwd,
+    Double_t* transmittance_bwd) {
+  // Same as MultiplyTransferMatrices, but the derivatives of the reflectance
+  // and transmittance with respect to the layer thicknesses are also
+  // calculated. They are stored in ws.fGrad as (dR, dT, dR_bwd, dT_bwd) for
+  // each layer in the workspace.
+  //
+  // Mtilde = A_0 M_1 ... M_{num_layers-2} depends on d_i only through
+  // exp(-+j delta_i) in M_i. Therefore dMtilde/dd_i = P_{i-1} K_i S_i, where
+  // P_{i-1} = A_0 M_1 ... M_{i-1}, S_i = M_i ... M_{num_layers-2} and
+  // K_i = (-j kz_i, 0; 0, j kz_i). The prefixes P are stored in the forward
+  // loop and the suffixes S are accumulated in the backward loop, so all the
+  // derivatives cost about two more passes instead of one per layer.
+  auto num_layers = ws.fN.size();
+  const auto& n_list = ws.fN;
+  const auto& cos_th_list = ws.fCosTh;
+  Bool_t backward = reflectance_bwd and transmittance_bwd;
+  ws.fPrefix.resize(4 * num_layers);
+  ws.fM.resize(4 * num_layers);
+  ws.fGrad.assign(4 * num_layers, 0.);
+
+  std::complex<Double_t> m00, m01, m10, m11;
+  std::complex<Double_t> det = 1.;  // det(Mtilde), used only if backward
+  for (std::size_t i = 0; i < num_layers - 1; ++i) {
+    std::complex<Double_t> r, t;
+    interface_rt_cos(polarization, n_list[i], n_list[i + 1], cos_th_list[i],
+                     cos_th_list[i + 1], r, t);
+
+    if (backward) {
+      det *= (1. - r * r) / (t * t);
+    }
+
+    if (i == 0) {
+      m00 = 1. / t;
+      m01 = r / t;
+      m10 = m01;
+      m11 = m00;
+      continue;
+    }
+
+    auto* prefix = &ws.fPrefix[4 * i];
+    prefix[0] = m00;
+    prefix[1] = m01;
+    prefix[2] = m10;
+    prefix[3] = m11;
+
+    auto a = ws.fPhaseNeg[i] / t;
+    auto b = ws.fPhasePos[i] / t;
+    auto* m = &ws.fM[4 * i];
+    m[0] = a;
+    m[1] = a * r;
+    m[2] = b * r;
+    m[3] = b;
+
+    auto tmp00 = m00 * m[0] + m01 * m[2];
+    auto tmp01 = m00 * m[1] + m01 * m[3];
+    auto tmp10 = m10 * m[0] + m11 * m[2];
+    auto tmp11 = m10 * m[1] + m11 * m[3];
+    m00 = tmp00;
+    m01 = tmp01;
+    m10 = tmp10;
+    m11 = tmp11;
+  }
+
+  auto r = m10 / m00;
+  auto t = 1. / m00;
+  auto r_bwd = -m01 / m00;
+  auto t_bwd = det / m00;
+
+  // T = |t|^2 x (ratio of the Poynting vectors), which does not depend on the
+  // thicknesses
+  auto n_i = n_list[0];
+  auto n_f = n_list[num_layers - 1];
+  auto cos_th_i = std::cos(th_0);
+  auto cos_th_0 = cos_th_list[0];
+  auto cos_th_f = cos_th_list[num_layers - 1];
+  Double_t ratio, ratio_bwd;
+  if (polarization == kS) {
+    ratio = (n_f * cos_th_f).real() / (n_i * cos_th_i).real();
+    ratio_bwd = (n_i * cos_th_0).real() / (n_f * cos_th_f).real();
+  } else {
+    ratio = (n_f * std::conj(cos_th_f)).real() /
+            (n_i * std::conj(cos_th_i)).real();
+    ratio_bwd = (n_i * std::conj(cos_th_0)).real() /
+                (n_f * std::conj(cos_th_f)).real();
+  }
+
+  reflectance = std::abs(r) * std::abs(r);
+  transmittance = std::abs(t * t) * ratio;
+  if (backward) {
+    *reflectance_bwd = std::abs(r_bwd) * std::abs(r_bwd);
+    *transmittance_bwd = std::abs(t_bwd * t_bwd) * ratio_bwd;
+  }
+
+  const std::complex<Double_t> j(0, 1);
+  std::complex<Double_t> s00 = 1., s01 = 0., s10 = 0., s11 = 1.;  // S_{i+1}
+  for (std::size_t i = num_layers - 2; i >= 1; --i) {
+    const auto* m = &ws.fM[4 * i];
+    auto tmp00 = m[0] * s00 + m[1] * s10;
+    auto tmp01 = m[0] * s01 + m[1] * s11;
+    auto tmp10 = m[2] * s00 + m[3] * s10;
+    auto tmp11 = m[2] * s01 + m[3] * s11;
+    s00 = tmp00;
+    s01 = tmp01;
+    s10 = tmp10;
+    s11 = tmp11;
+
+    // dMtilde/dd_i = P_{i-1} K_i S_i
+    const auto* p = &ws.fPrefix[4 * i];
+    auto jkz = j * ws.fKz[i];
+    auto dm00 = jkz * (p[1] * s10 - p[0] * s00);
+    auto dm01 = jkz * (p[1] * s11 - p[0] * s01);
+    auto dm10 = jkz * (p[3] * s10 - p[2] * s00);
+
+    // dR = 2 Re(r* dr) and dT = 2 Re(t* dt) x ratio
+    auto dr = (dm10 - r * dm00) / m00;
+    auto dt = -t * dm00 / m00;
+    auto* grad = &ws.fGrad[4 * i];
+    grad[0] = 2. * (std::conj(r) * dr).real();
+    grad[1] = 2. * (std::conj(t) * dt).real() * ratio;
+
+    if (backward) {
+      auto dr_bwd = -(dm01 + r_bwd * dm00) / m00;
+      auto dt_bwd = -t_bwd * dm00 / m00;
+      grad[2] = 2. * (std::conj(r_bwd) * dr_bwd).real();
+      grad[3] = 2. * (std::conj(t_bwd) * dt_bwd).real() * ratio_bwd;
+    }
+  }
+}
+
+//______________________________________________________________________________
+void AMultilayer::CoherentTMM(AMultilayer::EPolarization polarization,
+                              std::complex<Double_t> th_0, Double_t lam_vac,
+                              Double_t& reflectance,
+                              Double_t& transmittance,
+                              Bool_t reverse) const {
+  // Copied from tmm.ch_tmm
+
+  // Main "coherent transfer matrix method" calc. Given parameters of a stack,
+  // calculates everything you could ever want to know about how light
+  // propagates in it. (If performance is an issue, you can delete some of the
+  // calculations without affecting the rest.)
+  //
+  // pol is light polarization, "s" or "p".
+  //
+  // n_list is the list of refractive indices, in the order that the light would
+  // pass through them. The 0'th element of the list should be the semi-infinite
+  // medium from which the light enters, the last element should be the semi-
+  // infinite medium to which the light exits (if any exits).
+  //
+  // th_0 is the angle of incidence: 0 for normal, pi/2 for glancing.
+  // Remember, for a dissipative incoming medium (n_list[0] is not real), th_0
+  // should be complex so that n0 sin(th0) is real (intensity is constant as
+  // a function of lateral position).
+  //
+  // d_list is the list of layer thicknesses (front to back). Should correspond
+  // one-to-one with elements of n_list. First and last elements should be
+  // "inf".
+  //
+  // lam_vac is vacuum wavelength of the light.
+  const auto& ws = PrepareCoherentTMM(th_0, lam_vac, reverse);
+  MultiplyTransferMatrices(polarization, ws, th_0, reflectance, transmittance);
+}
+
+//______________________________________________________________________________
+void AMultilayer::CoherentTMMSP(std::complex<Double_t> th_0, Double_t lam_vac,
+                                Double_t& reflectance_s,
+                                Double_t& transmittance_s,
+                                Double_t& reflectance_p,
+                                Double_t& transmittance_p,
+                                Bool_t reverse) const {
+  // Same as calling CoherentTMM for kS and kP, but the indices, angles and
+  // phases of the layers, which do not depend on the polarization, are
+  // calculated only once
+  const auto& ws = PrepareCoherentTMM(th_0, lam_vac, reverse);
+  MultiplyTransferMatrices(kS, ws, th_0, reflectance_s, transmittance_s);
+  MultiplyTransferMatrices(kP, ws, th_0, reflectance_p, transmittance_p);
+}
+
+//______________________________________________________________________________
+void AMultilayer::CoherentTMMGradient(
+    AMultilayer::EPolarization polarization, std::complex<Double_t> th_0,
+    Double_t lam_vac, Double_t& reflectance, Double_t& transmittance,
+    std::vector<Double_t>& reflectance_grad,
+    std::vector<Double_t>& transmittance_grad) const {
+  // Same as CoherentTMM, but also returns the derivatives of the reflectance
+  // and transmittance with respect to the thickness of each layer, i.e.,
+  // reflectance_grad[i] = dR/dd_i. The elements of the top and bottom media
+  // are always 0. The cost is about three times of CoherentTMM regardless of
+  // the number of layers.
+  auto& ws = PrepareCoherentTMM(th_0, lam_vac, kFALSE);
+  DifferentiateTransferMatrices(polarization, ws, th_0, reflectance,
+                                transmittance);
+
+  auto num_layers = ws.fN.size();
+  reflectance_grad.resize(num_layers);
+  transmittance_grad.resize(num_layers);
+  for (std::size_t i = 0; i < num_layers; ++i) {
+    reflectance_grad[i] = ws.fGrad[4 * i];
+    transmittance_grad[i] = ws.fGrad[4 * i + 1];
   }
 }
 
@@ -556,6 +829,30 @@ void AMultilayer::IncoherentTMM(AMultilayer::EPolarization polarization,
                                 std::complex<Double_t> th_0, Double_t lam_vac,
                                 Double_t& reflectance,
                                 Double_t& transmittance) const {
+  IncoherentTMM(polarization, th_0, lam_vac, reflectance, transmittance,
+                nullptr, nullptr);
+}
+
+//______________________________________________________________________________
+void AMultilayer::IncoherentTMMGradient(
+    AMultilayer::EPolarization polarization, std::complex<Double_t> th_0,
+    Double_t lam_vac, Double_t& reflectance, Double_t& transmittance,
+    std::vector<Double_t>& reflectance_grad,
+    std::vector<Double_t>& transmittance_grad) const {
+  // Same as IncoherentTMM, but also returns the derivatives of the
+  // reflectance and transmittance with respect to the thickness of each
+  // layer (see CoherentTMMGradient)
+  IncoherentTMM(polarization, th_0, lam_vac, reflectance, transmittance,
+                &reflectance_grad, &transmittance_grad);
+}
+
+//______________________________________________________________________________
+void AMultilayer::IncoherentTMM(AMultilayer::EPolarization polarization,
+                                std::complex<Double_t> th_0, Double_t lam_vac,
+                                Double_t& reflectance, Double_t& transmittance,
+                                std::vector<Double_t>* reflectance_grad,
+                                std::vector<Double_t>* transmittance_grad)
+    const {
   // Copied from tmm.inc_tmm
 
   // Incoherent, or partly-incoherent-partly-coherent, transfer matrix method.
@@ -567,17 +864,26 @@ void AMultilayer::IncoherentTMM(AMultilayer::EPolarization polarization,
   // See https://arxiv.org/abs/1603.02720 for physics background and some
   // of the definitions.
 
+  // The coherent stacks are evaluated as parts of this stack (between two
+  // incoherent layers) in the per-thread workspace. The values for both
+  // directions are given by a single pass of MultiplyTransferMatrices, and the
+  // transfer matrices L of the incoherent layers are multiplied one by one as
+  // 2x2 real matrices. No memory is allocated once the workspace has grown.
+  //
+  // If reflectance_grad and transmittance_grad are given, the derivatives
+  // with respect to the layer thicknesses are also calculated. Each L_k
+  // depends only on the thicknesses of the incoherent layer in front of it
+  // and of the coherent layers behind it, so its derivatives are multiplied
+  // by the product of L before and after it in the same way as in
+  // DifferentiateTransferMatrices.
+  Bool_t gradient = reflectance_grad and transmittance_grad;
   auto num_layers = fRefractiveIndexList.size();
-  std::vector<std::complex<Double_t>> n_list(num_layers);
-
-  {
-    auto n_i = n_list.begin();
-    auto ref_i = fRefractiveIndexList.cbegin();
-    for (std::size_t i = 0; i < num_layers; ++i) {
-      *n_i = (*ref_i)->GetComplexRefractiveIndex(lam_vac);
-      ++n_i;
-      ++ref_i;
-    }
+  auto& ws = GetTMMWorkspace(num_layers);
+  auto& n_list = ws.fIncN;
+  auto& th_list = ws.fIncTh;
+  n_list.resize(num_layers);
+  for (std::size_t i = 0; i < num_layers; ++i) {
+    n_list[i] = fRefractiveIndexList[i]->GetComplexRefractiveIndex(lam_vac);
   }
 
   // Input test
@@ -585,149 +891,164 @@ void AMultilayer::IncoherentTMM(AMultilayer::EPolarization polarization,
     Error("IncoherentTMM", "Error in n0 or th0!");
   }
 
-  std::vector<std::vector<Double_t>> stack_d_list;
-  std::vector<std::vector<std::shared_ptr<ARefractiveIndex>>> stack_n_list;
-  std::vector<std::size_t> all_from_inc;
-  std::vector<std::size_t> inc_from_all;
-  std::vector<std::vector<std::size_t>> all_from_stack;
-  std::vector<std::vector<std::size_t>> stack_from_all;
-  std::vector<std::size_t> inc_from_stack;
-  std::vector<std::size_t> stack_from_inc;
-
-  IncGroupLayers(stack_d_list, stack_n_list, all_from_inc,
-                 inc_from_all, all_from_stack, stack_from_all, inc_from_stack,
-                 stack_from_inc);
-
   // th_list is a list with, for each layer, the angle that the light travels
   // through the layer. Computed with Snell's law. Note that the "angles" may be
   // complex!
-  std::vector<std::complex<Double_t>> th_list;
   ListSnell(th_0, n_list, th_list);
 
-  // coh_tmm_data_list[i] is the output of coh_tmm for the i'th stack
-  std::vector<std::pair<Double_t, Double_t>> coh_tmm_data_list;
-  // coh_tmm_bdata_list[i] is the same stack as coh_tmm_data_list[i] but
-  // with order of layers reversed
-  std::vector<std::pair<Double_t, Double_t>> coh_tmm_bdata_list;
+  // L_i is the transfer matrix from the i'th to (i+1)st incoherent layer, see
+  // manual. L_0 is not defined because 0'th layer has no beginning, and
+  // Ltilde = (1, -R_10; R_01, T_10 T_01 - R_10 R_01) / T_01 L_1 L_2 ...
+  const auto& inc_list = fIncoherentLayers;
+  auto num_inc_layers = inc_list.size();
+  Double_t l00 = 1, l01 = 0, l10 = 0, l11 = 1;  // Ltilde
+
+  if (gradient) {
+    ws.fIncL.resize(8 * (num_inc_layers - 1));
+    ws.fIncRT.resize(6 * (num_inc_layers - 1));
+    ws.fIncGrad.assign(4 * num_layers, 0.);
+  }
 
-  for (std::size_t i = 0; i < all_from_stack.size(); ++i) {
-    Double_t R, T;
-    AMultilayer multi(stack_n_list[i][0], stack_n_list[i].back());
+  for (std::size_t inc_index = 0; inc_index < num_inc_layers - 1;
+       ++inc_index) {
+    // looking at interface i -> i+1
+    auto first = inc_list[inc_index];
+    auto last = inc_list[inc_index + 1];
+
+    // Transmission and reflection powers going to the next incoherent layer
+    // (R_fwd, T_fwd) and coming back from it (R_bwd, T_bwd)
+    Double_t R_fwd, T_fwd, R_bwd, T_bwd;
+    if (last == first + 1) {  // next layer is incoherent
+      interface_RT(polarization, n_list[first], n_list[last], th_list[first],
+                   th_list[last], R_fwd, T_fwd);
+      interface_RT(polarization, n_list[last], n_list[first], th_list[last],
+                   th_list[first], R_bwd, T_bwd);
+    } else {  // coherent stack in between
+      auto num_stack_layers = last - first + 1;
+      GetTMMWorkspace(num_stack_layers);  // same ws with resized vectors
+      for (std::size_t i = 0; i < num_stack_layers; ++i) {
+        ws.fN[i] = n_list[first + i];
+      }
+      FillTMMAngles(ws, th_list[first], lam_vac, kFALSE, first);
+      if (gradient) {
+        DifferentiateTransferMatrices(polarization, ws, th_list[first], R_fwd,
+                                      T_fwd, &R_bwd, &T_bwd);
+        std::copy(ws.fGrad.begin(), ws.fGrad.begin() + 4 * num_stack_layers,
+                  ws.fIncGrad.begin() + 4 * first);
+      } else {
+        MultiplyTransferMatrices(polarization, ws, th_list[first], R_fwd,
+                                 T_fwd, &R_bwd, &T_bwd);
+      }
+    }
 
-    for (std::size_t j = 1; j < stack_n_list[i].size() - 1; ++j) {
-      multi.InsertLayer(stack_n_list[i][j], stack_d_list[i][j]);
+    // P is fraction not absorbed in a single pass through the incoherent layer
+    // in front of the interface. The 0'th layer is skipped (infinite).
+    Double_t P = 1;
+    Double_t dP_P = 0;  // dP/dd / P
+    if (inc_index > 0) {
+      dP_P = -4 * TMath::Pi() *
+             (n_list[first] * std::cos(th_list[first])).imag() / lam_vac;
+      P = TMath::Exp(fThicknessList[first] * dP_P);
+      // For a very opaque layer, reset P to avoid divide-by-0 and similar
+      // errors.
+      if (P < 1e-30) {
+        P = 1e-30;
+        dP_P = 0;
+      }
     }
 
-    multi.CoherentTMM(polarization, th_list[all_from_stack[i][0]], lam_vac, R, T);
-    coh_tmm_data_list.push_back(std::pair<Double_t, Double_t>{R, T});
+    // L = (1/P, 0; 0, P) (1, -R_bwd; R_fwd, T_bwd T_fwd - R_bwd R_fwd) / T_fwd
+    auto inv_T = 1 / T_fwd;
+    auto L00 = 1 / P * inv_T;
+    auto L01 = 1 / P * -R_bwd * inv_T;
+    auto L10 = P * R_fwd * inv_T;
+    auto L11 = P * (T_bwd * T_fwd - R_bwd * R_fwd) * inv_T;
+
+    if (gradient) {
+      Double_t* L = &ws.fIncL[8 * inc_index];
+      L[0] = l00;
+      L[1] = l01;
+      L[2] = l10;
+      L[3] = l11;
+      L[4] = L00;
+      L[5] = L01;
+      L[6] = L10;
+      L[7] = L11;
+      Double_t* rt = &ws.fIncRT[6 * inc_index];
+      rt[0] = R_fwd;
+      rt[1] = T_fwd;
+      rt[2] = R_bwd;
+      rt[3] = T_bwd;
+      rt[4] = P;
+      rt[5] = dP_P;
+    }
 
-    Bool_t reverse = kTRUE;
-    multi.CoherentTMM(polarization, th_list[all_from_stack[i].back()], lam_vac, R, T, reverse);
-    coh_tmm_bdata_list.push_back(std::pair<Double_t, Double_t>{R, T});
+    auto tmp00 = l00 * L00 + l01 * L10;
+    auto tmp01 = l00 * L01 + l01 * L11;
+    auto tmp10 = l10 * L00 + l11 * L10;
+    auto tmp11 = l10 * L01 + l11 * L11;
+    l00 = tmp00;
+    l01 = tmp01;
+    l10 = tmp10;
+    l11 = tmp11;
   }
 
-  // P_list[i] is fraction not absorbed in a single pass through i'th incoherent
-  // layer.
-  auto num_inc_layers = all_from_inc.size();
-  std::vector<Double_t> P_list(num_inc_layers);
-  P_list[0] = 0;
+  transmittance = 1 / l00;
+  reflectance = l10 / l00;
 
-  for (std::size_t inc_index = 1; inc_index < num_inc_layers - 1; ++inc_index) { // skip 0'th and last (infinite)
-    auto i = all_from_inc[inc_index];
-    auto n = fRefractiveIndexList[i]->GetComplexRefractiveIndex(lam_vac);
-    auto d = fThicknessList[i];
-    auto th = th_list[i];
-
-    P_list[inc_index] = TMath::Exp(-4 * TMath::Pi() * d
-                                   * (n * std::cos(th)).imag() / lam_vac);
-    // For a very opaque layer, reset P to avoid divide-by-0 and similar
-    // errors.
-    if (P_list[inc_index] < 1e-30) {
-      P_list[inc_index] = 1e-30;
-    }
+  if (not gradient) {
+    return;
   }
 
-  // T_list[i,j] and R_list[i,j] are transmission and reflection powers,
-  // respectively, coming from the i'th incoherent layer, going to the j'th
-  // incoherent layer. Only need to calculate this when j=i+1 or j=i-1.
-  // (2D array is overkill but helps avoid confusion.)
-  // initialize these arrays
-  Double_t T_list[num_inc_layers][num_inc_layers];
-  Double_t R_list[num_inc_layers][num_inc_layers];
-  std::memset(T_list, 0, sizeof(T_list));
-  std::memset(R_list, 0, sizeof(R_list));
-
-  for (std::size_t inc_index = 0; inc_index < num_inc_layers - 1; ++inc_index){
-    // looking at interface i -> i+1
-    auto alllayer_index = all_from_inc[inc_index];
-    auto nextstack_index = stack_from_inc[inc_index + 1];
-    if (nextstack_index == std::size_t(std::nan(""))) { // next layer is incoherent
-      Double_t R, T;
-      interface_RT(polarization,
-                   n_list[alllayer_index],
-                   n_list[alllayer_index + 1],
-                   th_list[alllayer_index],
-                   th_list[alllayer_index + 1],
-                   R, T);
-
-      R_list[inc_index][inc_index + 1] = R;
-      T_list[inc_index][inc_index + 1] = T;
-
-      interface_RT(polarization,
-                   n_list[alllayer_index + 1],
-                   n_list[alllayer_index],
-                   th_list[alllayer_index + 1],
-                   th_list[alllayer_index],
-                   R, T);
-
-      R_list[inc_index + 1][inc_index] = R;
-      T_list[inc_index+1][inc_index] = T;
-    } else { // next layer is coherent
-      R_list[inc_index][inc_index + 1]
-        = coh_tmm_data_list[nextstack_index].first;
-      T_list[inc_index][inc_index + 1]
-        = coh_tmm_data_list[nextstack_index].second;
-      R_list[inc_index + 1][inc_index]
-        = coh_tmm_bdata_list[nextstack_index].first;
-      T_list[inc_index + 1][inc_index]
-        = coh_tmm_bdata_list[nextstack_index].second;
+  reflectance_grad->assign(num_layers, 0.);
+  transmittance_grad->assign(num_layers, 0.);
+
+  Double_t s0 = 1, s1 = 0;  // first column of L_{k+1} L_{k+2} ...
+  for (std::size_t inc_index = num_inc_layers - 1; inc_index-- > 0;) {
+    const Double_t* pre = &ws.fIncL[8 * inc_index];  // L_0 ... L_{k-1}
+    const Double_t* L = pre + 4;
+    const Double_t* rt = &ws.fIncRT[6 * inc_index];
+    auto first = inc_list[inc_index];
+    auto last = inc_list[inc_index + 1];
+
+    // Add the contribution of dL_k/dd of a layer. T = 1/l00 and
+    // R = l10/l00 give dT = -dl00 T^2 and dR = (dl10 - R dl00) T.
+    auto add = [&](std::size_t layer, Double_t d00, Double_t d01,
+                   Double_t d10, Double_t d11) {
+      auto v0 = d00 * s0 + d01 * s1;
+      auto v1 = d10 * s0 + d11 * s1;
+      auto dl00 = pre[0] * v0 + pre[1] * v1;
+      auto dl10 = pre[2] * v0 + pre[3] * v1;
+      (*transmittance_grad)[layer] = -dl00 * transmittance * transmittance;
+      (*reflectance_grad)[layer] = (dl10 - reflectance * dl00) * transmittance;
+    };
+
+    // The incoherent layer changes only P in (1/P, 0; 0, P)
+    auto dP_P = rt[5];
+    if (inc_index > 0) {
+      add(first, -dP_P * L[0], -dP_P * L[1], dP_P * L[2], dP_P * L[3]);
     }
-  }
-
-  // L is the transfer matrix from the i'th to (i+1)st incoherent layer, see
-  // manual
-  std::vector<TMatrixT<Double_t>> L_list{TMatrixDSym(2)};
-  // L_0 is not defined because 0'th layer has no beginning.
-  L_list[0][0][0] = std::nan("");
 
-  TMatrixT<Double_t> Ltilde(2, 2);
-  Ltilde[0][0] = 1;
-  Ltilde[0][1] = -R_list[1][0];
-  Ltilde[1][0] = R_list[0][1];
-  Ltilde[1][1] = T_list[1][0] * T_list[0][1] - R_list[1][0] * R_list[0][1];
-  Ltilde *= 1 / T_list[0][1];
-
-  for (std::size_t i = 1; i < num_inc_layers - 1; ++i) {
-    TMatrixT<Double_t> L1(2, 2), L2(2, 2);
-
-    L1[0][0] = 1/P_list[i];
-    L1[0][1] = 0;
-    L1[1][0] = 0;
-    L1[1][1] = P_list[i];
-    L2[0][0] = 1;
-    L2[0][1] = -R_list[i + 1][i];
-    L2[1][0] = R_list[i][i + 1];
-    L2[1][1] = T_list[i + 1][i] * T_list[i][i + 1]
-      - R_list[i + 1][i] * R_list[i][i + 1];
+    // The coherent layers change R_fwd, T_fwd, R_bwd and T_bwd in
+    // L = (1/(P T_fwd), -R_bwd/(P T_fwd); P R_fwd/T_fwd,
+    //      P (T_bwd - R_bwd R_fwd/T_fwd))
+    auto R_fwd = rt[0], T_fwd = rt[1], R_bwd = rt[2], P = rt[4];
+    for (auto layer = first + 1; layer < last; ++layer) {
+      const Double_t* g = &ws.fIncGrad[4 * layer];
+      auto dR_fwd = g[0], dT_fwd = g[1], dR_bwd = g[2], dT_bwd = g[3];
+      add(layer, -dT_fwd * L[0] / T_fwd,
+          -dT_fwd * L[1] / T_fwd - dR_bwd * L[0],
+          dR_fwd * P / T_fwd - dT_fwd * L[2] / T_fwd,
+          -dR_fwd * P * R_bwd / T_fwd +
+              dT_fwd * P * R_bwd * R_fwd / (T_fwd * T_fwd) - dR_bwd * L[2] +
+              dT_bwd * P);
+    }
 
-    auto L = L1 * L2 * (1 / T_list[i][i + 1]);
-    L_list.push_back(L);
-    auto tmp = Ltilde * L;
-    Ltilde = tmp;
+    auto tmp0 = L[0] * s0 + L[1] * s1;
+    auto tmp1 = L[2] * s0 + L[3] * s1;
+    s0 = tmp0;
+    s1 = tmp1;
   }
-
-  transmittance = 1 / Ltilde[0][0];
-  reflectance = Ltilde[1][0] / Ltilde[0][0];
 }
 
 //______________________________________________________________________________
@@ -791,8 +1112,10 @@ TGraph* AMultilayer::MakeIndexGraph(Double_t lambda, std::size_t stack_index) co
 
 //______________________________________________________________________________
 void AMultilayer::SetNthreads(std::size_t n) {
-  // Note that having n larger than 1 frequently decreases the total
-  // performance. Use this method only when you feed a very long vector.
+  // Set the number of threads used by the grid calculations (e.g.
+  // CoherentTMMMixedGrid). The threads are kept in a persistent pool, which is
+  // shared by the copies of this object. Note that having n larger than 1 does
+  // not improve the total performance for a short grid.
   if (n == 0) {
     fNthreads =
         std::thread::hardware_concurrency();  // can return 0 if n is unknown
@@ -800,4 +1123,188 @@ void AMultilayer::SetNthreads(std::size_t n) {
   } else if (n > 0) {
     fNthreads = n;
   }
+
+  if (fNthreads == 1) {
+    fThreadPool.reset();
+  } else if (not fThreadPool or fThreadPool->GetNthreads() != fNthreads) {
+    fThreadPool = std::make_shared<AThreadPool>(fNthreads);
+  }
+}
+
+//______________________________________________________________________________
+void AMultilayer::TMMMixedGrid(Bool_t coherent, std::size_t n_lambda,
+                               const Double_t* lam_vac, std::size_t n_angle,
+                               const std::complex<Double_t>* th_0,
+                               Double_t* reflectance,
+                               Double_t* transmittance) const {
+  // Calculate the mixed-polarization reflectance and transmittance on a grid
+  // of n_lambda wavelengths x n_angle incident angles. The results are stored
+  // in the caller-provided arrays of n_lambda x n_angle elements as
+  // reflectance[i_lambda * n_angle + i_angle].
+  //
+  // The grid points are processed by the persistent thread pool when
+  // SetNthreads has been called with n > 1. In the coherent calculation, the
+  // refractive indices of the layers are evaluated only once per wavelength
+  // in each chunk of grid points.
+  Bool_t precalculated = fPreCalculatedTable != nullptr;
+
+  auto task = [&](std::size_t, std::size_t begin, std::size_t end) {
+    if (not coherent or precalculated) {
+      for (std::size_t k = begin; k < end; ++k) {
+        auto i = k / n_angle;
+        auto j = k % n_angle;
+        if (coherent) {
+          CoherentTMMMixed(th_0[j], lam_vac[i], reflectance[k],
+                           transmittance[k]);
+        } else {
+          IncoherentTMMMixed(th_0[j], lam_vac[i], reflectance[k],
+                             transmittance[k]);
+        }
+      }
+      return;
+    }
+
+    auto& ws = GetTMMWorkspace(fRefractiveIndexList.size());
+    std::size_t current_lambda = n_lambda;  // not filled yet
+    for (std::size_t k = begin; k < end; ++k) {
+      auto i = k / n_angle;
+      auto j = k % n_angle;
+      if (i != current_lambda) {
+        FillTMMIndices(ws, lam_vac[i], kFALSE);
+        current_lambda = i;
+      }
+      FillTMMAngles(ws, th_0[j], lam_vac[i], kFALSE);
+
+      Double_t rs, ts, rp, tp;
+      MultiplyTransferMatrices(kS, ws, th_0[j], rs, ts);
+      MultiplyTransferMatrices(kP, ws, th_0[j], rp, tp);
+      reflectance[k] = (rp + rs) / 2.;
+      transmittance[k] = (tp + ts) / 2.;
+    }
+  };
+
+  std::size_t n = n_lambda * n_angle;
+  if (fThreadPool and n > 1) {
+    // Several chunks per thread for the work stealing to balance the load
+    std::size_t chunk = n / (fThreadPool->GetNthreads() * 8);
+    fThreadPool->ParallelFor(n, chunk > 0 ? chunk : 1, task);
+  } else {
+    task(0, 0, n);
+  }
+}
+
+//______________________________________________________________________________
+void AMultilayer::PreCalculateTMM(Bool_t coherent, Int_t lam_nbins,
+                                  Double_t lam_min, Double_t lam_max,
+                                  Int_t th_nbins, Double_t th_min,
+                                  Double_t th_max, Bool_t in_cosine) {
+  // Tabulate the mixed-polarization reflectance and transmittance at the bin
+  // centers of [lam_min, lam_max] x [th_min, th_max]. The following calls of
+  // CoherentTMMMixed and IncoherentTMMMixed interpolate the table instead of
+  // calculating the multilayer. The table is filled on the thread pool if
+  // SetNthreads has been called with n > 1. See AMultilayerTable for
+  // in_cosine.
+  if (lam_nbins < 1 or th_nbins < 1 or not(lam_min < lam_max) or
+      not(th_min < th_max)) {
+    Error("PreCalculateTMM", "Invalid grid (%d, %g, %g, %d, %g, %g)",
+          lam_nbins, lam_min, lam_max, th_nbins, th_min, th_max);
+    return;
+  }
+
+  // The old table must not be used to calculate the new one
+  ClearPreCalculation();
+
+  auto table = std::make_shared<AMultilayerTable>(
+      lam_nbins, lam_min, lam_max, th_nbins, th_min, th_max, in_cosine);
+
+  std::string cache;
+  if (not fCacheDirectory.empty()) {
+    cache = fCacheDirectory + "/AMultilayerTable_" +
+            GetCacheKey(coherent, *table) + ".root";
+    auto cached = ReadTableCache(cache.c_str());
+    if (cached and cached->GetNlambda() == lam_nbins and
+        cached->GetNangle() == th_nbins) {
+      SetPreCalculatedTable(cached);
+      return;
+    }
+  }
+
+  std::vector<Double_t> lam_vac(lam_nbins);
+  for (Int_t i = 0; i < lam_nbins; ++i) {
+    lam_vac[i] = table->GetLambda(i);
+  }
+  std::vector<std::complex<Double_t>> th_0(th_nbins);
+  for (Int_t j = 0; j < th_nbins; ++j) {
+    th_0[j] = table->GetAngle(j);
+  }
+
+  std::vector<Double_t> reflectance(lam_nbins * th_nbins);
+  std::vector<Double_t> transmittance(lam_nbins * th_nbins);
+  TMMMixedGrid(coherent, lam_nbins, lam_vac.data(), th_nbins, th_0.data(),
+               reflectance.data(), transmittance.data());
+
+  for (Int_t i = 0; i < lam_nbins; ++i) {
+    for (Int_t j = 0; j < th_nbins; ++j) {
+      auto k = i * th_nbins + j;
+      table->Set(i, j, reflectance[k], transmittance[k]);
+    }
+  }
+
+  if (not cache.empty()) {
+    WriteTableCache(cache.c_str(), fCacheDirectory.c_str(), *table);
+  }
+
+  SetPreCalculatedTable(table);
+}
+
+//______________________________________________________________________________
+void AMultilayer::SetPreCalculatedTable(
+    std::shared_ptr<const AMultilayerTable> table) {
+  fPreCalculatedTable = table;
+  fPreCalculatedReflectanceMixed.reset(table->MakeReflectanceHist());
+  fPreCalculatedTransmittanceMixed.reset(table->MakeTransmittanceHist());
+}
+
+//______________________________________________________________________________
+std::string AMultilayer::GetCacheKey(Bool_t coherent,
+                                     const AMultilayerTable& table) const {
+  // Return the MD5 digest of everything the precalculated table depends on,
+  // i.e., the calculation type, the grid, the thicknesses and coherence of the
+  // layers, and the complex refractive indices of the layers at the
+  // wavelength nodes. The indices are compared by their values instead of
+  // their types or parameters, so that any kind of ARefractiveIndex can be
+  // identified.
+  TMD5 md5;
+  auto update = [&md5](const void* data, std::size_t size) {
+    md5.Update(static_cast<const UChar_t*>(data), size);
+  };
+
+  // Change this tag when the TMM calculation or the table format is changed
+  const char tag[] = "AMultilayerTable v1";
+  update(tag, sizeof(tag));
+
+  Int_t grid_i[] = {coherent, table.IsInCosine(), table.GetNlambda(),
+                    table.GetNangle()};
+  Double_t grid_d[] = {table.GetLambdaMin(), table.GetLambdaMax(),
+                       table.GetAngleMin(), table.GetAngleMax()};
+  update(grid_i, sizeof(grid_i));
+  update(grid_d, sizeof(grid_d));
+
+  auto num_layers = fRefractiveIndexList.size();
+  update(&num_layers, sizeof(num_layers));
+  update(fThicknessList.data(), sizeof(Double_t) * num_layers);
+  update(fCoherentList.data(), sizeof(Double_t) * num_layers);
+
+  for (std::size_t i = 0; i < num_layers; ++i) {
+    for (Int_t j = 0; j < table.GetNlambda(); ++j) {
+      auto n = fRefractiveIndexList[i]->GetComplexRefractiveIndex(
+          table.GetLambda(j));
+      Double_t v[2] = {n.real(), n.imag()};
+      update(v, sizeof(v));
+    }
+  }
+
+  md5.Final();
+
+  return md5.AsString();
 }
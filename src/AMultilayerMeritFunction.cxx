@@ -0,0 +1,192 @@
+/******************************************************************************
+ * Copyright (C) 2006-, Akira Okumura                                         *
+ * All rights reserved.                                                       *
+ *****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// AMultilayerMeritFunction
+//
+// Merit function for optimizing the layer thicknesses of an AMultilayer with
+// Minuit2 or other minimizers that accept
+// ROOT::Math::IGradientFunctionMultiDim.
+// The parameters are the thicknesses of the given layers, and the merit is
+// the weighted sum of the squared deviations of the reflectance or
+// transmittance from the target values at the given wavelengths and angles.
+// A target can also be one-sided, e.g., T >= 0.96.
+//
+// The gradient is calculated analytically by CoherentTMMGradient or
+// IncoherentTMMGradient. One gradient costs about three TMM calculations per
+// target, while a finite-difference gradient costs 2N calculations for N
+// layers.
+//
+// Note that the thicknesses of the multilayer are changed by every
+// evaluation. The multilayer must not be used by other threads during the
+// minimization.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+
+#include "AMultilayerMeritFunction.h"
+
+//______________________________________________________________________________
+AMultilayerMeritFunction::AMultilayerMeritFunction(
+    AMultilayer& multi, const std::vector<std::size_t>& layers,
+    Bool_t coherent)
+    : fMultilayer(&multi),
+      fLayers(layers),
+      fCoherent(coherent),
+      fPolarization(kMixed) {}
+
+//______________________________________________________________________________
+AMultilayerMeritFunction::~AMultilayerMeritFunction() {}
+
+//______________________________________________________________________________
+void AMultilayerMeritFunction::AddTarget(Double_t lambda, Double_t angle,
+                                         EQuantity quantity, Double_t value,
+                                         ETargetType type, Double_t weight) {
+  // Add a target value of the reflectance or transmittance at (lambda,
+  // angle). If type is kAtLeast (kAtMost), the deviation is added to the merit
+  // only when the value is smaller (larger) than the target.
+  ATarget target;
+  target.fLambda = lambda;
+  target.fAngle = angle;
+  target.fQuantity = quantity;
+  target.fValue = value;
+  target.fType = type;
+  target.fWeight = weight;
+  fTargets.push_back(target);
+}
+
+//______________________________________________________________________________
+void AMultilayerMeritFunction::Calculate(const double* x, double& f,
+                                         double* df) const {
+  // Calculate the merit, and its gradient if df is not null
+  auto ndim = fLayers.size();
+  for (std::size_t i = 0; i < ndim; ++i) {
+    fMultilayer->ChangeThickness(fLayers[i], x[i]);
+  }
+
+  f = 0;
+  if (df) {
+    std::fill(df, df + ndim, 0.);
+  }
+
+  std::vector<Double_t> reflectance_grad, transmittance_grad;
+  auto* r_grad = df ? &reflectance_grad : nullptr;
+  auto* t_grad = df ? &transmittance_grad : nullptr;
+  Double_t reflectance = 0, transmittance = 0;
+
+  for (std::size_t i = 0; i < fTargets.size(); ++i) {
+    const auto& target = fTargets[i];
+
+    // Targets of R and T at the same point share one calculation
+    if (i == 0 or target.fLambda != fTargets[i - 1].fLambda or
+        target.fAngle != fTargets[i - 1].fAngle) {
+      CalculateTMM(fPolarization, target.fLambda, target.fAngle, reflectance,
+                   transmittance, r_grad, t_grad);
+    }
+
+    Bool_t is_r = target.fQuantity == kReflectance;
+    auto diff = (is_r ? reflectance : transmittance) - target.fValue;
+    if ((target.fType == kAtLeast and diff >= 0) or
+        (target.fType == kAtMost and diff <= 0)) {
+      continue;
+    }
+
+    f += target.fWeight * diff * diff;
+    if (df) {
+      const auto& grad = is_r ? reflectance_grad : transmittance_grad;
+      for (std::size_t j = 0; j < ndim; ++j) {
+        df[j] += 2. * target.fWeight * diff * grad[fLayers[j]];
+      }
+    }
+  }
+}
+
+//______________________________________________________________________________
+void AMultilayerMeritFunction::CalculateTMM(
+    EPolarization polarization, Double_t lambda, Double_t angle,
+    Double_t& reflectance, Double_t& transmittance,
+    std::vector<Double_t>* reflectance_grad,
+    std::vector<Double_t>* transmittance_grad) const {
+  if (polarization == kMixed) {
+    // Average of S and P
+    Double_t rs, ts, rp, tp;
+    std::vector<Double_t> rs_grad, ts_grad;
+    CalculateTMM(kS, lambda, angle, rs, ts,
+                 reflectance_grad ? &rs_grad : nullptr,
+                 transmittance_grad ? &ts_grad : nullptr);
+    CalculateTMM(kP, lambda, angle, rp, tp, reflectance_grad,
+                 transmittance_grad);
+    reflectance = (rs + rp) / 2.;
+    transmittance = (ts + tp) / 2.;
+    if (reflectance_grad and transmittance_grad) {
+      for (std::size_t i = 0; i < rs_grad.size(); ++i) {
+        (*reflectance_grad)[i] = ((*reflectance_grad)[i] + rs_grad[i]) / 2.;
+        (*transmittance_grad)[i] =
+            ((*transmittance_grad)[i] + ts_grad[i]) / 2.;
+      }
+    }
+    return;
+  }
+
+  auto pol = AMultilayer::EPolarization(polarization);
+  if (reflectance_grad and transmittance_grad) {
+    if (fCoherent) {
+      fMultilayer->CoherentTMMGradient(pol, angle, lambda, reflectance,
+                                       transmittance, *reflectance_grad,
+                                       *transmittance_grad);
+    } else {
+      fMultilayer->IncoherentTMMGradient(pol, angle, lambda, reflectance,
+                                         transmittance, *reflectance_grad,
+                                         *transmittance_grad);
+    }
+  } else if (fCoherent) {
+    fMultilayer->CoherentTMM(pol, angle, lambda, reflectance, transmittance);
+  } else {
+    fMultilayer->IncoherentTMM(pol, angle, lambda, reflectance, transmittance);
+  }
+}
+
+//______________________________________________________________________________
+ROOT::Math::IBaseFunctionMultiDim* AMultilayerMeritFunction::Clone() const {
+  // The clone refers to the same multilayer
+  return new AMultilayerMeritFunction(*this);
+}
+
+//______________________________________________________________________________
+double AMultilayerMeritFunction::DoDerivative(const double* x,
+                                              unsigned int icoord) const {
+  // Minimizers usually call Gradient, but the whole gradient is calculated
+  // and cached here too in case the derivatives are requested one by one
+  auto ndim = fLayers.size();
+  if (fLastX.size() != ndim or not std::equal(x, x + ndim, fLastX.begin())) {
+    std::vector<Double_t> grad(ndim);
+    Gradient(x, grad.data());
+  }
+  return fLastGradient[icoord];
+}
+
+//______________________________________________________________________________
+double AMultilayerMeritFunction::DoEval(const double* x) const {
+  // The value alone is calculated without the gradient, which is cheaper
+  double f;
+  Calculate(x, f, nullptr);
+  return f;
+}
+
+//______________________________________________________________________________
+void AMultilayerMeritFunction::FdF(const double* x, double& f,
+                                   double* df) const {
+  Calculate(x, f, df);
+  fLastX.assign(x, x + fLayers.size());
+  fLastGradient.assign(df, df + fLayers.size());
+}
+
+//______________________________________________________________________________
+void AMultilayerMeritFunction::Gradient(const double* x, double* grad) const {
+  double f;
+  FdF(x, f, grad);
+}
@@ -0,0 +1,154 @@
+/******************************************************************************
+ * Copyright (C) 2006-, Akira Okumura                                         *
+ * All rights reserved.                                                       *
+ *****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// AMultilayerTable
+//
+// Reflectance and transmittance of a multilayer precalculated on a regular
+// grid of wavelength x incident angle, and stored in a dense array. The nodes
+// of the grid are located at the bin centers of the given ranges as in TH2D,
+// but a lookup is done by direct indexing and bilinear interpolation without
+// any axis search. The angle nodes can be equally spaced in cos(theta) instead
+// of theta, which gives finer steps near grazing incidence where the
+// reflectance changes quickly.
+//
+// Interpolate() does not modify the table and can be called from several
+// threads at the same time.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+
+#include "TH2.h"
+
+#include "AMultilayerTable.h"
+
+ClassImp(AMultilayerTable);
+
+namespace {
+
+inline void Locate(Double_t x, Int_t n, Int_t& i0, Int_t& i1, Double_t& f) {
+  // Find the two nodes around x (in the unit of the node step) and the
+  // fraction between them. x is clamped to the range of the nodes.
+  if (n == 1 or x <= 0) {
+    i0 = i1 = 0;
+    f = 0;
+  } else if (x >= n - 1) {
+    i0 = i1 = n - 1;
+    f = 0;
+  } else {
+    i0 = Int_t(x);
+    i1 = i0 + 1;
+    f = x - i0;
+  }
+}
+
+}  // namespace
+
+//______________________________________________________________________________
+AMultilayerTable::AMultilayerTable()
+    : fNlambda(0),
+      fNangle(0),
+      fLambdaMin(0),
+      fLambdaMax(0),
+      fAngleMin(0),
+      fAngleMax(0),
+      fInCosine(kFALSE),
+      fX0(0),
+      fInvDx(0),
+      fY0(0),
+      fInvDy(0) {}
+
+//______________________________________________________________________________
+AMultilayerTable::AMultilayerTable(Int_t lam_nbins, Double_t lam_min,
+                                   Double_t lam_max, Int_t th_nbins,
+                                   Double_t th_min, Double_t th_max,
+                                   Bool_t in_cosine)
+    : fNlambda(lam_nbins),
+      fNangle(th_nbins),
+      fLambdaMin(lam_min),
+      fLambdaMax(lam_max),
+      fAngleMin(th_min),
+      fAngleMax(th_max),
+      fInCosine(in_cosine),
+      fValues(2 * lam_nbins * th_nbins) {
+  // The table has lam_nbins x th_nbins nodes at the bin centers of
+  // [lam_min, lam_max] x [th_min, th_max]. If in_cosine is kTRUE, the angle
+  // nodes are the bin centers of [cos(th_max), cos(th_min)] instead. Negative
+  // angles are then treated as their absolute values because the
+  // reflectance of a multilayer does not depend on the sign of the angle.
+  Double_t dx = (lam_max - lam_min) / lam_nbins;
+  fX0 = lam_min + dx / 2.;
+  fInvDx = 1. / dx;
+
+  if (fInCosine) {
+    Double_t ymin = std::cos(th_max);
+    Double_t ymax = std::cos(th_min > 0 ? th_min : 0.);
+    Double_t dy = (ymax - ymin) / th_nbins;
+    fY0 = ymin + dy / 2.;
+    fInvDy = 1. / dy;
+  } else {
+    Double_t dy = (th_max - th_min) / th_nbins;
+    fY0 = th_min + dy / 2.;
+    fInvDy = 1. / dy;
+  }
+}
+
+//______________________________________________________________________________
+AMultilayerTable::~AMultilayerTable() {}
+
+//______________________________________________________________________________
+Double_t AMultilayerTable::GetAngle(Int_t j) const {
+  // Return the incident angle (rad) of the j-th angle node
+  Double_t y = fY0 + j / fInvDy;
+  return fInCosine ? std::acos(y) : y;
+}
+
+//______________________________________________________________________________
+void AMultilayerTable::Interpolate(Double_t lambda, Double_t angle,
+                                   Double_t& reflectance,
+                                   Double_t& transmittance) const {
+  // Bilinear interpolation of the reflectance and transmittance. Values
+  // outside the node range are clamped to the nearest edge.
+  Double_t y = fInCosine ? std::cos(angle) : angle;
+
+  Int_t i0, i1, j0, j1;
+  Double_t fx, fy;
+  Locate((lambda - fX0) * fInvDx, fNlambda, i0, i1, fx);
+  Locate((y - fY0) * fInvDy, fNangle, j0, j1, fy);
+
+  const Double_t* v00 = &fValues[2 * (i0 * fNangle + j0)];
+  const Double_t* v01 = &fValues[2 * (i0 * fNangle + j1)];
+  const Double_t* v10 = &fValues[2 * (i1 * fNangle + j0)];
+  const Double_t* v11 = &fValues[2 * (i1 * fNangle + j1)];
+
+  Double_t w00 = (1 - fx) * (1 - fy);
+  Double_t w01 = (1 - fx) * fy;
+  Double_t w10 = fx * (1 - fy);
+  Double_t w11 = fx * fy;
+
+  reflectance = w00 * v00[0] + w01 * v01[0] + w10 * v10[0] + w11 * v11[0];
+  transmittance = w00 * v00[1] + w01 * v01[1] + w10 * v10[1] + w11 * v11[1];
+}
+
+//______________________________________________________________________________
+TH2D* AMultilayerTable::MakeHist(Int_t offset) const {
+  // Copy the reflectance (offset = 0) or transmittance (offset = 1) into a new
+  // TH2D. The Y axis is cos(theta) if the angle nodes are in cosine.
+  Double_t ymin = fY0 - 0.5 / fInvDy;
+  Double_t ymax = fY0 + (fNangle - 0.5) / fInvDy;
+  TH2D* hist = new TH2D("", "", fNlambda, fLambdaMin, fLambdaMax, fNangle,
+                        ymin, ymax);
+  hist->SetDirectory(0);
+
+  for (Int_t i = 0; i < fNlambda; ++i) {
+    for (Int_t j = 0; j < fNangle; ++j) {
+      hist->SetBinContent(i + 1, j + 1, fValues[2 * (i * fNangle + j) + offset]);
+    }
+  }
+
+  return hist;
+}
@@ -17,6 +17,10 @@
 
 ClassImp(AOpticalComponent);
 
+// Incremented whenever border surface conditions are added or deleted, so
+// that AOpticsManager rebuilds its table of conditions only when needed
+ULong64_t AOpticalComponent::fgBorderSurfaceConditionVersion = 0;
+
 AOpticalComponent::AOpticalComponent()
     : TGeoVolume(), fBorderSurfaceConditionArray(0) {}
 
@@ -33,6 +37,9 @@ AOpticalComponent::AOpticalComponent(const char* name, const TGeoShape* shape,
 
 //_____________________________________________________________________________
 AOpticalComponent::~AOpticalComponent() {
+  if (fBorderSurfaceConditionArray) {
+    ++fgBorderSurfaceConditionVersion;
+  }
   SafeDelete(fBorderSurfaceConditionArray);
 }
 
@@ -45,6 +52,7 @@ void AOpticalComponent::AddBorderSurfaceCondition(
   }
 
   fBorderSurfaceConditionArray->Add(condition);
+  ++fgBorderSurfaceConditionVersion;
 }
 
 //______________________________________________________________________________
@@ -12,11 +12,12 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "TRandom.h"
-#include "TThread.h"
 
 #include <iostream>
 #include "ABorderSurfaceCondition.h"
 #include "AOpticsManager.h"
+#include "AThreadPool.h"
+#include "ATraceContext.h"
 static const Double_t kEpsilon =
     1e-6;  // Fixed in TGeoNavigator.cxx (equiv to 1e-6 cm)
 static const Double_t kInf = std::numeric_limits<Double_t>::infinity();
@@ -25,8 +26,15 @@ ClassImp(AOpticsManager);
 
 //_____________________________________________________________________________
 AOpticsManager::AOpticsManager()
-    : TGeoManager(), fDisableFresnelReflection(kFALSE) {
+    : TGeoManager(), fDisableFresnelReflection(kFALSE),
+      fChunkSize(64),
+      fSeed(0),
+      fNtraces(0),
+      fThreadPool(0),
+      fBorderConditionVersion(0) {
   fLimit = 100;
+  fRecording = ARay::kRecordAll;
+  fWeightedTracing = kFALSE;
   fClassList[kLens] = ALens::Class();
   fClassList[kFocus] = AFocalSurface::Class();
   fClassList[kMirror] = AMirror::Class();
@@ -36,8 +44,15 @@ AOpticsManager::AOpticsManager()
 
 //_____________________________________________________________________________
 AOpticsManager::AOpticsManager(const char* name, const char* title)
-    : TGeoManager(name, title), fDisableFresnelReflection(kFALSE) {
+    : TGeoManager(name, title), fDisableFresnelReflection(kFALSE),
+      fChunkSize(64),
+      fSeed(0),
+      fNtraces(0),
+      fThreadPool(0),
+      fBorderConditionVersion(0) {
   fLimit = 100;
+  fRecording = ARay::kRecordAll;
+  fWeightedTracing = kFALSE;
   fClassList[kLens] = ALens::Class();
   fClassList[kFocus] = AFocalSurface::Class();
   fClassList[kMirror] = AMirror::Class();
@@ -46,12 +61,122 @@ AOpticsManager::AOpticsManager(const char* name, const char* title)
 }
 
 //_____________________________________________________________________________
-AOpticsManager::~AOpticsManager() {}
+AOpticsManager::~AOpticsManager() { DeleteThreadPool(); }
+
+//_____________________________________________________________________________
+void AOpticsManager::BuildBorderSurfaceConditions() {
+  // Make the table of border surface conditions indexed by the pair of volume
+  // numbers, so that the condition of a boundary crossing is found by one
+  // hash lookup instead of a linear search in AOpticalComponent. Conditions
+  // may be added at any time, so PrepareTracing rebuilds the table when
+  // AOpticalComponent::GetBorderSurfaceConditionVersion() has changed.
+  fBorderConditions.clear();
+  fBorderConditionVersion =
+      AOpticalComponent::GetBorderSurfaceConditionVersion();
+  TObjArray* volumes = GetListOfVolumes();
+  Int_t n = volumes ? volumes->GetEntriesFast() : 0;
+  fHasBorderConditions.assign(n, kFALSE);
+
+  for (Int_t i = 0; i < n; i++) {
+    TGeoVolume* volume = (TGeoVolume*)volumes->At(i);
+    if (not volume or volume->GetNumber() != i or
+        not volume->InheritsFrom(AOpticalComponent::Class())) {
+      continue;
+    }
+    const TObjArray* conditions =
+        ((AOpticalComponent*)volume)->GetBorderSurfaceConditions();
+    if (not conditions) {
+      continue;
+    }
+
+    for (Int_t j = 0; j < conditions->GetEntries(); j++) {
+      auto condition = (ABorderSurfaceCondition*)conditions->At(j);
+      const AOpticalComponent* component2 = condition->GetComponent2();
+      Int_t k = component2 ? component2->GetNumber() : -1;
+      // The first one wins as in AOpticalComponent::FindBorderSurfaceCondition
+      fBorderConditions.emplace((ULong64_t(i) << 32) | (UInt_t)k, condition);
+      fHasBorderConditions[i] = kTRUE;
+    }
+  }
+}
+
+//_____________________________________________________________________________
+void AOpticsManager::BuildReflectanceGrids() {
+  // Resample the reflectance data of the mirrors that use a reflectance grid
+  // (see AMirror::UseReflectanceGrid), unless their grids are up to date
+  TObjArray* volumes = GetListOfVolumes();
+  for (std::size_t i = 0; i < fVolumeTypes.size(); i++) {
+    if (fVolumeTypes[i] != kMirror) continue;
+    AMirror* mirror = (AMirror*)volumes->At(i);
+    if (mirror->IsReflectanceGridUsed() and not mirror->HasReflectanceGrid()) {
+      mirror->BuildReflectanceGrid();
+    }
+  }
+}
+
+//_____________________________________________________________________________
+void AOpticsManager::BuildVolumeTypes() {
+  // Classify all the volumes once, so that the tracing kernel needs only one
+  // table lookup per node instead of a chain of IsA() comparisons
+  TObjArray* volumes = GetListOfVolumes();
+  Int_t n = volumes ? volumes->GetEntriesFast() : 0;
+  fVolumeTypes.assign(n, kOther);
+  for (Int_t i = 0; i < n; i++) {
+    TGeoVolume* volume = (TGeoVolume*)volumes->At(i);
+    if (volume and volume->GetNumber() == i) {
+      fVolumeTypes[i] = ClassifyVolume(volume);
+    }
+  }
+}
+
+//_____________________________________________________________________________
+Int_t AOpticsManager::ClassifyVolume(const TGeoVolume* volume) const {
+  // Exact class match as in IsLens() etc., so subclasses are not included
+  TClass* cl = volume->IsA();
+  if (cl == fClassList[kLens]) {
+    return kLens;
+  } else if (cl == fClassList[kObs]) {
+    return kObs;
+  } else if (cl == fClassList[kMirror]) {
+    return kMirror;
+  } else if (cl == fClassList[kFocus]) {
+    return kFocus;
+  } else if (cl == fClassList[kOpt]) {
+    return kOpt;
+  }
+
+  return kOther;
+}
+
+//_____________________________________________________________________________
+void AOpticsManager::CloseGeometry(Option_t* option) {
+  // Close the geometry, build the table of optical types of the volumes, and
+  // resample the reflectance data of the mirrors if requested
+  TGeoManager::CloseGeometry(option);
+  BuildVolumeTypes();
+  BuildBorderSurfaceConditions();
+  BuildReflectanceGrids();
+}
+
+//_____________________________________________________________________________
+void AOpticsManager::DeleteThreadPool() {
+  // Stop the worker threads first, then remove their navigators. A navigator
+  // must not be removed while its thread is alive because TGeoManager caches
+  // the current navigator of each thread in thread-local storage.
+  SafeDelete(fThreadPool);
+
+  for (auto& context : fWorkerContexts) {
+    if (context) RemoveNavigator(context->GetNavigator());
+  }
+  fWorkerContexts.clear();
+}
 
 //_____________________________________________________________________________
 void AOpticsManager::DoFresnel(Double_t n1, Double_t n2, Double_t k2, ARay& ray,
-                               TGeoNavigator* nav, TGeoNode* currentNode,
-                               TGeoNode* nextNode) {
+                               ATraceContext& context, TGeoNode* nextNode,
+                               ABorderSurfaceCondition* condition) {
+  ROBAST_STATS_COUNT_HANDLER(context, kFresnel);
+  TGeoNavigator* nav = context.GetNavigator();
   Double_t step = nav->GetStep();
 
   // Calculation taken from
@@ -59,8 +184,8 @@ void AOpticsManager::DoFresnel(Double_t n1, Double_t n2, Double_t k2, ARay& ray,
   // See Eq. (2-75) - (2-84)
   // theta1 = incident angle
   // theta2 = transmission angle
-  TVector3 n = GetFacetNormal(
-      nav, currentNode, nextNode);  // normal vect perpendicular to the surface
+  // normal vect perpendicular to the surface
+  TVector3 n = GetFacetNormal(context, condition);
   Double_t d1[3];
   ray.GetDirection(d1);
   Double_t cos1 = d1[0] * n[0] + d1[1] * n[1] + d1[2] * n[2];  // cos(theta1)
@@ -68,12 +193,6 @@ void AOpticsManager::DoFresnel(Double_t n1, Double_t n2, Double_t k2, ARay& ray,
   Double_t sin2 = n1 * sin1 / n2;  // Snell's law
   Double_t cos2 = TMath::Sqrt(1 - sin2 * sin2);
 
-  AOpticalComponent* component1 = (AOpticalComponent*)currentNode->GetVolume();
-  AOpticalComponent* component2 =
-      nextNode ? (AOpticalComponent*)nextNode->GetVolume() : 0;
-  ABorderSurfaceCondition* condition =
-      component1 ? component1->FindBorderSurfaceCondition(component2) : 0;
-
   Bool_t absorbed = kFALSE;
 
   if (condition and condition->GetMultilayer()) {
@@ -81,11 +200,18 @@ void AOpticsManager::DoFresnel(Double_t n1, Double_t n2, Double_t k2, ARay& ray,
     Double_t angle = TMath::ACos(cos1);
     Double_t lambda = ray.GetLambda();
     // polarization is ignored in this version
+    ROBAST_STATS_COUNT_HANDLER(context, kMultilayer);
     condition->GetMultilayer()->CoherentTMMMixed(angle, lambda, reflectance,
                                                  transmittance);
-    auto rnd = gRandom->Uniform(1);
+    auto rnd = context.GetRandom().Uniform(1);
+    if (fWeightedTracing and reflectance + transmittance > 0) {
+      // The absorbed fraction is taken from the weight, and only reflection
+      // or transmission is sampled
+      ray.SetWeight(ray.GetWeight() * (reflectance + transmittance));
+      rnd *= reflectance + transmittance;
+    }
     if (rnd < reflectance) {  // reflection at the boundary
-      DoReflection(n1, ray, nav, currentNode, nextNode, &n);
+      DoReflection(n1, ray, context, nextNode, condition, &n);
       return;
     } else if (rnd < reflectance + transmittance) {
       goto transmission_process;
@@ -96,47 +222,14 @@ void AOpticsManager::DoFresnel(Double_t n1, Double_t n2, Double_t k2, ARay& ray,
   }
 
   if (sin2 > 1.) {  // total internal reflection
-    DoReflection(n1, ray, nav, currentNode, nextNode, &n);
+    DoReflection(n1, ray, context, nextNode, condition, &n);
     return;
   }
 
   if (fDisableFresnelReflection == kFALSE) {
-    Double_t Rs, Rp;  // reflectivity for s- and p-polarized photon
-    auto _2 = [](Double_t v) { return v * v; };
-    if (k2 <= 0.) {
-      Double_t eta1S = n1 * cos1;
-      Double_t eta2S = n2 * cos2;
-      // We assume cos1 is non-zero here but a non-zero check might be needed
-      // As long as navigation is OK, theta1 should not be 90 deg
-      Double_t eta1P = n1 / cos1;
-      Double_t eta2P = n2 / cos2;
-
-      Rs = _2((eta1S - eta2S) / (eta1S + eta2S));
-      Rp = _2((eta1P - eta2P) / (eta1P + eta2P));
-    } else {
-      Double_t eta1S = n1 * cos1;
-      Double_t eta1P = n1 / cos1;
-      Double_t x1S = eta1S;
-      Double_t x1P = eta1P;
-      Double_t u = _2(n2) - _2(k2) - _2(n1 * sin1);
-      Double_t v = 2 * n2 * k2;
-      Double_t tmp = TMath::Sqrt(_2(u) + _2(v));
-      // cos(\xi/2), sin(\xi/2)
-      Double_t cosxi2 = TMath::Sqrt(1 + u / tmp) / TMath::Sqrt2();
-      Double_t sinxi2 = TMath::Sqrt(1 - u / tmp) / TMath::Sqrt2();
-      // Double_t xi = TMath::ATan(v / u); // unused
-      Double_t x2S = TMath::Sqrt(tmp) * cosxi2;
-      Double_t y2S = TMath::Sqrt(tmp) * sinxi2;
-      tmp = _2(x2S) + _2(y2S);
-      Double_t x2P = (2 * n2 * k2 * y2S + (_2(n2) - _2(k2)) * x2S) / tmp;
-      Double_t y2P = (2 * n2 * k2 * x2S - (_2(n2) - _2(k2)) * y2S) / tmp;
-      Rs = (_2(x1S - x2S) + _2(y2S)) / (_2(x1S + x2S) + _2(y2S));
-      Rp = (_2(x1P - x2P) + _2(y2P)) / (_2(x1P + x2P) + _2(y2P));
-    }
-    Double_t R = (Rs + Rp) / 2.;  // We assume that polarization is random
-
-    if (gRandom->Uniform(1) < R) {  // reflection at the boundary
-      DoReflection(n1, ray, nav, currentNode, nextNode, &n);
+    Double_t R = FresnelReflectance(n1, n2, k2, cos1);
+    if (context.GetRandom().Uniform(1) < R) {  // reflection at the boundary
+      DoReflection(n1, ray, context, nextNode, condition, &n);
       return;
     }
   }
@@ -156,8 +249,7 @@ transmission_process:
   // step (m), c (m/s)
   Double_t speed = TMath::C() * m() / n1;
   Double_t t = x1[3] + step / speed;
-  ray.AddPoint(x2[0], x2[1], x2[2], t);
-  ray.AddNode(nextNode);
+  ray.AddStep(x2[0], x2[1], x2[2], t, nextNode, fRecording);
   if (absorbed) {
     ray.Absorb();
   } else {
@@ -167,39 +259,39 @@ transmission_process:
 }
 
 //_____________________________________________________________________________
-void AOpticsManager::DoReflection(Double_t n1, ARay& ray, TGeoNavigator* nav,
-                                  TGeoNode* currentNode, TGeoNode* nextNode,
+void AOpticsManager::DoReflection(Double_t n1, ARay& ray,
+                                  ATraceContext& context, TGeoNode* nextNode,
+                                  ABorderSurfaceCondition* condition,
                                   TVector3* normal) {
+  ROBAST_STATS_COUNT_HANDLER(context, kReflection);
+  TGeoNavigator* nav = context.GetNavigator();
   Double_t step = nav->GetStep();
 
   // normal vect perpendicular to the surface
   // if it is not calculated yet, call GetFacetNormal
-  TVector3 n = normal ? *normal : GetFacetNormal(nav, currentNode, nextNode);
+  TVector3 n = normal ? *normal : GetFacetNormal(context, condition);
   Double_t d1[3];
   ray.GetDirection(d1);
   Double_t cos1 = d1[0] * n[0] + d1[1] * n[1] + d1[2] * n[2]; // should be positive
 
-  AOpticalComponent* component1 = (AOpticalComponent*)currentNode->GetVolume();
-  AOpticalComponent* component2 =
-      nextNode ? (AOpticalComponent*)nextNode->GetVolume() : 0;
-  ABorderSurfaceCondition* condition =
-      component1 ? component1->FindBorderSurfaceCondition(component2) : 0;
-
   Bool_t absorbed = kFALSE;
 
-  if (IsMirror(nextNode)) {
+  if (GetOpticalType(nextNode) == kMirror) {
     Double_t angle = TMath::ACos(cos1);
     Double_t lambda = ray.GetLambda();
     Double_t ref;
     if (condition and condition->GetMultilayer()) {
       Double_t transmittance;
       // ignore polarization in the current version
+      ROBAST_STATS_COUNT_HANDLER(context, kMultilayer);
       condition->GetMultilayer()->CoherentTMMMixed(angle, lambda, ref,
                                                    transmittance);
     } else {
       ref = ((AMirror*)nextNode->GetVolume())->GetReflectance(lambda, angle);
     }
-    if (ref < gRandom->Uniform(1)) {
+    if (fWeightedTracing and ref > 0) {
+      ray.SetWeight(ray.GetWeight() * ref);
+    } else if (ref < context.GetRandom().Uniform(1)) {
       absorbed = kTRUE;
       ray.Absorb();
     }
@@ -211,9 +303,9 @@ void AOpticsManager::DoReflection(Double_t n1, ARay& ray, TGeoNavigator* nav,
     // y (\theta) = \int _0 ^\theta \sin\theta' \cos\theta' d\theta'
     //            = \frac{1}{2} \sin^2 \theta
     // \theta (y) = \asin \sqrt{2y}
-    Double_t y = gRandom->Uniform(0, 0.5);
+    Double_t y = context.GetRandom().Uniform(0, 0.5);
     Double_t theta = TMath::ASin(TMath::Sqrt(2 * y)); // [0, pi/2]
-    Double_t phi = gRandom->Uniform(0., TMath::TwoPi());
+    Double_t phi = context.GetRandom().Uniform(0., TMath::TwoPi());
 
     Double_t theta_n = n.Theta() * TMath::RadToDeg();
     Double_t phi_n = n.Phi() * TMath::RadToDeg();
@@ -242,24 +334,85 @@ void AOpticsManager::DoReflection(Double_t n1, ARay& ray, TGeoNavigator* nav,
   nav->SetStep(kEpsilon);
   nav->Step();
   nav->SetCurrentDirection(d2);
-  ray.AddPoint(x2[0], x2[1], x2[2], t);
-  ray.AddNode(nextNode);
+  ray.AddStep(x2[0], x2[1], x2[2], t, nextNode, fRecording);
 }
 
 //_____________________________________________________________________________
-TVector3 AOpticsManager::GetFacetNormal(TGeoNavigator* nav,
-                                        TGeoNode* currentNode,
-                                        TGeoNode* nextNode) {
-  AOpticalComponent* component1 = (AOpticalComponent*)currentNode->GetVolume();
-  AOpticalComponent* component2 =
-      nextNode ? (AOpticalComponent*)nextNode->GetVolume() : 0;
+Double_t AOpticsManager::FresnelReflectance(Double_t n1, Double_t n2,
+                                            Double_t k2, Double_t cos1) {
+  // Return the Fresnel reflectance of unpolarized light incident from a
+  // medium of n1 onto a medium of n2 + i k2 at an angle of acos(cos1). The
+  // light must not be totally reflected.
+  // Calculation taken from
+  // M. Kobiyama "Kogakuhakumaku no Kisoriron" (OPTRONICS, Tokyo, 2011)
+  // See Eq. (2-75) - (2-84)
+  Double_t sin1 = TMath::Sqrt(1 - cos1 * cos1);
+  Double_t sin2 = n1 * sin1 / n2;  // Snell's law
+  Double_t cos2 = TMath::Sqrt(1 - sin2 * sin2);
+
+  Double_t Rs, Rp;  // reflectivity for s- and p-polarized photon
+  auto _2 = [](Double_t v) { return v * v; };
+  if (k2 <= 0.) {
+    Double_t eta1S = n1 * cos1;
+    Double_t eta2S = n2 * cos2;
+    // We assume cos1 is non-zero here but a non-zero check might be needed
+    // As long as navigation is OK, theta1 should not be 90 deg
+    Double_t eta1P = n1 / cos1;
+    Double_t eta2P = n2 / cos2;
+
+    Rs = _2((eta1S - eta2S) / (eta1S + eta2S));
+    Rp = _2((eta1P - eta2P) / (eta1P + eta2P));
+  } else {
+    Double_t eta1S = n1 * cos1;
+    Double_t eta1P = n1 / cos1;
+    Double_t x1S = eta1S;
+    Double_t x1P = eta1P;
+    Double_t u = _2(n2) - _2(k2) - _2(n1 * sin1);
+    Double_t v = 2 * n2 * k2;
+    Double_t tmp = TMath::Sqrt(_2(u) + _2(v));
+    // cos(\xi/2), sin(\xi/2)
+    Double_t cosxi2 = TMath::Sqrt(1 + u / tmp) / TMath::Sqrt2();
+    Double_t sinxi2 = TMath::Sqrt(1 - u / tmp) / TMath::Sqrt2();
+    // Double_t xi = TMath::ATan(v / u); // unused
+    Double_t x2S = TMath::Sqrt(tmp) * cosxi2;
+    Double_t y2S = TMath::Sqrt(tmp) * sinxi2;
+    tmp = _2(x2S) + _2(y2S);
+    Double_t x2P = (2 * n2 * k2 * y2S + (_2(n2) - _2(k2)) * x2S) / tmp;
+    Double_t y2P = (2 * n2 * k2 * x2S - (_2(n2) - _2(k2)) * y2S) / tmp;
+    Rs = (_2(x1S - x2S) + _2(y2S)) / (_2(x1S + x2S) + _2(y2S));
+    Rp = (_2(x1P - x2P) + _2(y2P)) / (_2(x1P + x2P) + _2(y2P));
+  }
+
+  return (Rs + Rp) / 2.;  // We assume that polarization is random
+}
+
+//_____________________________________________________________________________
+ABorderSurfaceCondition* AOpticsManager::GetBorderSurfaceCondition(
+    const TGeoNode* node1, const TGeoNode* node2) const {
+  // Return the condition of the border from node1 to node2, or 0 if there is
+  // none. The table is made by CloseGeometry and at every tracing call.
+  if (not node1) {
+    return 0;
+  }
+
+  Int_t i = node1->GetVolume()->GetNumber();
+  if (i < 0 or i >= (Int_t)fHasBorderConditions.size() or
+      not fHasBorderConditions[i]) {
+    return 0;
+  }
 
+  Int_t k = node2 ? node2->GetVolume()->GetNumber() : -1;
+  auto it = fBorderConditions.find((ULong64_t(i) << 32) | (UInt_t)k);
+  return it == fBorderConditions.end() ? 0 : it->second;
+}
+
+//_____________________________________________________________________________
+TVector3 AOpticsManager::GetFacetNormal(ATraceContext& context,
+                                        ABorderSurfaceCondition* condition) {
+  TGeoNavigator* nav = context.GetNavigator();
   TVector3 normal(nav->FindNormal());
   TVector3 momentum(nav->GetCurrentDirection());
 
-  ABorderSurfaceCondition* condition =
-      component1 ? component1->FindBorderSurfaceCondition(component2) : 0;
-
   if (condition and condition->IsLambertian()) {
     // Lambertian distribution should be calculated in another place
     return normal;
@@ -273,11 +426,11 @@ TVector3 AOpticsManager::GetFacetNormal(TGeoNavigator* nav,
 
     do {
       do {
-        alpha = gRandom->Gaus(0, sigma_alpha);
-      } while (gRandom->Uniform(f_max) > TMath::Sin(alpha) ||
+        alpha = context.GetRandom().Gaus(0, sigma_alpha);
+      } while (context.GetRandom().Uniform(f_max) > TMath::Sin(alpha) ||
                alpha >= TMath::PiOver2());
 
-      Double_t phi = gRandom->Uniform(TMath::TwoPi());
+      Double_t phi = context.GetRandom().Uniform(TMath::TwoPi());
 
       Double_t SinAlpha = TMath::Sin(alpha);
       Double_t CosAlpha = TMath::Cos(alpha);
@@ -301,26 +454,98 @@ TVector3 AOpticsManager::GetFacetNormal(TGeoNavigator* nav,
 }
 
 //_____________________________________________________________________________
-void* AOpticsManager::Thread(void* args) {
-  AOpticsManager* manager = (AOpticsManager*)((TObject**)args)[0];
-  ARayArray* array = (ARayArray*)((TObject**)args)[1];
+ATraceContext& AOpticsManager::GetCallerContext() {
+  // Return the context used when rays are traced without the thread pool. It
+  // is kept across tracing calls, and is rebuilt only if the calling thread
+  // has another navigator, e.g., when a different thread traces rays.
+  TGeoNavigator* nav = GetCallerNavigator();
+  if (!fCallerContext or fCallerContext->GetNavigator() != nav) {
+    fCallerContext.reset(new ATraceContext(nav));
+  }
 
-  TObjArray* running = array->GetRunning();
-  manager->TraceNonSequential(running);
+  return *fCallerContext;
+}
 
-  Int_t n = running->GetLast();
+//_____________________________________________________________________________
+TGeoNavigator* AOpticsManager::GetCallerNavigator() {
+  // Return the navigator of the calling thread, which is used when rays are
+  // traced without the thread pool
+  TGeoNavigator* nav = GetCurrentNavigator();
+  if (!nav) {
+#if ROOT_VERSION(6, 9, 2) <= ROOT_VERSION_CODE && \
+    ROOT_VERSION_CODE <= ROOT_VERSION(6, 10, 2)
+    // This line is missing in TGeoManager::AddNavigator
+    if (IsMultiThread()) TGeoManager::ThreadId();
+#endif
+    nav = AddNavigator();
+  }
 
-  for (Int_t i = 0; i <= n; i++) {
-    ARay* ray = (ARay*)(running->RemoveAt(i));
-    if (!ray) continue;
-    array->Add(ray);
+  return nav;
+}
+
+//_____________________________________________________________________________
+AThreadPool* AOpticsManager::GetThreadPool(Int_t nthreads) {
+  // Return the persistent pool of tracing threads. The pool and the
+  // contexts of its threads are reused by the following TraceNonSequential
+  // calls, and are rebuilt only when the number of threads has been changed.
+  if (fThreadPool and (Int_t)fThreadPool->GetNthreads() == nthreads) {
+    return fThreadPool;
   }
 
-  running->Expand(0);
+  DeleteThreadPool();
+  fThreadPool = new AThreadPool(nthreads);
+  fWorkerContexts.resize(nthreads);
 
-  manager->RemoveNavigator(manager->GetCurrentNavigator());
+  return fThreadPool;
+}
 
-  return 0;
+//_____________________________________________________________________________
+ATraceContext& AOpticsManager::GetWorkerContext(std::size_t worker) {
+  // Return the context of a pool thread. This must be called only in the
+  // thread itself because each navigator is created by and used only in its
+  // own thread.
+  std::unique_ptr<ATraceContext>& context = fWorkerContexts[worker];
+  if (!context) {
+#if ROOT_VERSION(6, 9, 2) <= ROOT_VERSION_CODE && \
+    ROOT_VERSION_CODE <= ROOT_VERSION(6, 10, 2)
+    // This line is missing in TGeoManager::AddNavigator
+    TGeoManager::ThreadId();
+#endif
+    context.reset(new ATraceContext(AddNavigator()));
+  }
+
+  return *context;
+}
+
+//_____________________________________________________________________________
+void AOpticsManager::MergeTraceStatistics(ATraceContext& context) {
+  // Add the counters of a thread to fTraceStatistics and reset them. This is
+  // called in the main thread after the worker threads have become idle.
+#ifdef ROBAST_INSTRUMENTATION
+  fTraceStatistics.SetVolumeNames(GetListOfVolumes());
+  fTraceStatistics.Add(context.GetStatistics());
+  context.GetStatistics().Clear();
+#else
+  (void)context;
+#endif
+}
+
+//_____________________________________________________________________________
+ULong64_t AOpticsManager::NextTraceKey() {
+  // Return the key of the random number streams used in a new tracing call.
+  // If no seed is given by SetSeed, the key is drawn from gRandom so that
+  // gRandom->SetSeed() still makes the results reproducible.
+  if (fSeed == 0) {
+    ULong64_t hi = gRandom->Integer(0xFFFFFFFF);
+    ULong64_t lo = gRandom->Integer(0xFFFFFFFF);
+    return (hi << 32) | lo;
+  }
+
+  // SplitMix64 finalizer to decorrelate the keys of successive calls
+  ULong64_t z = fSeed + 0x9E3779B97F4A7C15ULL * ++fNtraces;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
 }
 
 //_____________________________________________________________________________
@@ -332,17 +557,69 @@ void AOpticsManager::TraceNonSequential(ARay& ray) {
 }
 
 //_____________________________________________________________________________
-void AOpticsManager::TraceNonSequential(TObjArray* array) {
-  TGeoNavigator* nav = GetCurrentNavigator();
-  if (!nav) {
-#if ROOT_VERSION(6, 9, 2) <= ROOT_VERSION_CODE && \
-    ROOT_VERSION_CODE <= ROOT_VERSION(6, 10, 2)
-    // This line is missing in TGeoManager::AddNavigator
-    if (IsMultiThread()) TGeoManager::ThreadId();
-#endif
-    nav = AddNavigator();
+void AOpticsManager::TraceNonSequential(ARayBatch& batch) {
+  // Trace all the running photons in a batch. No ARay is allocated per photon;
+  // each thread reuses the scratch ARay of its context, and only the final
+  // state of each photon is written back to the batch.
+  std::size_t n = batch.GetN();
+  if (n == 0) {
+    return;
   }
 
+  PrepareTracing();
+
+  ULong64_t key = NextTraceKey();
+  auto trace = [this, &batch, key](ATraceContext& context, std::size_t begin,
+                                   std::size_t end) {
+    ARay& ray = context.GetScratchRay();
+    for (std::size_t i = begin; i < end; ++i) {
+      if (not batch.IsRunning(i)) {
+        continue;
+      }
+
+      Double_t x[4], d[3];
+      batch.GetLastPoint(i, x);
+      batch.GetDirection(i, d);
+      ray.Reset(batch.GetLambda(i), x[0], x[1], x[2], x[3], d[0], d[1], d[2]);
+      ray.SetWeight(batch.GetWeight(i));
+
+      context.StartRay(key, i);
+      TraceRay(&ray, context);
+
+      ray.GetLastPoint(x);
+      ray.GetDirection(d);
+      batch.SetLastPoint(i, x);
+      batch.SetDirection(i, d);
+      batch.SetStatus(i, ray.GetStatus());
+      batch.SetWeight(i, ray.GetWeight());
+    }
+  };
+
+  Int_t nthreads = GetMaxThreads();
+
+  if (IsMultiThread() and nthreads >= 2) {
+    AThreadPool* pool = GetThreadPool(nthreads);
+    pool->ParallelFor(n, fChunkSize,
+                      [this, &trace](std::size_t worker, std::size_t begin,
+                                     std::size_t end) {
+                        trace(GetWorkerContext(worker), begin, end);
+                      });
+    for (auto& context : fWorkerContexts) {
+      if (context) MergeTraceStatistics(*context);
+    }
+  } else {  // single thread
+    ATraceContext& context = GetCallerContext();
+    trace(context, 0, n);
+    MergeTraceStatistics(context);
+  }
+}
+
+//_____________________________________________________________________________
+void AOpticsManager::TraceNonSequential(TObjArray* array) {
+  PrepareTracing();
+  ATraceContext& context = GetCallerContext();
+  ULong64_t key = NextTraceKey();
+
   Int_t n = array->GetLast();
   for (Int_t j = 0; j <= n; j++) {
     ARay* ray = (ARay*)array->At(j);
@@ -350,173 +627,162 @@ void AOpticsManager::TraceNonSequential(TObjArray* array) {
       continue;
     }
 
-    Double_t lambda = ray->GetLambda();
-    Double_t x1[4], d1[3];
+    // The stream of each ray is determined by its index in the array
+    context.StartRay(key, j);
+    TraceRay(ray, context);
+  }
+  MergeTraceStatistics(context);
+}
+
+//_____________________________________________________________________________
+void AOpticsManager::TraceRay(ARay* ray, ATraceContext& context) {
+  // Trace a single running ray with the given context, which must belong to
+  // the calling thread. All the random numbers are taken from the context.
+  TGeoNavigator* nav = context.GetNavigator();
+  Double_t lambda = ray->GetLambda();
+  Double_t x1[4], d1[3];
+  ray->GetLastPoint(x1);
+  ray->GetDirection(d1);
+  nav->InitTrack(x1, d1);
+  ROBAST_STATS_START_RAY(context, *ray);
+
+  while (ray->IsRunning()) {
     ray->GetLastPoint(x1);
     ray->GetDirection(d1);
-    nav->InitTrack(x1, d1);
-
-    while (ray->IsRunning()) {
-      ray->GetLastPoint(x1);
-      ray->GetDirection(d1);
-
-      TGeoNode* currentNode = nav->GetCurrentNode();
-      if (nav->IsOutside()) {  // if the current position is outside of top
-                               // volume
-        currentNode = 0;
-      }
 
-      TGeoNode* nextNode = nav->FindNextBoundaryAndStep();
-      Double_t step = nav->GetStep();  // distance to the next boundary
-
-      // Check type of start node
-      Int_t typeCurrent = kOther;
-      Int_t typeNext = kOther;
-
-      if (!currentNode)
-        typeCurrent = kNull;
-      else if (IsLens(currentNode))
-        typeCurrent = kLens;
-      else if (IsObscuration(currentNode))
-        typeCurrent = kObs;
-      else if (IsMirror(currentNode))
-        typeCurrent = kMirror;
-      else if (IsFocalSurface(currentNode))
-        typeCurrent = kFocus;
-      else if (IsOpticalComponent(currentNode))
-        typeCurrent = kOpt;
-
-      // Check type of next node
-      if (!nextNode)
-        typeNext = kNull;
-      else if (IsLens(nextNode))
-        typeNext = kLens;
-      else if (IsObscuration(nextNode))
-        typeNext = kObs;
-      else if (IsMirror(nextNode))
-        typeNext = kMirror;
-      else if (IsFocalSurface(nextNode))
-        typeNext = kFocus;
-      else if (IsOpticalComponent(nextNode))
-        typeNext = kOpt;
+    TGeoNode* currentNode = nav->GetCurrentNode();
+    if (nav->IsOutside()) {  // if the current position is outside of top
+                             // volume
+      currentNode = 0;
+    }
 
-      if (typeCurrent == kLens) {
-        Double_t abs =
-            ((ALens*)currentNode->GetVolume())->GetAbsorptionLength(lambda);
-        if (abs > 0 && abs != kInf) {
-          Double_t abs_step = gRandom->Exp(abs);
+    ROBAST_STATS_COUNT_STEP(context, currentNode);
+    ROBAST_STATS_START_TIMER(context, kNavigation);
+    TGeoNode* nextNode = nav->FindNextBoundaryAndStep();
+    ROBAST_STATS_STOP_TIMER(context, kNavigation);
+    Double_t step = nav->GetStep();  // distance to the next boundary
+
+    // Check types of the start and next nodes
+    Int_t typeCurrent = GetOpticalType(currentNode);
+    Int_t typeNext = GetOpticalType(nextNode);
+    ALens* lens1 = typeCurrent == kLens ? (ALens*)currentNode->GetVolume() : 0;
+    ALens* lens2 = typeNext == kLens ? (ALens*)nextNode->GetVolume() : 0;
+    // Resolved once and used by all the surface handlers of this crossing
+    ABorderSurfaceCondition* condition =
+        GetBorderSurfaceCondition(currentNode, nextNode);
+
+    if (typeCurrent == kLens) {
+      Double_t abs = context.GetAbsorptionLength(lens1, lambda);
+      if (abs > 0 and abs != kInf) {
+        if (fWeightedTracing) {
+          // The ray always reaches the next boundary with a reduced weight
+          ray->SetWeight(ray->GetWeight() * TMath::Exp(-step / abs));
+        } else {
+          Double_t abs_step = context.GetRandom().Exp(abs);
           if (abs_step < step) {
-            Double_t n1 =
-                ((ALens*)currentNode->GetVolume())->GetRefractiveIndex(lambda);
+            Double_t n1 = context.GetRefractiveIndex(lens1, lambda);
             Double_t speed = TMath::C() * m() / n1;
             Double_t x2[3];
             for (Int_t i = 0; i < 3; i++) {
               x2[i] = x1[i] + abs_step * d1[i];
             }
             Double_t t = x1[3] + abs_step / speed;
-            ray->AddPoint(x2[0], x2[1], x2[2], t);
-            ray->AddNode(nextNode);
+            ray->AddStep(x2[0], x2[1], x2[2], t, nextNode, fRecording);
             ray->Absorb();
             continue;
           }
         }
       }
+    }
 
-      if ((typeCurrent == kNull or typeCurrent == kOpt or
-           typeCurrent == kLens or typeCurrent == kOther) and
-          typeNext == kMirror) {
-        Double_t n1 =
-            typeCurrent == kLens
-                ? ((ALens*)currentNode->GetVolume())->GetRefractiveIndex(lambda)
-                : 1.;
-        DoReflection(n1, *ray, nav, currentNode, nextNode);
-      } else if ((typeCurrent == kNull or typeCurrent == kOpt or
-                  typeCurrent == kOther) and
-                 typeNext == kLens) {
-        Double_t n1 = 1;  // Assume refractive index equals 1 (= vacuum)
-        Double_t n2 =
-            ((ALens*)nextNode->GetVolume())->GetRefractiveIndex(lambda);
-        Double_t k2 =
-            ((ALens*)nextNode->GetVolume())->GetExtinctionCoefficient(lambda);
-        DoFresnel(n1, n2, k2, *ray, nav, currentNode, nextNode);
-      } else if ((typeCurrent == kNull or typeCurrent == kLens or
-                  typeCurrent == kOpt or typeCurrent == kOther) and
-                 (typeNext == kObs or typeNext == kFocus)) {
-        const Double_t* x2 = nav->GetCurrentPoint();
-        Double_t t;
-        if (typeCurrent == kLens) {
-          Double_t n1 =
-              ((ALens*)currentNode->GetVolume())->GetRefractiveIndex(lambda);
-          Double_t speed = TMath::C() * m() / n1;
-          t = x1[3] + step / speed;
-        } else {
-          Double_t speed = TMath::C() * m();
-          t = x1[3] + step / speed;
-        }
-        ray->AddPoint(x2[0], x2[1], x2[2], t);
-        ray->AddNode(nextNode);
-      } else if ((typeCurrent == kNull or typeCurrent == kOpt or
-                  typeCurrent == kOther) and
-                 (typeNext == kOther or typeNext == kOpt)) {
-        const Double_t* x2 = nav->GetCurrentPoint();
-
+    ROBAST_STATS_START_TIMER(context, kSurfacePhysics);
+    if ((typeCurrent == kNull or typeCurrent == kOpt or
+         typeCurrent == kLens or typeCurrent == kOther) and
+        typeNext == kMirror) {
+      Double_t n1 = lens1 ? context.GetRefractiveIndex(lens1, lambda) : 1.;
+      DoReflection(n1, *ray, context, nextNode, condition);
+    } else if ((typeCurrent == kNull or typeCurrent == kOpt or
+                typeCurrent == kOther) and
+               typeNext == kLens) {
+      Double_t n1 = 1;  // Assume refractive index equals 1 (= vacuum)
+      Double_t n2 = context.GetRefractiveIndex(lens2, lambda);
+      Double_t k2 = context.GetExtinctionCoefficient(lens2, lambda);
+      DoFresnel(n1, n2, k2, *ray, context, nextNode, condition);
+    } else if ((typeCurrent == kNull or typeCurrent == kLens or
+                typeCurrent == kOpt or typeCurrent == kOther) and
+               (typeNext == kObs or typeNext == kFocus)) {
+      const Double_t* x2 = nav->GetCurrentPoint();
+      Double_t t;
+      if (typeCurrent == kLens) {
+        Double_t n1 = context.GetRefractiveIndex(lens1, lambda);
+        Double_t speed = TMath::C() * m() / n1;
+        t = x1[3] + step / speed;
+      } else {
         Double_t speed = TMath::C() * m();
-        Double_t t = x1[3] + step / speed;
-        ray->AddPoint(x2[0], x2[1], x2[2], t);
-        ray->AddNode(nextNode);
-      } else if (typeCurrent == kLens and typeNext == kLens) {
-        Double_t n1 =
-            ((ALens*)currentNode->GetVolume())->GetRefractiveIndex(lambda);
-        Double_t n2 =
-            ((ALens*)nextNode->GetVolume())->GetRefractiveIndex(lambda);
-        Double_t k2 =
-            ((ALens*)nextNode->GetVolume())->GetExtinctionCoefficient(lambda);
-        DoFresnel(n1, n2, k2, *ray, nav, currentNode, nextNode);
-      } else if (typeCurrent == kLens and
-                 (typeNext == kNull or typeNext == kOpt or
-                  typeNext == kOther)) {
-        Double_t n1 =
-            ((ALens*)currentNode->GetVolume())->GetRefractiveIndex(lambda);
-        Double_t n2 = 1;  // Assume refractive index equals 1 (= vacuum)
-        Double_t k2 = 0;  // No extinction (= vacuum)
-        DoFresnel(n1, n2, k2, *ray, nav, currentNode, nextNode);
+        t = x1[3] + step / speed;
       }
+      ray->AddStep(x2[0], x2[1], x2[2], t, nextNode, fRecording);
+    } else if ((typeCurrent == kNull or typeCurrent == kOpt or
+                typeCurrent == kOther) and
+               (typeNext == kOther or typeNext == kOpt)) {
+      const Double_t* x2 = nav->GetCurrentPoint();
+
+      Double_t speed = TMath::C() * m();
+      Double_t t = x1[3] + step / speed;
+      ray->AddStep(x2[0], x2[1], x2[2], t, nextNode, fRecording);
+    } else if (typeCurrent == kLens and typeNext == kLens) {
+      Double_t n1 = context.GetRefractiveIndex(lens1, lambda);
+      Double_t n2 = context.GetRefractiveIndex(lens2, lambda);
+      Double_t k2 = context.GetExtinctionCoefficient(lens2, lambda);
+      DoFresnel(n1, n2, k2, *ray, context, nextNode, condition);
+    } else if (typeCurrent == kLens and
+               (typeNext == kNull or typeNext == kOpt or
+                typeNext == kOther)) {
+      Double_t n1 = context.GetRefractiveIndex(lens1, lambda);
+      Double_t n2 = 1;  // Assume refractive index equals 1 (= vacuum)
+      Double_t k2 = 0;  // No extinction (= vacuum)
+      DoFresnel(n1, n2, k2, *ray, context, nextNode, condition);
+    }
 
-      if (typeNext == kNull) {
-        const Double_t* x2 = nav->GetCurrentPoint();
-        Double_t speed = TMath::C() * m();
-        Double_t t = x1[3] + step / speed;
-        ray->AddPoint(x2[0], x2[1], x2[2], t);
-        ray->AddNode(nextNode);
-        ray->Exit();
-      } else if (typeCurrent == kFocus or typeCurrent == kObs or
-                 typeCurrent == kMirror or typeNext == kObs) {
+    if (typeNext == kNull) {
+      const Double_t* x2 = nav->GetCurrentPoint();
+      Double_t speed = TMath::C() * m();
+      Double_t t = x1[3] + step / speed;
+      ray->AddStep(x2[0], x2[1], x2[2], t, nextNode, fRecording);
+      ray->Exit();
+    } else if (typeCurrent == kFocus or typeCurrent == kObs or
+               typeCurrent == kMirror or typeNext == kObs) {
+      ray->Stop();
+    } else if (typeNext == kFocus) {
+      ROBAST_STATS_COUNT_HANDLER(context, kFocalSurface);
+      AFocalSurface* focal = (AFocalSurface*)nextNode->GetVolume();
+      Double_t angle = 0.;
+      if (focal->HasQEAngle()) {
+        // normal vect perpendicular to the surface
+        TVector3 n = GetFacetNormal(context, condition);
+        Double_t d1[3];
+        ray->GetDirection(d1);
+        Double_t cos1 = d1[0] * n[0] + d1[1] * n[1] + d1[2] * n[2];
+        angle = TMath::ACos(cos1);
+      }
+      Double_t qe = focal->GetDetectionProbability(lambda, angle);
+      if (fWeightedTracing and qe > 0) {
+        ray->SetWeight(ray->GetWeight() * qe);
+        ray->Focus();
+      } else if (qe == 1 or context.GetRandom().Uniform(0, 1) < qe) {
+        ray->Focus();
+      } else {
         ray->Stop();
-      } else if (typeNext == kFocus) {
-        AFocalSurface* focal = (AFocalSurface*)nextNode->GetVolume();
-        Double_t angle = 0.;
-        if (focal->HasQEAngle()) {
-          TVector3 n = GetFacetNormal(
-              nav, currentNode,
-              nextNode);  // normal vect perpendicular to the surface
-          Double_t d1[3];
-          ray->GetDirection(d1);
-          Double_t cos1 = d1[0] * n[0] + d1[1] * n[1] + d1[2] * n[2];
-          angle = TMath::ACos(cos1);
-        }
-        Double_t qe = focal->GetQuantumEfficiency(lambda, angle);
-        if (qe == 1 or gRandom->Uniform(0, 1) < qe) {
-          ray->Focus();
-        } else {
-          ray->Stop();
-        }
       }
+    }
+    ROBAST_STATS_STOP_TIMER(context, kSurfacePhysics);
 
-      if (ray->IsRunning() and ray->GetNpoints() >= fLimit) {
-        ray->Suspend();
-      }
+    // fLimit includes the starting point as the number of track points does
+    if (ray->IsRunning() and ray->GetNsteps() + 1 >= fLimit) {
+      ray->Suspend();
     }
   }
+  ROBAST_STATS_END_RAY(context, *ray);
 }
 
 //_____________________________________________________________________________
@@ -527,68 +793,146 @@ void AOpticsManager::TraceNonSequential(ARayArray& array) {
   Int_t nthreads = GetMaxThreads();
 
   if (IsMultiThread() and nthreads >= 2) {
-    TThread** threads = new TThread*[nthreads];
-    ARayArray** dividedArray = new ARayArray*[nthreads];
-
-    for (Int_t i = 0; i < nthreads; i++) {
-      dividedArray[i] = new ARayArray();
-      for (Int_t j = ((n + 1) / nthreads) * i;
-           (i == (nthreads - 1)) ? j <= n : j < ((n + 1) / nthreads) * (i + 1);
-           j++) {
-        ARay* ray = (ARay*)running->RemoveAt(j);
-        dividedArray[i]->Add(ray);
-      }
+    std::vector<ARay*> rays;
+    rays.reserve(n + 1);
+    for (Int_t i = 0; i <= n; i++) {
+      ARay* ray = (ARay*)running->RemoveAt(i);
+      if (!ray) continue;
+      rays.push_back(ray);
     }
 
-    TObject*** args = new TObject**[nthreads];
-    for (Int_t i = 0; i < nthreads; i++) {
-      args[i] = new TObject*[2];
-      args[i][0] = this;
-      args[i][1] = dividedArray[i];
-      threads[i] = new TThread(Form("thread%d", i), AOpticsManager::Thread,
-                               (void*)args[i]);
-      threads[i]->Run();
-    }
+    // Rays are handed out to the threads in small chunks. A thread that has
+    // finished its own chunks steals the remaining ones from the others, so
+    // rays with long paths do not leave most of the threads idle. The random
+    // numbers of each ray depend only on its index, not on the thread.
+    PrepareTracing();
+    AThreadPool* pool = GetThreadPool(nthreads);
+    ULong64_t key = NextTraceKey();
+    pool->ParallelFor(
+        rays.size(), fChunkSize,
+        [this, &rays, key](std::size_t worker, std::size_t begin,
+                           std::size_t end) {
+          ATraceContext& context = GetWorkerContext(worker);
+          for (std::size_t i = begin; i < end; ++i) {
+            if (rays[i]->IsRunning()) {
+              context.StartRay(key, i);
+              TraceRay(rays[i], context);
+            }
+          }
+        });
 
-    for (Int_t i = 0; i < nthreads; i++) {
-      threads[i]->Join();
+    for (auto& context : fWorkerContexts) {
+      if (context) MergeTraceStatistics(*context);
     }
 
-    ClearThreadsMap();
-
-    for (Int_t i = 0; i < nthreads; i++) {
-      delete[] args[i];
-      array.Merge(dividedArray[i]);
-      SafeDelete(dividedArray[i]);
-      SafeDelete(threads[i]);
+    // ClearThreadsMap() must not be called here because the thread IDs are
+    // still used by the persistent threads
+    for (auto ray : rays) {
+      array.Add(ray);
     }
-
-    delete[] args;
-    delete[] threads;
-    delete[] dividedArray;
   } else {  // single thread
-    TObjArray* objarray = new TObjArray;
+    TObjArray objarray(n + 1);
     for (Int_t i = 0; i <= n; i++) {
       ARay* ray = (ARay*)running->RemoveAt(i);
       if (!ray) continue;
-      objarray->Add(ray);
+      objarray.Add(ray);
     }
-    TraceNonSequential(objarray);
-    n = objarray->GetLast();
+    TraceNonSequential(&objarray);
+    n = objarray.GetLast();
     for (Int_t i = 0; i <= n; i++) {
-      ARay* ray = (ARay*)objarray->RemoveAt(i);
+      ARay* ray = (ARay*)objarray.RemoveAt(i);
       if (!ray) continue;
       array.Add(ray);
     }
-    delete objarray;
   }
 
   running->Expand(0);  // shrink the array
 }
 
+//_____________________________________________________________________________
+void AOpticsManager::PrepareTracing() {
+  // Called at the beginning of each tracing call in the main thread. The
+  // volume table is rebuilt if volumes have been added after CloseGeometry
+  // (or if TGeoManager::CloseGeometry has been called directly), and the
+  // optical constants cached by the idle worker threads are discarded because
+  // the refractive indices may have been changed since the last call. The
+  // reflectance grids cleared by AMirror::SetReflectance are also rebuilt
+  // here, so that the worker threads never modify the mirrors.
+  //
+  // The threads, navigators and contexts themselves are kept across calls, so
+  // the fixed cost of a call with a few rays is small. Tracing calls must not
+  // be made concurrently on the same manager.
+  TObjArray* volumes = GetListOfVolumes();
+  Int_t nvolumes = volumes ? volumes->GetEntriesFast() : 0;
+  if ((Int_t)fVolumeTypes.size() != nvolumes) {
+    BuildVolumeTypes();
+  }
+  if ((Int_t)fHasBorderConditions.size() != nvolumes or
+      fBorderConditionVersion !=
+          AOpticalComponent::GetBorderSurfaceConditionVersion()) {
+    BuildBorderSurfaceConditions();
+  }
+  BuildReflectanceGrids();
+
+  for (auto& context : fWorkerContexts) {
+    if (context) context->ClearCache();
+  }
+  if (fCallerContext) {
+    fCallerContext->ClearCache();
+  }
+}
+
+//_____________________________________________________________________________
+void AOpticsManager::SetChunkSize(Int_t n) {
+  // Set the number of rays handed out to a thread at once in multi-thread
+  // mode. Smaller chunks balance the load better, while larger chunks reduce
+  // the scheduling overhead.
+  if (n > 0) {
+    fChunkSize = n;
+  }
+}
+
+//_____________________________________________________________________________
+void AOpticsManager::SetSeed(ULong64_t seed) {
+  // Set the seed of the random numbers used in ray tracing. Each ray has its
+  // own random number stream determined by the seed, the number of tracing
+  // calls since this call, and the index of the ray in the traced array. The
+  // results are therefore identical regardless of the number of threads. If
+  // seed is 0 (default), a new seed is drawn from gRandom in every tracing
+  // call.
+  fSeed = seed;
+  fNtraces = 0;
+}
+
+//_____________________________________________________________________________
+void AOpticsManager::SetRecording(ARay::ERecording recording) {
+  // Set how the track of each ray is recorded during tracing
+  //   ARay::kRecordAll       : all the points and nodes (default)
+  //   ARay::kRecordEndpoints : the first and last points only
+  //   ARay::kRecordLastPoint : the last point and the numbers of the hit
+  //                            volumes
+  // The last two policies keep the memory per ray constant regardless of the
+  // number of steps, while ARay::GetNodeHistory() returns an empty array.
+  fRecording = recording;
+}
+
 //_____________________________________________________________________________
 void AOpticsManager::SetLimit(Int_t n) {
   if (n > 0) {
     fLimit = n;
   }
 }
+
+//_____________________________________________________________________________
+void AOpticsManager::SetWeightedTracing(Bool_t weighted) {
+  // In the weighted tracing mode, losses multiply the weight of a photon
+  // (ARay::GetWeight) instead of killing it at random:
+  //   mirror reflectance, absorption in lenses, absorption in multilayers on
+  //   lens surfaces, and the QE of focal surfaces
+  // Only the branching between Fresnel reflection and transmission is still
+  // sampled. Every photon then contributes to the result, and the sum of the
+  // weights of the focused photons converges with far fewer photons when the
+  // losses are large. A photon is absorbed or stopped only where the
+  // probability of survival is zero.
+  fWeightedTracing = weighted;
+}
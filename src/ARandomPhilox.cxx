@@ -0,0 +1,134 @@
+/******************************************************************************
+ * Copyright (C) 2006-, Akira Okumura                                         *
+ * All rights reserved.                                                       *
+ *****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// ARandomPhilox
+//
+// Counter-based random number generator Philox4x32-10 described in
+// J. K. Salmon et al., "Parallel random numbers: as easy as 1, 2, 3",
+// Proceedings of SC'11 (2011).
+//
+// The n-th block of random numbers is a pure function of the key and the
+// counter n. The generator can therefore be moved to an independent stream
+// just by setting a new key and stream number (SetStream), without any shared
+// state or lock. AOpticsManager uses one instance per tracing thread and
+// assigns a stream to each ray, so that the traced results do not depend on
+// the number of threads.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ARandomPhilox.h"
+
+ClassImp(ARandomPhilox);
+
+namespace {
+
+const UInt_t kPhiloxM0 = 0xD2511F53;
+const UInt_t kPhiloxM1 = 0xCD9E8D57;
+const UInt_t kPhiloxW0 = 0x9E3779B9;
+const UInt_t kPhiloxW1 = 0xBB67AE85;
+
+inline void MulHiLo(UInt_t a, UInt_t b, UInt_t& hi, UInt_t& lo) {
+  ULong64_t p = (ULong64_t)a * b;
+  hi = (UInt_t)(p >> 32);
+  lo = (UInt_t)p;
+}
+
+}  // namespace
+
+//_____________________________________________________________________________
+ARandomPhilox::ARandomPhilox(ULong64_t seed) : TRandom() {
+  SetName("Random_Philox");
+  SetTitle("Random number generator: Philox4x32-10");
+  SetStream(seed, 0);
+}
+
+//_____________________________________________________________________________
+ARandomPhilox::~ARandomPhilox() {}
+
+//_____________________________________________________________________________
+void ARandomPhilox::Generate() {
+  // Encrypt the current counter with 10 rounds and increment the counter
+  UInt_t c0 = fCounter[0];
+  UInt_t c1 = fCounter[1];
+  UInt_t c2 = fCounter[2];
+  UInt_t c3 = fCounter[3];
+  UInt_t k0 = fKey[0];
+  UInt_t k1 = fKey[1];
+
+  for (Int_t i = 0; i < 10; ++i) {
+    UInt_t hi0, lo0, hi1, lo1;
+    MulHiLo(kPhiloxM0, c0, hi0, lo0);
+    MulHiLo(kPhiloxM1, c2, hi1, lo1);
+    c0 = hi1 ^ c1 ^ k0;
+    c1 = lo1;
+    c2 = hi0 ^ c3 ^ k1;
+    c3 = lo0;
+    k0 += kPhiloxW0;
+    k1 += kPhiloxW1;
+  }
+
+  fBuffer[0] = c0;
+  fBuffer[1] = c1;
+  fBuffer[2] = c2;
+  fBuffer[3] = c3;
+  fIndex = 0;
+
+  // 64-bit block counter in the first two words
+  if (++fCounter[0] == 0) {
+    ++fCounter[1];
+  }
+}
+
+//_____________________________________________________________________________
+Double_t ARandomPhilox::Rndm() {
+  // Return a uniform random number in (0, 1) with 53-bit resolution made of
+  // two 32-bit words
+  if (fIndex > 2) {
+    Generate();
+  }
+  ULong64_t a = fBuffer[fIndex] >> 5;      // 27 bits
+  ULong64_t b = fBuffer[fIndex + 1] >> 6;  // 26 bits
+  fIndex += 2;
+
+  // 0 is never returned as in the other TRandom generators
+  return ((a << 26) + b + 0.5) * (1. / 9007199254740992.);  // 2^-53
+}
+
+//_____________________________________________________________________________
+void ARandomPhilox::RndmArray(Int_t n, Float_t* array) {
+  for (Int_t i = 0; i < n; ++i) {
+    array[i] = (Float_t)Rndm();
+  }
+}
+
+//_____________________________________________________________________________
+void ARandomPhilox::RndmArray(Int_t n, Double_t* array) {
+  for (Int_t i = 0; i < n; ++i) {
+    array[i] = Rndm();
+  }
+}
+
+//_____________________________________________________________________________
+void ARandomPhilox::SetSeed(ULong_t seed) {
+  // Use the seed as the key and rewind to the beginning of stream 0. If seed
+  // is 0, a unique key is generated by TRandom::SetSeed.
+  TRandom::SetSeed(seed);
+  SetStream(seed ? seed : GetSeed(), 0);
+}
+
+//_____________________________________________________________________________
+void ARandomPhilox::SetStream(ULong64_t key, ULong64_t stream) {
+  // Select an independent stream of random numbers and rewind it. Different
+  // (key, stream) pairs give statistically independent sequences.
+  fKey[0] = (UInt_t)key;
+  fKey[1] = (UInt_t)(key >> 32);
+  fCounter[0] = 0;
+  fCounter[1] = 0;
+  fCounter[2] = (UInt_t)stream;
+  fCounter[3] = (UInt_t)(stream >> 32);
+  fIndex = 4;
+}
@@ -22,6 +22,8 @@ ARay::ARay() {
   fLambda = 0;
   fDirection = TVector3(1, 0, 0);
   fStatus = kRun;
+  fNsteps = 0;
+  fWeight = 1;
 }
 
 //_____________________________________________________________________________
@@ -33,11 +35,40 @@ ARay::ARay(Int_t id, Double_t lambda, Double_t x, Double_t y, Double_t z,
   fLambda = lambda;
   SetDirection(nx, ny, nz);
   fStatus = kRun;
+  fNsteps = 0;
+  fWeight = 1;
 }
 
 //_____________________________________________________________________________
 ARay::~ARay() {}
 
+//_____________________________________________________________________________
+void ARay::AddStep(Double_t x, Double_t y, Double_t z, Double_t t,
+                   TGeoNode* node, Int_t recording) {
+  // Record a boundary crossing at (x, y, z, t) on "node" according to the
+  // recording policy (see AOpticsManager::SetRecording)
+  //   kRecordAll       : all the points and nodes (default)
+  //   kRecordEndpoints : the first and last points only
+  //   kRecordLastPoint : the last point and the numbers of the hit volumes
+  // The memory used by a ray does not grow with the number of steps except
+  // for the volume numbers in kRecordLastPoint.
+  ++fNsteps;
+
+  if (recording == kRecordEndpoints) {
+    if (GetNpoints() < 2) {
+      AddPoint(x, y, z, t);
+    } else {
+      SetLastPoint(x, y, z, t);
+    }
+  } else if (recording == kRecordLastPoint) {
+    SetLastPoint(x, y, z, t);
+    fVolumeHistory.push_back(node ? node->GetVolume()->GetNumber() : -1);
+  } else {
+    AddPoint(x, y, z, t);
+    AddNode(node);
+  }
+}
+
 //_____________________________________________________________________________
 TGeoNode* ARay::FindNodeStartWith(const char* name) const {
   for (Int_t i = 0; i < fNodeHisotry.GetEntries(); i++) {
@@ -206,6 +237,40 @@ TPolyLine3D* ARay::MakePolyLine3D() const {
   return pol;
 }
 
+//_____________________________________________________________________________
+void ARay::Reset(Double_t lambda, Double_t x, Double_t y, Double_t z,
+                 Double_t t, Double_t dx, Double_t dy, Double_t dz) {
+  // Reinitialize the ray with a new start point and direction so that one ARay
+  // object can be reused to trace many photons
+  // TGeoTrack::ResetTrack() would delete the buffer of the points
+  fNpoints = 0;
+  fNodeHisotry.Clear();  // keeps the capacity of the array
+  AddPoint(x, y, z, t);
+  fLambda = lambda;
+  SetDirection(dx, dy, dz);
+  fStatus = kRun;
+  fNsteps = 0;
+  fVolumeHistory.clear();
+  fWeight = 1;
+}
+
+//_____________________________________________________________________________
+void ARay::SetLastPoint(Double_t x, Double_t y, Double_t z, Double_t t) {
+  // Overwrite the last point instead of adding a new one
+  Int_t n = GetNpoints();
+  if (n == 0) {
+    AddPoint(x, y, z, t);
+    return;
+  }
+
+  // TGeoTrack has no setter of an existing point. Each point is stored as
+  // (x, y, z, t) in fPoints.
+  fPoints[4 * (n - 1)] = x;
+  fPoints[4 * (n - 1) + 1] = y;
+  fPoints[4 * (n - 1) + 2] = z;
+  fPoints[4 * (n - 1) + 3] = t;
+}
+
 //_____________________________________________________________________________
 void ARay::SetDirection(Double_t* d) {
   Double_t mag = TMath::Sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
@@ -0,0 +1,133 @@
+/******************************************************************************
+ * Copyright (C) 2006-, Akira Okumura                                         *
+ * All rights reserved.                                                       *
+ *****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// ARayBatch
+//
+// Batch of photons stored as a structure of arrays. Unlike ARayArray, no
+// object is allocated per photon and only the current state (last point,
+// direction, wavelength, weight and status) of each photon is kept in
+// contiguous arrays. A batch can be filled by ARayShooter, traced by
+// AOpticsManager::TraceNonSequential(ARayBatch&), and converted into an
+// ARayArray with MakeRayArray() only when ARay objects are needed.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TMath.h"
+
+#include "ARayBatch.h"
+
+ClassImp(ARayBatch);
+
+//_____________________________________________________________________________
+ARayBatch::ARayBatch() : TObject() {
+  // Default constructor
+}
+
+//_____________________________________________________________________________
+ARayBatch::~ARayBatch() {}
+
+//_____________________________________________________________________________
+std::size_t ARayBatch::Add(Double_t lambda, Double_t x, Double_t y, Double_t z,
+                           Double_t t, Double_t dx, Double_t dy, Double_t dz,
+                           Double_t weight) {
+  // Add a running photon and return its index in the batch. The direction is
+  // normalized in the same way as ARay::SetDirection.
+  Double_t mag = TMath::Sqrt(dx * dx + dy * dy + dz * dz);
+  if (mag > 0) {
+    dx /= mag;
+    dy /= mag;
+    dz /= mag;
+  } else {
+    dx = 1;
+    dy = 0;
+    dz = 0;
+  }
+
+  fX.push_back(x);
+  fY.push_back(y);
+  fZ.push_back(z);
+  fT.push_back(t);
+  fDx.push_back(dx);
+  fDy.push_back(dy);
+  fDz.push_back(dz);
+  fLambda.push_back(lambda);
+  fWeight.push_back(weight);
+  fStatus.push_back(ARay::kRun);
+
+  return fStatus.size() - 1;
+}
+
+//_____________________________________________________________________________
+void ARayBatch::Add(const ARay& ray, Double_t weight) {
+  // Add the current state of an existing ray. Its track and node history are
+  // not copied. The weight of the photon is that of the ray times "weight".
+  Double_t x[4], d[3];
+  ray.GetLastPoint(x);
+  ray.GetDirection(d);
+  std::size_t i =
+      Add(ray.GetLambda(), x[0], x[1], x[2], x[3], d[0], d[1], d[2],
+          ray.GetWeight() * weight);
+  fStatus[i] = ray.GetStatus();
+}
+
+//_____________________________________________________________________________
+void ARayBatch::Clear(Option_t*) {
+  // Remove all the photons but keep the allocated memory for reuse
+  fX.clear();
+  fY.clear();
+  fZ.clear();
+  fT.clear();
+  fDx.clear();
+  fDy.clear();
+  fDz.clear();
+  fLambda.clear();
+  fWeight.clear();
+  fStatus.clear();
+}
+
+//_____________________________________________________________________________
+std::size_t ARayBatch::Count(Int_t status) const {
+  // Return the number of photons in the given status (e.g. ARay::kFocus)
+  std::size_t n = 0;
+  for (auto s : fStatus) {
+    if (s == status) ++n;
+  }
+
+  return n;
+}
+
+//_____________________________________________________________________________
+ARayArray* ARayBatch::MakeRayArray() const {
+  // Create ARay objects of all the photons. Each ray has only one point (the
+  // last point in the batch) and an empty node history.
+  ARayArray* array = new ARayArray;
+
+  std::size_t n = GetN();
+  for (std::size_t i = 0; i < n; ++i) {
+    ARay* ray = new ARay(0, fLambda[i], fX[i], fY[i], fZ[i], fT[i], fDx[i],
+                         fDy[i], fDz[i]);
+    ray->SetStatus(fStatus[i]);
+    ray->SetWeight(fWeight[i]);
+    array->Add(ray);
+  }
+
+  return array;
+}
+
+//_____________________________________________________________________________
+void ARayBatch::Reserve(std::size_t n) {
+  fX.reserve(n);
+  fY.reserve(n);
+  fZ.reserve(n);
+  fT.reserve(n);
+  fDx.reserve(n);
+  fDy.reserve(n);
+  fDz.reserve(n);
+  fLambda.reserve(n);
+  fWeight.reserve(n);
+  fStatus.reserve(n);
+}
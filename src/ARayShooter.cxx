@@ -119,14 +119,12 @@ ARayShooter::ARayShooter() {
 ARayShooter::~ARayShooter() {}
 
 //_____________________________________________________________________________
-ARayArray* ARayShooter::Circle(Double_t lambda, Double_t rmax, Int_t nr,
-                               Int_t nphi, TGeoRotation* rot,
-                               TGeoTranslation* tr, TVector3* v) {
+void ARayShooter::Circle(ARayBatch& batch, Double_t lambda, Double_t rmax,
+                         Int_t nr, Int_t nphi, TGeoRotation* rot,
+                         TGeoTranslation* tr, TVector3* v) {
   // Create initial photons aligned in concentric circles
-  ARayArray* array = new ARayArray;
-
   if (0 > rmax or nr < 1 or nphi < 1) {
-    return array;
+    return;
   }
 
   Double_t position[3] = {0, 0, 0};
@@ -152,8 +150,8 @@ ARayArray* ARayShooter::Circle(Double_t lambda, Double_t rmax, Int_t nr,
   }
 
   // a photon at the center
-  array->Add(new ARay(0, lambda, new_pos[0], new_pos[1], new_pos[2], 0,
-                      new_dir[0], new_dir[1], new_dir[2]));
+  batch.Add(lambda, new_pos[0], new_pos[1], new_pos[2], 0, new_dir[0],
+            new_dir[1], new_dir[2]);
 
   for (Int_t i = 0; i < nr; i++) {
     Double_t r = rmax * (i + 1) / nr;
@@ -173,23 +171,18 @@ ARayArray* ARayShooter::Circle(Double_t lambda, Double_t rmax, Int_t nr,
         memcpy(x, new_pos, 3 * sizeof(Double_t));
       }
 
-      ARay* ray = new ARay(0, lambda, x[0], x[1], x[2], 0, new_dir[0],
-                           new_dir[1], new_dir[2]);
-      array->Add(ray);
+      batch.Add(lambda, x[0], x[1], x[2], 0, new_dir[0], new_dir[1],
+                new_dir[2]);
     }
   }
-
-  return array;
 }
 
 //_____________________________________________________________________________
-ARayArray* ARayShooter::RandomCircle(Double_t lambda, Double_t rmax, Int_t n,
-                                     TGeoRotation* rot, TGeoTranslation* tr,
-                                     TVector3* v) {
-  ARayArray* array = new ARayArray;
-
+void ARayShooter::RandomCircle(ARayBatch& batch, Double_t lambda, Double_t rmax,
+                               Int_t n, TGeoRotation* rot, TGeoTranslation* tr,
+                               TVector3* v) {
   if (0 > rmax) {
-    return array;
+    return;
   }
 
   Double_t new_pos[3];
@@ -228,23 +221,17 @@ ARayArray* ARayShooter::RandomCircle(Double_t lambda, Double_t rmax, Int_t n,
       memcpy(x, new_pos, 3 * sizeof(Double_t));
     }
 
-    ARay* ray = new ARay(0, lambda, x[0], x[1], x[2], 0, new_dir[0], new_dir[1],
-                         new_dir[2]);
-    array->Add(ray);
+    batch.Add(lambda, x[0], x[1], x[2], 0, new_dir[0], new_dir[1], new_dir[2]);
   }
-
-  return array;
 }
 
 //_____________________________________________________________________________
-ARayArray* ARayShooter::RandomCone(Double_t lambda, Double_t r, Double_t d,
-                                   Int_t n, TGeoRotation* rot,
-                                   TGeoTranslation* tr) {
+void ARayShooter::RandomCone(ARayBatch& batch, Double_t lambda, Double_t r,
+                             Double_t d, Int_t n, TGeoRotation* rot,
+                             TGeoTranslation* tr) {
   // Create initial photons aligned in a cone. Direction is random
   // Start position is at the origin.
   // Arrival position is inside the circle of radius r at z = d
-  ARayArray* array = new ARayArray;
-
   for (Int_t i = 0; i < n; i++) {
     // random (x, y) inside a circle
     Double_t x = gRandom->Uniform(-r, r);
@@ -276,23 +263,19 @@ ARayArray* ARayShooter::RandomCone(Double_t lambda, Double_t r, Double_t d,
     TVector3 goal(goal_pos);
     TVector3 dir = goal - start;
 
-    ARay* ray = new ARay(0, lambda, start.X(), start.Y(), start.Z(), 0, dir.X(),
-                         dir.Y(), dir.Z());
-    array->Add(ray);
+    batch.Add(lambda, start.X(), start.Y(), start.Z(), 0, dir.X(), dir.Y(),
+              dir.Z());
   }
-
-  return array;
 }
 
 //_____________________________________________________________________________
-ARayArray* ARayShooter::RandomRectangle(Double_t lambda, Double_t dx,
-                                        Double_t dy, Int_t n, TGeoRotation* rot,
-                                        TGeoTranslation* tr, TVector3* v) {
+void ARayShooter::RandomRectangle(ARayBatch& batch, Double_t lambda,
+                                  Double_t dx, Double_t dy, Int_t n,
+                                  TGeoRotation* rot, TGeoTranslation* tr,
+                                  TVector3* v) {
   // Create initial photons randomly distributed in a rectangle
-  ARayArray* array = new ARayArray;
-
   if (dx < 0 or dy < 0 or n < 1) {
-    return array;
+    return;
   }
 
   Double_t dir[3] = {0, 0, 1};
@@ -326,18 +309,13 @@ ARayArray* ARayShooter::RandomRectangle(Double_t lambda, Double_t dx,
       memcpy(x, new_pos, 3 * sizeof(Double_t));
     }
 
-    ARay* ray = new ARay(0, lambda, x[0], x[1], x[2], 0, new_dir[0], new_dir[1],
-                         new_dir[2]);
-    array->Add(ray);
+    batch.Add(lambda, x[0], x[1], x[2], 0, new_dir[0], new_dir[1], new_dir[2]);
   }
-
-  return array;
 }
 
 //_____________________________________________________________________________
-ARayArray* ARayShooter::RandomSphere(Double_t lambda, Int_t n,
-                                     TGeoTranslation* tr) {
-  ARayArray* array = new ARayArray;
+void ARayShooter::RandomSphere(ARayBatch& batch, Double_t lambda, Int_t n,
+                               TGeoTranslation* tr) {
   for (Int_t i = 0; i < n; i++) {
     Double_t dir[3];
     gRandom->Sphere(dir[0], dir[1], dir[2], 1);
@@ -347,19 +325,15 @@ ARayArray* ARayShooter::RandomSphere(Double_t lambda, Int_t n,
     if (tr) {
       tr->LocalToMaster(p, new_pos);
     }
-    ARay* ray = new ARay(0, lambda, new_pos[0], new_pos[1], new_pos[2], 0,
-                         dir[0], dir[1], dir[2]);
-    array->Add(ray);
+    batch.Add(lambda, new_pos[0], new_pos[1], new_pos[2], 0, dir[0], dir[1],
+              dir[2]);
   }
-
-  return array;
 }
 
 //_____________________________________________________________________________
-ARayArray* ARayShooter::RandomSphericalCone(Double_t lambda, Int_t n,
-                                            Double_t theta, TGeoRotation* rot,
-                                            TGeoTranslation* tr) {
-  ARayArray* array = new ARayArray;
+void ARayShooter::RandomSphericalCone(ARayBatch& batch, Double_t lambda,
+                                      Int_t n, Double_t theta,
+                                      TGeoRotation* rot, TGeoTranslation* tr) {
   for (Int_t i = 0; i < n; i++) {
     Double_t dir[3];
     Double_t ran = gRandom->Uniform(TMath::Cos(theta * TMath::DegToRad()), 1);
@@ -382,30 +356,25 @@ ARayArray* ARayShooter::RandomSphericalCone(Double_t lambda, Int_t n,
       tr->LocalToMaster(p, new_pos);
     }
 
-    ARay* ray = new ARay(0, lambda, new_pos[0], new_pos[1], new_pos[2], 0,
-                         new_dir[0], new_dir[1], new_dir[2]);
-    array->Add(ray);
+    batch.Add(lambda, new_pos[0], new_pos[1], new_pos[2], 0, new_dir[0],
+              new_dir[1], new_dir[2]);
   }
-
-  return array;
 }
 
 //_____________________________________________________________________________
-ARayArray* ARayShooter::RandomSquare(Double_t lambda, Double_t d, Int_t n,
-                                     TGeoRotation* rot, TGeoTranslation* tr,
-                                     TVector3* v) {
-  return RandomRectangle(lambda, d, d, n, rot, tr, v);
+void ARayShooter::RandomSquare(ARayBatch& batch, Double_t lambda, Double_t d,
+                               Int_t n, TGeoRotation* rot, TGeoTranslation* tr,
+                               TVector3* v) {
+  RandomRectangle(batch, lambda, d, d, n, rot, tr, v);
 }
 
 //_____________________________________________________________________________
-ARayArray* ARayShooter::Rectangle(Double_t lambda, Double_t dx, Double_t dy,
-                                  Int_t nx, Int_t ny, TGeoRotation* rot,
-                                  TGeoTranslation* tr, TVector3* v) {
+void ARayShooter::Rectangle(ARayBatch& batch, Double_t lambda, Double_t dx,
+                            Double_t dy, Int_t nx, Int_t ny, TGeoRotation* rot,
+                            TGeoTranslation* tr, TVector3* v) {
   // Create initial photons aligned in rectangles
-  ARayArray* array = new ARayArray;
-
   if (dx < 0 or dy < 0 or nx < 1 or ny < 1) {
-    return array;
+    return;
   }
 
   Double_t dir[3] = {0, 0, 1};
@@ -442,19 +411,95 @@ ARayArray* ARayShooter::Rectangle(Double_t lambda, Double_t dx, Double_t dy,
         memcpy(x, new_pos, 3 * sizeof(Double_t));
       }
 
-      ARay* ray = new ARay(0, lambda, x[0], x[1], x[2], 0, new_dir[0],
-                           new_dir[1], new_dir[2]);
-      array->Add(ray);
+      batch.Add(lambda, x[0], x[1], x[2], 0, new_dir[0], new_dir[1],
+                new_dir[2]);
     }
   }
+}
 
-  return array;
+//_____________________________________________________________________________
+void ARayShooter::Square(ARayBatch& batch, Double_t lambda, Double_t d, Int_t n,
+                         TGeoRotation* rot, TGeoTranslation* tr, TVector3* v) {
+  // Create initial photons aligned in squares
+  Rectangle(batch, lambda, d, d, n, n, rot, tr, v);
+}
+
+//_____________________________________________________________________________
+ARayArray* ARayShooter::Circle(Double_t lambda, Double_t rmax, Int_t nr,
+                               Int_t nphi, TGeoRotation* rot,
+                               TGeoTranslation* tr, TVector3* v) {
+  ARayBatch batch;
+  Circle(batch, lambda, rmax, nr, nphi, rot, tr, v);
+  return batch.MakeRayArray();
+}
+
+//_____________________________________________________________________________
+ARayArray* ARayShooter::RandomCircle(Double_t lambda, Double_t rmax, Int_t n,
+                                     TGeoRotation* rot, TGeoTranslation* tr,
+                                     TVector3* v) {
+  ARayBatch batch;
+  RandomCircle(batch, lambda, rmax, n, rot, tr, v);
+  return batch.MakeRayArray();
+}
+
+//_____________________________________________________________________________
+ARayArray* ARayShooter::RandomCone(Double_t lambda, Double_t r, Double_t d,
+                                   Int_t n, TGeoRotation* rot,
+                                   TGeoTranslation* tr) {
+  ARayBatch batch;
+  RandomCone(batch, lambda, r, d, n, rot, tr);
+  return batch.MakeRayArray();
+}
+
+//_____________________________________________________________________________
+ARayArray* ARayShooter::RandomRectangle(Double_t lambda, Double_t dx,
+                                        Double_t dy, Int_t n, TGeoRotation* rot,
+                                        TGeoTranslation* tr, TVector3* v) {
+  ARayBatch batch;
+  RandomRectangle(batch, lambda, dx, dy, n, rot, tr, v);
+  return batch.MakeRayArray();
+}
+
+//_____________________________________________________________________________
+ARayArray* ARayShooter::RandomSphere(Double_t lambda, Int_t n,
+                                     TGeoTranslation* tr) {
+  ARayBatch batch;
+  RandomSphere(batch, lambda, n, tr);
+  return batch.MakeRayArray();
+}
+
+//_____________________________________________________________________________
+ARayArray* ARayShooter::RandomSphericalCone(Double_t lambda, Int_t n,
+                                            Double_t theta, TGeoRotation* rot,
+                                            TGeoTranslation* tr) {
+  ARayBatch batch;
+  RandomSphericalCone(batch, lambda, n, theta, rot, tr);
+  return batch.MakeRayArray();
+}
+
+//_____________________________________________________________________________
+ARayArray* ARayShooter::RandomSquare(Double_t lambda, Double_t d, Int_t n,
+                                     TGeoRotation* rot, TGeoTranslation* tr,
+                                     TVector3* v) {
+  ARayBatch batch;
+  RandomSquare(batch, lambda, d, n, rot, tr, v);
+  return batch.MakeRayArray();
+}
+
+//_____________________________________________________________________________
+ARayArray* ARayShooter::Rectangle(Double_t lambda, Double_t dx, Double_t dy,
+                                  Int_t nx, Int_t ny, TGeoRotation* rot,
+                                  TGeoTranslation* tr, TVector3* v) {
+  ARayBatch batch;
+  Rectangle(batch, lambda, dx, dy, nx, ny, rot, tr, v);
+  return batch.MakeRayArray();
 }
 
 //_____________________________________________________________________________
 ARayArray* ARayShooter::Square(Double_t lambda, Double_t d, Int_t n,
                                TGeoRotation* rot, TGeoTranslation* tr,
                                TVector3* v) {
-  // Create initial photons aligned in squares
-  return Rectangle(lambda, d, d, n, n, rot, tr, v);
+  ARayBatch batch;
+  Square(batch, lambda, d, n, rot, tr, v);
+  return batch.MakeRayArray();
 }
@@ -9,6 +9,11 @@
 //
 // Abstract class for refractive index
 //
+// Any refractive index, including formulae, mixtures and tabulated data, can
+// be frozen into uniform-grid tables with Freeze(lambda_min, lambda_max, n).
+// A frozen index is evaluated by linear interpolation in O(1) within the
+// range, and by the original calculation outside the range.
+//
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "ARefractiveIndex.h"
@@ -16,7 +21,8 @@
 
 ClassImp(ARefractiveIndex);
 
-ARefractiveIndex::ARefractiveIndex(Double_t n, Double_t k) {
+ARefractiveIndex::ARefractiveIndex(Double_t n, Double_t k)
+    : fFrozenLambdaMin(0), fFrozenLambdaMax(0), fFrozenInvStep(0) {
   fRefractiveIndex = std::make_shared<TGraph>();
   fRefractiveIndex->SetPoint(0, 0, n);
 
@@ -36,3 +42,97 @@ Double_t ARefractiveIndex::GetAbbeNumber() const {
 
   return (nD - 1.) / (nF - nC);
 }
+
+//______________________________________________________________________________
+void ARefractiveIndex::Freeze(Double_t lambda_min, Double_t lambda_max,
+                              Int_t n) {
+  // Tabulate the refractive index and the extinction coefficient at n points
+  // equally spaced in [lambda_min, lambda_max]. The interpolation error is
+  // proportional to the square of the step. The tables must be rebuilt by
+  // calling Freeze again if the parameters of the index have been changed.
+  if (n < 2 or not(lambda_min < lambda_max)) {
+    Error("Freeze", "Invalid range (%g, %g) or number of points (%d)",
+          lambda_min, lambda_max, n);
+    return;
+  }
+
+  Unfreeze();  // evaluate the original calculation below
+
+  std::vector<Double_t> index(n), extinct(n);
+  Double_t step = (lambda_max - lambda_min) / (n - 1);
+  for (Int_t i = 0; i < n; i++) {
+    Double_t lambda = i == n - 1 ? lambda_max : lambda_min + i * step;
+    index[i] = GetRefractiveIndex(lambda);
+    extinct[i] = GetExtinctionCoefficient(lambda);
+  }
+
+  fFrozenLambdaMin = lambda_min;
+  fFrozenLambdaMax = lambda_max;
+  fFrozenInvStep = 1. / step;
+  fFrozenIndex.swap(index);
+  fFrozenExtinct.swap(extinct);
+}
+
+//______________________________________________________________________________
+void ARefractiveIndex::GetComplexRefractiveIndices(
+    Int_t n, const Double_t* lambda, std::complex<Double_t>* index) const {
+  // Evaluate the complex refractive indices at n wavelengths at once
+  if (IsFrozen()) {
+    for (Int_t i = 0; i < n; i++) {
+      if (IsInFrozenRange(lambda[i])) {
+        index[i] = std::complex<Double_t>(
+            InterpolateFrozen(fFrozenIndex, lambda[i]),
+            InterpolateFrozen(fFrozenExtinct, lambda[i]));
+      } else {
+        index[i] = GetComplexRefractiveIndex(lambda[i]);
+      }
+    }
+  } else {
+    for (Int_t i = 0; i < n; i++) {
+      index[i] = GetComplexRefractiveIndex(lambda[i]);
+    }
+  }
+}
+
+//______________________________________________________________________________
+void ARefractiveIndex::GetExtinctionCoefficients(Int_t n,
+                                                 const Double_t* lambda,
+                                                 Double_t* k) const {
+  // Evaluate the extinction coefficients at n wavelengths at once
+  if (IsFrozen()) {
+    for (Int_t i = 0; i < n; i++) {
+      k[i] = IsInFrozenRange(lambda[i])
+                 ? InterpolateFrozen(fFrozenExtinct, lambda[i])
+                 : GetExtinctionCoefficient(lambda[i]);
+    }
+  } else {
+    for (Int_t i = 0; i < n; i++) {
+      k[i] = GetExtinctionCoefficient(lambda[i]);
+    }
+  }
+}
+
+//______________________________________________________________________________
+void ARefractiveIndex::GetRefractiveIndices(Int_t n, const Double_t* lambda,
+                                            Double_t* index) const {
+  // Evaluate the refractive indices at n wavelengths at once. When the index
+  // is frozen, no virtual function is called for wavelengths in the range.
+  if (IsFrozen()) {
+    for (Int_t i = 0; i < n; i++) {
+      index[i] = IsInFrozenRange(lambda[i])
+                     ? InterpolateFrozen(fFrozenIndex, lambda[i])
+                     : GetRefractiveIndex(lambda[i]);
+    }
+  } else {
+    for (Int_t i = 0; i < n; i++) {
+      index[i] = GetRefractiveIndex(lambda[i]);
+    }
+  }
+}
+
+//______________________________________________________________________________
+void ARefractiveIndex::Unfreeze() {
+  // Discard the tables made by Freeze
+  fFrozenIndex.clear();
+  fFrozenExtinct.clear();
+}
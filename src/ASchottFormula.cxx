@@ -46,6 +46,7 @@ Double_t ASchottFormula::GetRefractiveIndex(Double_t lambda) const {
   //
   // n(lambda)^2 = A0 + A1*lamda^2 + A2*lamda^-2 + A3*lamda^-4 + A4*lamda^-6 +
   // A5*lamda^-8 where lambda is measured in (um)
+  if (IsInFrozenRange(lambda)) return GetFrozenRefractiveIndex(lambda);
   lambda /= AOpticsManager::um();  // Convert (nm) to (um)
   return TMath::Sqrt(fPar[0] + fPar[1] * TMath::Power(lambda, 2.) +
                      fPar[2] * TMath::Power(lambda, -2.) +
@@ -46,6 +46,7 @@ ASellmeierFormula::ASellmeierFormula(const Double_t* p) {
 Double_t ASellmeierFormula::GetRefractiveIndex(Double_t lambda) const {
   // Calculate the refractive index at wavelength = lambda (m)
   // Use AOpticsManager::m() to get the unit length in (m)
+  if (IsInFrozenRange(lambda)) return GetFrozenRefractiveIndex(lambda);
   lambda /= AOpticsManager::um();  // Convert (nm) to (um)
   Double_t lambda2 = lambda * lambda;
   return TMath::Sqrt(1 + fPar[0] * lambda2 / (lambda2 - fPar[3]) +
@@ -87,6 +88,7 @@ TF1* ASellmeierFormula::FitData(TGraph* graph, const char* tf1name,
   f->SetParameter(5, 1e2);
 
   graph->Fit(f, option);
+  Unfreeze();  // the parameters are changed below
   for (Int_t i = 0; i < (Int_t)(sizeof(fPar) / sizeof(Double_t)); i++) {
     fPar[i] = f->GetParameter(i);
   }
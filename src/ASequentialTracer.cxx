@@ -0,0 +1,377 @@
+/******************************************************************************
+ * Copyright (C) 2006-, Akira Okumura                                         *
+ * All rights reserved.                                                       *
+ *****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// ASequentialTracer
+//
+// Sequential ray tracer for optical systems whose surfaces are hit in a known
+// order, e.g., a Davies-Cotton telescope (mirror facets, then the focal
+// plane) or a Schwarzschild-Couder telescope (primary, secondary, then the
+// focal plane).
+//
+// The system is described as a list of stages. Each stage has one or more
+// surfaces (nodes of mirrors, lenses, obscurations or focal surfaces given by
+// their paths, e.g., "/world_1/mirror_12"), and a photon hits the nearest
+// surface of every stage in turn. The intersection is calculated directly by
+// TGeoShape::DistFromOutside of the candidate surfaces, so no navigation
+// through the volume tree is done. Components that are not registered in any
+// stage (e.g., masts) are invisible to the sequential path, so they must be
+// added to a stage if their shadows matter.
+//
+// A photon is handed over to AOpticsManager::TraceNonSequential at its current
+// position when
+//   - it misses all the surfaces of a stage,
+//   - it is reflected at a lens surface (Fresnel reflection or total
+//     internal reflection), i.e., it becomes stray light,
+//   - it is still running after the last stage.
+// The results are therefore the same as those of non-sequential tracing as
+// long as the stages cover all the components the photons can hit.
+//
+// A lens surface is treated as one stage, in which the photon enters and
+// exits the lens. Lenses and mirrors must be placed in vacuum (n = 1), and
+// only multilayer conditions of mirrors are supported as border surface
+// conditions. The track of each photon is not recorded; only ARayBatch can be
+// traced.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <limits>
+
+#include "TGeoShape.h"
+
+#include "AMultilayer.h"
+#include "ASequentialTracer.h"
+#include "AThreadPool.h"
+
+// Photons are moved off a surface by this distance after an interaction so
+// that the navigator can tell on which side they are
+static const Double_t kEpsilon = 1e-6;  // Same as in AOpticsManager.cxx
+static const Double_t kInf = std::numeric_limits<Double_t>::infinity();
+
+ClassImp(ASequentialTracer);
+
+//_____________________________________________________________________________
+ASequentialTracer::ASequentialTracer(AOpticsManager* manager)
+    : fManager(manager), fNfallback(0) {}
+
+//_____________________________________________________________________________
+ASequentialTracer::~ASequentialTracer() {}
+
+//_____________________________________________________________________________
+void ASequentialTracer::AddStage() {
+  // Start a new stage. The following AddSurface calls add surfaces to it.
+  fStages.push_back(std::vector<ASurface>());
+}
+
+//_____________________________________________________________________________
+Bool_t ASequentialTracer::AddSurface(const char* path) {
+  // Add the node given by its path (e.g. "/world_1/mirror_12") to the last
+  // stage. A new stage is made if there is none. The geometry must be closed.
+  if (not fManager->IsClosed()) {
+    Error("AddSurface", "The geometry is not closed yet");
+    return kFALSE;
+  }
+
+  if (not fManager->cd(path)) {
+    Error("AddSurface", "Cannot find %s", path);
+    return kFALSE;
+  }
+
+  ASurface surface;
+  surface.fNode = fManager->GetCurrentNode();
+  surface.fType = fManager->GetOpticalType(surface.fNode);
+  surface.fMatrix = *fManager->GetCurrentMatrix();
+  TGeoNode* mother = fManager->GetMother(1);
+  fManager->CdTop();
+
+  if (surface.fType != AOpticsManager::kMirror and
+      surface.fType != AOpticsManager::kLens and
+      surface.fType != AOpticsManager::kObs and
+      surface.fType != AOpticsManager::kFocus) {
+    Error("AddSurface",
+          "%s is not a mirror, lens, obscuration or focal surface", path);
+    return kFALSE;
+  }
+
+  AOpticalComponent* component1 =
+      mother ? (AOpticalComponent*)mother->GetVolume() : 0;
+  AOpticalComponent* component2 =
+      (AOpticalComponent*)surface.fNode->GetVolume();
+  surface.fCondition =
+      component1 ? component1->FindBorderSurfaceCondition(component2) : 0;
+
+  if (surface.fCondition and
+      (surface.fType == AOpticsManager::kLens or
+       surface.fCondition->IsLambertian() or
+       surface.fCondition->GetGaussianRoughness() != 0)) {
+    Error("AddSurface",
+          "The border surface condition of %s is not supported", path);
+    return kFALSE;
+  }
+
+  if (fStages.empty()) {
+    AddStage();
+  }
+  fStages.back().push_back(surface);
+
+  return kTRUE;
+}
+
+//_____________________________________________________________________________
+const ASequentialTracer::ASurface* ASequentialTracer::FindNearestSurface(
+    const std::vector<ASurface>& stage, const Double_t* x, const Double_t* d,
+    Double_t& dist) const {
+  // Return the surface hit first by a photon at x going to d, and the distance
+  // to it. Return 0 if the photon misses all the surfaces.
+  const ASurface* nearest = 0;
+  dist = TGeoShape::Big();
+
+  for (const auto& surface : stage) {
+    Double_t local_x[3], local_d[3];
+    surface.fMatrix.MasterToLocal(x, local_x);
+    surface.fMatrix.MasterToLocalVect(d, local_d);
+    Double_t step = surface.fNode->GetVolume()->GetShape()->DistFromOutside(
+        local_x, local_d, 3, dist);
+    if (step < dist) {
+      dist = step;
+      nearest = &surface;
+    }
+  }
+
+  return nearest;
+}
+
+//_____________________________________________________________________________
+void ASequentialTracer::GetNormal(const ASurface& surface, const Double_t* x,
+                                  const Double_t* d, Double_t* n) const {
+  // Return the normal vector at x in the top frame. Its direction is chosen
+  // so that it makes an acute angle with d, as TGeoNavigator::FindNormal does.
+  Double_t local_x[3], local_d[3], local_n[3];
+  surface.fMatrix.MasterToLocal(x, local_x);
+  surface.fMatrix.MasterToLocalVect(d, local_d);
+  surface.fNode->GetVolume()->GetShape()->ComputeNormal(local_x, local_d,
+                                                        local_n);
+  surface.fMatrix.LocalToMasterVect(local_n, n);
+}
+
+//_____________________________________________________________________________
+Bool_t ASequentialTracer::Refract(Double_t n1, Double_t n2, Double_t k2,
+                                  const Double_t* n, Double_t* d,
+                                  ATraceContext& context) const {
+  // Refract d at a boundary from n1 to n2 + i k2 and return kTRUE. If the
+  // photon is reflected instead (total internal reflection or Fresnel
+  // reflection), d is reflected and kFALSE is returned.
+  ROBAST_STATS_COUNT_HANDLER(context, kFresnel);
+  Double_t cos1 = d[0] * n[0] + d[1] * n[1] + d[2] * n[2];
+  Double_t sin1 = TMath::Sqrt(1 - cos1 * cos1);
+  Double_t sin2 = n1 * sin1 / n2;  // Snell's law
+
+  Bool_t reflected = sin2 > 1.;  // total internal reflection
+  if (not reflected and not fManager->fDisableFresnelReflection) {
+    Double_t R = AOpticsManager::FresnelReflectance(n1, n2, k2, cos1);
+    reflected = context.GetRandom().Uniform(1) < R;
+  }
+
+  if (reflected) {
+    for (Int_t i = 0; i < 3; i++) {  // d2 = d1 - 2n*(d1*n)
+      d[i] -= 2 * n[i] * cos1;
+    }
+    return kFALSE;
+  }
+
+  Double_t cos2 = TMath::Sqrt(1 - sin2 * sin2);
+  for (Int_t i = 0; i < 3; i++) {
+    if (sin1 != 0) {
+      d[i] = (d[i] - cos1 * n[i]) * sin2 / sin1 + n[i] * cos2;
+    }
+  }
+
+  return kTRUE;
+}
+
+//_____________________________________________________________________________
+void ASequentialTracer::Trace(ARayBatch& batch) {
+  // Trace all the running photons in a batch through the stages, then trace
+  // the photons that have left the sequential path with
+  // AOpticsManager::TraceNonSequential
+  std::size_t n = batch.GetN();
+  fNfallback = 0;
+  if (n == 0) {
+    return;
+  }
+
+  fManager->PrepareTracing();
+
+  ULong64_t key = fManager->NextTraceKey();
+  auto trace = [this, &batch, key](ATraceContext& context, std::size_t begin,
+                                   std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+      if (not batch.IsRunning(i)) {
+        continue;
+      }
+
+      Double_t x[4], d[3];
+      batch.GetLastPoint(i, x);
+      batch.GetDirection(i, d);
+      Double_t weight = batch.GetWeight(i);
+
+      context.StartRay(key, i);
+      Int_t status = TracePhoton(batch.GetLambda(i), x, d, weight, context);
+
+      batch.SetLastPoint(i, x);
+      batch.SetDirection(i, d);
+      batch.SetWeight(i, weight);
+      batch.SetStatus(i, status);
+      if (status != ARay::kRun) {
+        // The other photons are counted by the non-sequential path
+        ROBAST_STATS_COUNT_RAY(context, status);
+      }
+    }
+  };
+
+  Int_t nthreads = fManager->GetMaxThreads();
+
+  if (fManager->IsMultiThread() and nthreads >= 2) {
+    AThreadPool* pool = fManager->GetThreadPool(nthreads);
+    pool->ParallelFor(n, fManager->fChunkSize,
+                      [this, &trace](std::size_t worker, std::size_t begin,
+                                     std::size_t end) {
+                        trace(fManager->GetWorkerContext(worker), begin, end);
+                      });
+    for (auto& context : fManager->fWorkerContexts) {
+      if (context) fManager->MergeTraceStatistics(*context);
+    }
+  } else {  // single thread
+    ATraceContext& context = fManager->GetCallerContext();
+    trace(context, 0, n);
+    fManager->MergeTraceStatistics(context);
+  }
+
+  fNfallback = batch.Count(ARay::kRun);
+  if (fNfallback > 0) {
+    fManager->TraceNonSequential(batch);
+  }
+}
+
+//_____________________________________________________________________________
+Int_t ASequentialTracer::TracePhoton(Double_t lambda, Double_t* x, Double_t* d,
+                                     Double_t& weight,
+                                     ATraceContext& context) const {
+  // Trace a photon through the stages and return its new status. x, d and
+  // weight are updated. ARay::kRun means that the photon must be traced by
+  // the non-sequential path from x.
+  const Double_t c = TMath::C() * AOpticsManager::m();
+  Bool_t weighted = fManager->IsWeightedTracing();
+
+  for (const auto& stage : fStages) {
+    Double_t dist;
+    const ASurface* surface = FindNearestSurface(stage, x, d, dist);
+    if (not surface) {
+      return ARay::kRun;  // missed
+    }
+
+    for (Int_t i = 0; i < 3; i++) {
+      x[i] += dist * d[i];
+    }
+    x[3] += dist / c;
+
+    Double_t n[3];
+    GetNormal(*surface, x, d, n);
+    Double_t cos1 = d[0] * n[0] + d[1] * n[1] + d[2] * n[2];
+
+    if (surface->fType == AOpticsManager::kObs) {
+      return ARay::kStop;
+    } else if (surface->fType == AOpticsManager::kFocus) {
+      ROBAST_STATS_COUNT_HANDLER(context, kFocalSurface);
+      AFocalSurface* focal = (AFocalSurface*)surface->fNode->GetVolume();
+      Double_t angle = focal->HasQEAngle() ? TMath::ACos(cos1) : 0.;
+      Double_t qe = focal->GetDetectionProbability(lambda, angle);
+      if (weighted and qe > 0) {
+        weight *= qe;
+        return ARay::kFocus;
+      } else if (qe == 1 or context.GetRandom().Uniform(0, 1) < qe) {
+        return ARay::kFocus;
+      }
+      return ARay::kStop;
+    } else if (surface->fType == AOpticsManager::kMirror) {
+      ROBAST_STATS_COUNT_HANDLER(context, kReflection);
+      Double_t angle = TMath::ACos(cos1);
+      Double_t ref;
+      if (surface->fCondition and surface->fCondition->GetMultilayer()) {
+        Double_t transmittance;
+        // ignore polarization in the current version
+        ROBAST_STATS_COUNT_HANDLER(context, kMultilayer);
+        surface->fCondition->GetMultilayer()->CoherentTMMMixed(
+            angle, lambda, ref, transmittance);
+      } else {
+        ref = ((AMirror*)surface->fNode->GetVolume())->GetReflectance(lambda,
+                                                                      angle);
+      }
+      if (weighted and ref > 0) {
+        weight *= ref;
+      } else if (ref < context.GetRandom().Uniform(1)) {
+        return ARay::kAbsorb;
+      }
+      for (Int_t i = 0; i < 3; i++) {  // d2 = d1 - 2n*(d1*n)
+        d[i] -= 2 * n[i] * cos1;
+        x[i] -= kEpsilon * n[i];
+      }
+    } else {  // lens
+      ALens* lens = (ALens*)surface->fNode->GetVolume();
+      Double_t n2 = context.GetRefractiveIndex(lens, lambda);
+      Double_t k2 = context.GetExtinctionCoefficient(lens, lambda);
+      if (not Refract(1., n2, k2, n, d, context)) {
+        for (Int_t i = 0; i < 3; i++) {
+          x[i] -= kEpsilon * n[i];
+        }
+        return ARay::kRun;  // reflected
+      }
+      for (Int_t i = 0; i < 3; i++) {
+        x[i] += kEpsilon * n[i];
+      }
+
+      // Propagate to the exit surface of the same lens
+      Double_t local_x[3], local_d[3];
+      surface->fMatrix.MasterToLocal(x, local_x);
+      surface->fMatrix.MasterToLocalVect(d, local_d);
+      dist = lens->GetShape()->DistFromInside(local_x, local_d, 3);
+
+      Double_t abs = context.GetAbsorptionLength(lens, lambda);
+      if (abs > 0 and abs != kInf) {
+        if (weighted) {
+          weight *= TMath::Exp(-dist / abs);
+        } else {
+          Double_t abs_step = context.GetRandom().Exp(abs);
+          if (abs_step < dist) {
+            for (Int_t i = 0; i < 3; i++) {
+              x[i] += abs_step * d[i];
+            }
+            x[3] += abs_step * n2 / c;
+            return ARay::kAbsorb;
+          }
+        }
+      }
+
+      for (Int_t i = 0; i < 3; i++) {
+        x[i] += dist * d[i];
+      }
+      x[3] += dist * n2 / c;
+
+      GetNormal(*surface, x, d, n);
+      if (not Refract(n2, 1., 0., n, d, context)) {
+        for (Int_t i = 0; i < 3; i++) {
+          x[i] -= kEpsilon * n[i];
+        }
+        return ARay::kRun;  // reflected inside the lens
+      }
+      for (Int_t i = 0; i < 3; i++) {
+        x[i] += kEpsilon * n[i];
+      }
+    }
+  }
+
+  return ARay::kRun;  // after the last stage
+}
@@ -0,0 +1,171 @@
+/******************************************************************************
+ * Copyright (C) 2006-, Akira Okumura                                         *
+ * All rights reserved.                                                       *
+ *****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// AThreadPool
+//
+// Persistent pool of worker threads with work stealing
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "AThreadPool.h"
+
+//_____________________________________________________________________________
+AThreadPool::AThreadPool(std::size_t nthreads)
+    : fTask(0),
+      fN(0),
+      fChunkSize(1),
+      fGeneration(0),
+      fNactive(0),
+      fStop(kFALSE) {
+  if (nthreads == 0) {
+    nthreads = 1;
+  }
+
+  for (std::size_t i = 0; i < nthreads; ++i) {
+    fQueues.emplace_back(new AChunkQueue);
+    fQueues.back()->fFront = 0;
+    fQueues.back()->fBack = 0;
+  }
+
+  for (std::size_t i = 0; i < nthreads; ++i) {
+    fThreads.emplace_back(&AThreadPool::WorkerLoop, this, i);
+  }
+}
+
+//_____________________________________________________________________________
+AThreadPool::~AThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fStop = kTRUE;
+  }
+  fWakeUp.notify_all();
+
+  for (auto& thread : fThreads) {
+    thread.join();
+  }
+}
+
+//_____________________________________________________________________________
+Bool_t AThreadPool::PopChunk(std::size_t worker, std::size_t& chunk) {
+  // Take the next chunk from the own queue, or steal the last one from the
+  // other workers if the own queue is already empty
+  {
+    AChunkQueue& queue = *fQueues[worker];
+    std::lock_guard<std::mutex> lock(queue.fMutex);
+    if (queue.fFront < queue.fBack) {
+      chunk = queue.fFront++;
+      return kTRUE;
+    }
+  }
+
+  std::size_t nthreads = fQueues.size();
+  for (std::size_t i = 1; i < nthreads; ++i) {
+    AChunkQueue& victim = *fQueues[(worker + i) % nthreads];
+    std::lock_guard<std::mutex> lock(victim.fMutex);
+    if (victim.fFront < victim.fBack) {
+      chunk = --victim.fBack;
+      return kTRUE;
+    }
+  }
+
+  return kFALSE;
+}
+
+//_____________________________________________________________________________
+void AThreadPool::RunChunks(std::size_t worker) {
+  // No chunk is added while a job is running, so the job is finished for this
+  // worker once all the queues are found empty
+  std::size_t chunk;
+  while (PopChunk(worker, chunk)) {
+    std::size_t begin = chunk * fChunkSize;
+    std::size_t end = begin + fChunkSize < fN ? begin + fChunkSize : fN;
+    try {
+      (*fTask)(worker, begin, end);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(fMutex);
+      if (!fException) {
+        fException = std::current_exception();
+      }
+    }
+  }
+}
+
+//_____________________________________________________________________________
+void AThreadPool::WorkerLoop(std::size_t worker) {
+  std::size_t generation = 0;
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(fMutex);
+      fWakeUp.wait(lock,
+                   [&] { return fStop or fGeneration != generation; });
+      if (fStop) {
+        return;
+      }
+      generation = fGeneration;
+    }
+
+    RunChunks(worker);
+
+    {
+      std::lock_guard<std::mutex> lock(fMutex);
+      if (--fNactive == 0) {
+        fDone.notify_one();
+      }
+    }
+  }
+}
+
+//_____________________________________________________________________________
+void AThreadPool::ParallelFor(std::size_t n, std::size_t chunk,
+                              const Task_t& func) {
+  // Process the items [0, n) on the worker threads and return when all of them
+  // have been processed. The items are split into chunks of "chunk" items and
+  // distributed evenly to the workers first. A worker that has finished its own
+  // chunks then steals the remaining ones from the others, so the total time
+  // is determined by the total amount of work rather than the slowest share.
+  if (n == 0) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> call_lock(fCallMutex);
+
+  if (chunk == 0) {
+    chunk = 1;
+  }
+  std::size_t nchunks = (n + chunk - 1) / chunk;
+  std::size_t nthreads = fThreads.size();
+
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    for (std::size_t i = 0; i < nthreads; ++i) {
+      std::lock_guard<std::mutex> queue_lock(fQueues[i]->fMutex);
+      fQueues[i]->fFront = nchunks * i / nthreads;
+      fQueues[i]->fBack = nchunks * (i + 1) / nthreads;
+    }
+    fTask = &func;
+    fN = n;
+    fChunkSize = chunk;
+    fNactive = nthreads;
+    fException = nullptr;
+    ++fGeneration;
+  }
+  fWakeUp.notify_all();
+
+  std::exception_ptr exception;
+  {
+    std::unique_lock<std::mutex> lock(fMutex);
+    fDone.wait(lock, [&] { return fNactive == 0; });
+    fTask = 0;
+    exception = fException;
+    fException = nullptr;
+  }
+
+  if (exception) {
+    std::rethrow_exception(exception);
+  }
+}
@@ -0,0 +1,60 @@
+/******************************************************************************
+ * Copyright (C) 2006-, Akira Okumura                                         *
+ * All rights reserved.                                                       *
+ *****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// ATraceContext
+//
+// State owned by a single tracing thread. AOpticsManager passes a context to
+// every step of the tracing kernel instead of using global objects such as
+// gRandom. Before each ray is traced, the random number generator is moved to
+// the stream determined by the ray index (StartRay), so the random numbers of
+// a ray do not depend on which thread traces it.
+//
+// The context also caches the optical constants of each lens at the
+// wavelength of the current ray, because a ray usually crosses the same lens
+// surfaces many times with a fixed wavelength. ClearCache() must be called
+// when the refractive indices may have been changed.
+//
+// The context also holds the counters of this thread (see ATraceStatistics).
+// They are filled only in a build with ROBAST_INSTRUMENTATION, but the member
+// exists in every build so that the class layout does not depend on the flag.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ATraceContext.h"
+
+//_____________________________________________________________________________
+ATraceContext::ATraceContext(TGeoNavigator* nav) : fNavigator(nav) {}
+
+//_____________________________________________________________________________
+ATraceContext::~ATraceContext() {}
+
+//_____________________________________________________________________________
+const ATraceContext::ALensConstants& ATraceContext::GetLensConstants(
+    const ALens* lens, Double_t lambda) {
+  // The entry of a volume not registered in the geometry (number < 0) is
+  // recalculated every time
+  Int_t number = lens->GetNumber();
+  ALensConstants* constants = &fUnregistered;
+  if (number >= 0) {
+    if ((std::size_t)number >= fLensConstants.size()) {
+      // a negative wavelength marks an empty entry
+      fLensConstants.resize(number + 1, ALensConstants{-1., 1., 0., 0.});
+    }
+    constants = &fLensConstants[number];
+  }
+
+  if (number < 0 or constants->fLambda != lambda) {
+    ROBAST_STATS_START_TIMER(*this, kIndexLookup);
+    constants->fLambda = lambda;
+    constants->fN = lens->GetRefractiveIndex(lambda);
+    constants->fK = lens->GetExtinctionCoefficient(lambda);
+    constants->fAbsorptionLength = lens->GetAbsorptionLength(lambda);
+    ROBAST_STATS_STOP_TIMER(*this, kIndexLookup);
+  }
+
+  return *constants;
+}
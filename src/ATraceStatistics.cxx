@@ -0,0 +1,271 @@
+/******************************************************************************
+ * Copyright (C) 2006-, Akira Okumura                                         *
+ * All rights reserved.                                                       *
+ *****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// ATraceStatistics
+//
+// Step, handler and timing counters of the tracing kernel. The counters are
+// filled only if ROBAST is built with ROBAST_INSTRUMENTATION defined, e.g.,
+//   $ make ROBASTFLAGS=-DROBAST_INSTRUMENTATION
+// Otherwise the hooks in AOpticsManager are compiled to nothing and the
+// statistics stay empty. IsEnabled() tells which build is used.
+//
+// Each tracing thread fills its own counters, which are added to those of
+// AOpticsManager (GetTraceStatistics) at the end of every tracing call. The
+// following values are recorded:
+//   - the number of steps started in each volume
+//   - the number of calls of each boundary handler (reflection, Fresnel,
+//     multilayer (TMM) evaluation, and focal surface)
+//   - the cumulative time of navigation (FindNextBoundaryAndStep), surface
+//     physics, and refractive index lookup
+//   - the number of traced rays by final status, e.g., suspended at the
+//     limit of steps (AOpticsManager::SetLimit)
+//   - the distribution of the number of steps per ray
+// The time of surface physics includes that of the index lookups made in the
+// handlers, and the times are summed over the threads. Reading the clock costs
+// some tens of ns, so the timers slow down tracing by a fraction of the time
+// of a step.
+//
+// Photons stopped in ASequentialTracer are counted by final status and
+// handler calls only, because they make no navigation steps. Those handed
+// over to the non-sequential path are counted there.
+//
+// The statistics can be saved in a ROOT file as they are, or dumped in JSON
+// by ToJSON() or WriteJSON().
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+#include "TCollection.h"
+#include "TH1D.h"
+#include "TObjArray.h"
+
+#include "ATraceStatistics.h"
+
+ClassImp(ATraceStatistics);
+
+namespace {
+
+const char* kHandlerNames[ATraceStatistics::kNhandlers] = {
+    "reflection", "fresnel", "multilayer", "focalSurface"};
+const char* kTimerNames[ATraceStatistics::kNtimers] = {
+    "navigation", "surfacePhysics", "indexLookup"};
+const char* kStatusNames[ATraceStatistics::kNstatus] = {
+    "run", "stop", "exit", "focus", "suspend", "absorb"};
+
+}  // namespace
+
+//_____________________________________________________________________________
+ATraceStatistics::ATraceStatistics() { Clear(); }
+
+//_____________________________________________________________________________
+ATraceStatistics::~ATraceStatistics() {}
+
+//_____________________________________________________________________________
+void ATraceStatistics::Add(const ATraceStatistics& other) {
+  for (Int_t i = 0; i < kNstatus; ++i) {
+    fNrays[i] += other.fNrays[i];
+  }
+  for (Int_t i = 0; i < kNhandlers; ++i) {
+    fNcalls[i] += other.fNcalls[i];
+  }
+  for (Int_t i = 0; i < kNtimers; ++i) {
+    fTime[i] += other.fTime[i];
+  }
+  fNstepsOutside += other.fNstepsOutside;
+
+  if (fNsteps.size() < other.fNsteps.size()) {
+    fNsteps.resize(other.fNsteps.size(), 0);
+  }
+  for (std::size_t i = 0; i < other.fNsteps.size(); ++i) {
+    fNsteps[i] += other.fNsteps[i];
+  }
+
+  if (fStepsPerRay.size() < other.fStepsPerRay.size()) {
+    fStepsPerRay.resize(other.fStepsPerRay.size(), 0);
+  }
+  for (std::size_t i = 0; i < other.fStepsPerRay.size(); ++i) {
+    fStepsPerRay[i] += other.fStepsPerRay[i];
+  }
+
+  if (fVolumeNames.size() < other.fVolumeNames.size()) {
+    fVolumeNames = other.fVolumeNames;
+  }
+}
+
+//_____________________________________________________________________________
+void ATraceStatistics::Clear(Option_t*) {
+  std::fill(fNrays, fNrays + kNstatus, 0);
+  std::fill(fNcalls, fNcalls + kNhandlers, 0);
+  std::fill(fTime, fTime + kNtimers, 0);
+  std::fill(fStart, fStart + kNtimers, 0);
+  fNstepsOutside = 0;
+  fNstepsAtStart = 0;
+  fNsteps.clear();
+  fStepsPerRay.clear();
+}
+
+//_____________________________________________________________________________
+void ATraceStatistics::EndRay(const ARay& ray) {
+  // Count a ray at the end of AOpticsManager::TraceRay. Only the steps made in
+  // this call are histogrammed if the ray had been traced before.
+  CountRay(ray.GetStatus());
+
+  Int_t n = ray.GetNsteps() - fNstepsAtStart;
+  if (n < 0) {
+    n = 0;
+  }
+  if ((std::size_t)n >= fStepsPerRay.size()) {
+    fStepsPerRay.resize(n + 1, 0);
+  }
+  ++fStepsPerRay[n];
+}
+
+//_____________________________________________________________________________
+ULong64_t ATraceStatistics::GetNrays() const {
+  ULong64_t n = 0;
+  for (Int_t i = 0; i < kNstatus; ++i) {
+    n += fNrays[i];
+  }
+
+  return n;
+}
+
+//_____________________________________________________________________________
+Bool_t ATraceStatistics::IsEnabled() {
+  // Return kTRUE if the tracing kernel has been built with the hooks
+#ifdef ROBAST_INSTRUMENTATION
+  return kTRUE;
+#else
+  return kFALSE;
+#endif
+}
+
+//_____________________________________________________________________________
+TH1D* ATraceStatistics::MakeStepsPerRayHist(const char* name) const {
+  // Return a new histogram of the number of steps per ray. The caller owns it.
+  Int_t n = fStepsPerRay.empty() ? 1 : fStepsPerRay.size();
+  TH1D* h = new TH1D(name, ";Number of Steps;Number of Rays", n, -0.5,
+                     n - 0.5);
+  for (Int_t i = 0; i < (Int_t)fStepsPerRay.size(); ++i) {
+    h->SetBinContent(i + 1, fStepsPerRay[i]);
+  }
+  h->SetEntries(GetNrays());
+
+  return h;
+}
+
+//_____________________________________________________________________________
+Long64_t ATraceStatistics::Merge(TCollection* list) {
+  // Used by hadd and TFileMerger
+  if (!list) {
+    return 0;
+  }
+
+  TIter next(list);
+  while (TObject* obj = next()) {
+    ATraceStatistics* other = dynamic_cast<ATraceStatistics*>(obj);
+    if (other) {
+      Add(*other);
+    }
+  }
+
+  return GetNrays();
+}
+
+//_____________________________________________________________________________
+void ATraceStatistics::Print(Option_t*) const {
+  std::cout << "Rays: " << GetNrays() << std::endl;
+  for (Int_t i = 0; i < kNstatus; ++i) {
+    std::cout << "  " << kStatusNames[i] << ": " << fNrays[i] << std::endl;
+  }
+  std::cout << "Handler calls:" << std::endl;
+  for (Int_t i = 0; i < kNhandlers; ++i) {
+    std::cout << "  " << kHandlerNames[i] << ": " << fNcalls[i] << std::endl;
+  }
+  std::cout << "Time (s):" << std::endl;
+  for (Int_t i = 0; i < kNtimers; ++i) {
+    std::cout << "  " << kTimerNames[i] << ": " << GetTime(ETimer(i))
+              << std::endl;
+  }
+  std::cout << "Steps by volume:" << std::endl;
+  std::cout << "  (outside): " << fNstepsOutside << std::endl;
+  for (std::size_t i = 0; i < fNsteps.size(); ++i) {
+    if (fNsteps[i] == 0) continue;
+    std::cout << "  "
+              << (i < fVolumeNames.size() ? fVolumeNames[i].Data() : "")
+              << " (" << i << "): " << fNsteps[i] << std::endl;
+  }
+}
+
+//_____________________________________________________________________________
+void ATraceStatistics::SetVolumeNames(const TObjArray* volumes) {
+  // Copy the names of the volumes, which are shown by Print and ToJSON
+  if (!volumes or
+      (Int_t)fVolumeNames.size() == volumes->GetEntriesFast()) {
+    return;
+  }
+
+  fVolumeNames.resize(volumes->GetEntriesFast());
+  for (Int_t i = 0; i < volumes->GetEntriesFast(); ++i) {
+    TObject* volume = volumes->At(i);
+    fVolumeNames[i] = volume ? volume->GetName() : "";
+  }
+}
+
+//_____________________________________________________________________________
+TString ATraceStatistics::ToJSON() const {
+  TString json = "{\n  \"rays\": {";
+  for (Int_t i = 0; i < kNstatus; ++i) {
+    json += Form("%s\"%s\": %llu", i ? ", " : "", kStatusNames[i],
+                 fNrays[i]);
+  }
+  json += "},\n  \"handlerCalls\": {";
+  for (Int_t i = 0; i < kNhandlers; ++i) {
+    json += Form("%s\"%s\": %llu", i ? ", " : "", kHandlerNames[i],
+                 fNcalls[i]);
+  }
+  json += "},\n  \"time\": {";
+  for (Int_t i = 0; i < kNtimers; ++i) {
+    json += Form("%s\"%s\": %.9f", i ? ", " : "", kTimerNames[i],
+                 GetTime(ETimer(i)));
+  }
+  json += Form("},\n  \"stepsOutside\": %llu,\n  \"stepsByVolume\": [",
+               fNstepsOutside);
+  Bool_t first = kTRUE;
+  for (std::size_t i = 0; i < fNsteps.size(); ++i) {
+    if (fNsteps[i] == 0) continue;
+    TString name = i < fVolumeNames.size() ? fVolumeNames[i] : "";
+    name.ReplaceAll("\\", "\\\\");
+    name.ReplaceAll("\"", "\\\"");
+    json += Form("%s\n    {\"number\": %zu, \"name\": \"%s\", "
+                 "\"steps\": %llu}",
+                 first ? "" : ",", i, name.Data(), fNsteps[i]);
+    first = kFALSE;
+  }
+  json += first ? "],\n  \"stepsPerRay\": [" : "\n  ],\n  \"stepsPerRay\": [";
+  for (std::size_t i = 0; i < fStepsPerRay.size(); ++i) {
+    json += Form("%s%llu", i ? ", " : "", fStepsPerRay[i]);
+  }
+  json += "]\n}\n";
+
+  return json;
+}
+
+//_____________________________________________________________________________
+Bool_t ATraceStatistics::WriteJSON(const char* filename) const {
+  std::ofstream fout(filename);
+  if (not fout) {
+    Error("WriteJSON", "Cannot create %s", filename);
+    return kFALSE;
+  }
+  fout << ToJSON().Data();
+
+  return kTRUE;
+}
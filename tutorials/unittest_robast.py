@@ -3,8 +3,11 @@
 import unittest
 import ROOT
 import array
+import math
 import time
 import ctypes
+import os
+import tempfile
 
 cm = ROOT.AOpticsManager.cm()
 mm = ROOT.AOpticsManager.mm()
@@ -54,6 +57,22 @@ def makeTheWorld():
     
     return manager
 
+def writeAndRead(obj):
+    '''
+    Return a copy of obj written to and read back from a ROOT file
+    '''
+    with tempfile.TemporaryDirectory() as tmpdir:
+        fname = os.path.join(tmpdir, "robast.root")
+        f = ROOT.TFile(fname, "recreate")
+        obj.Write("obj")
+        f.Close()
+        f = ROOT.TFile(fname)
+        copy = f.Get("obj")
+        f.Close()
+
+    registerGeo((copy,))
+    return copy
+
 class TestROBAST(unittest.TestCase):
     """
     Unit test for ROBAST
@@ -230,6 +249,13 @@ class TestROBAST(unittest.TestCase):
         mirror.SetReflectance(ROOT.graph2d)
         self.assertAlmostEqual(mirror.GetReflectance(400*nm, 45*deg), 0.5, 3)
 
+        # The same reflectance resampled on a regular grid
+        mirror.UseReflectanceGrid(201, 91)
+        mirror.BuildReflectanceGrid()
+        self.assertTrue(mirror.HasReflectanceGrid())
+        self.assertAlmostEqual(mirror.GetReflectance(400*nm, 45*deg), 0.5, 3)
+        self.assertEqual(mirror.GetReflectance(600*nm, 45*deg), 0)
+
         rays = ROOT.ARayArray()
         for i in range(N):
             x, y, z, t = 0, 0, 0.51*m, 0
@@ -247,6 +273,135 @@ class TestROBAST(unittest.TestCase):
 
         cleanupGeo()
 
+    def testRayBatch(self):
+        manager = makeTheWorld()
+
+        mirrorbox = ROOT.TGeoBBox("mirrorbox", 0.5*m, 0.5*m, 0.5*m)
+        mirror = ROOT.AMirror("mirror", mirrorbox)
+        registerGeo((mirrorbox, mirror))
+
+        manager.GetTopVolume().AddNode(mirror, 1)
+        manager.CloseGeometry()
+
+        if ROOT.gInterpreter.ProcessLine('ROOT_VERSION_CODE;') < \
+           ROOT.gInterpreter.ProcessLine('ROOT_VERSION(6, 2, 0);'):
+            manager.SetMultiThread(True)
+        manager.SetMaxThreads(4)
+
+        ROOT.gROOT.ProcessLine('graph = std::make_shared<TGraph>();')
+        ROOT.graph.SetPoint(0, 300*nm, 0.)
+        ROOT.graph.SetPoint(1, 500*nm, .5) # 0.25 at 400 nm
+        mirror.SetReflectance(ROOT.graph)
+
+        N = 10000
+
+        batch = ROOT.ARayBatch()
+        ROOT.ARayShooter.Square(batch, 400*nm, 0.1*m, 100, 0,
+                                ROOT.TGeoTranslation(0, 0, 0.8*m),
+                                ROOT.TVector3(0, 0, -1))
+        self.assertEqual(batch.GetN(), N)
+        self.assertEqual(batch.Count(ROOT.ARay.kRun), N)
+
+        manager.TraceNonSequential(batch)
+
+        n = batch.Count(ROOT.ARay.kExit)
+        ref = 0.25
+
+        self.assertEqual(n + batch.Count(ROOT.ARay.kAbsorb), N)
+        self.assertGreater(ref, (n - n**0.5*3)/N)
+        self.assertLess(ref, (n + n**0.5*3)/N)
+
+        # reflected photons go back upward from the mirror surface
+        for i in range(N):
+            if batch.IsExited(i):
+                self.assertGreater(batch.GetDz()[i], 0)
+
+        rays = batch.MakeRayArray()
+        self.assertEqual(rays.GetExited().GetLast() + 1, n)
+
+        # results must not depend on the number of threads
+        status = []
+        for nthreads in (1, 4):
+            manager.SetMaxThreads(nthreads)
+            manager.SetSeed(1234)
+            batch = ROOT.ARayBatch()
+            ROOT.ARayShooter.Square(batch, 400*nm, 0.1*m, 100, 0,
+                                    ROOT.TGeoTranslation(0, 0, 0.8*m),
+                                    ROOT.TVector3(0, 0, -1))
+            manager.TraceNonSequential(batch)
+            status.append([batch.GetStatus(i) for i in range(N)])
+
+        self.assertEqual(status[0], status[1])
+
+        # In the weighted mode, every photon is reflected with a weight of R
+        manager.SetWeightedTracing(True)
+        batch = ROOT.ARayBatch()
+        ROOT.ARayShooter.Square(batch, 400*nm, 0.1*m, 100, 0,
+                                ROOT.TGeoTranslation(0, 0, 0.8*m),
+                                ROOT.TVector3(0, 0, -1))
+        manager.TraceNonSequential(batch)
+        manager.SetWeightedTracing(False)
+
+        self.assertEqual(batch.Count(ROOT.ARay.kExit), N)
+        for i in range(N):
+            self.assertAlmostEqual(batch.GetWeight(i), ref, 6)
+
+        cleanupGeo()
+
+    def testSequentialTracer(self):
+        manager = makeTheWorld()
+
+        mirrorbox = ROOT.TGeoBBox("mirrorbox", 0.5*m, 0.5*m, 0.5*m)
+        mirror = ROOT.AMirror("mirror", mirrorbox)
+        registerGeo((mirrorbox, mirror))
+
+        manager.GetTopVolume().AddNode(mirror, 1)
+        manager.CloseGeometry()
+        manager.SetMaxThreads(1)
+
+        ROOT.gROOT.ProcessLine('graph = std::make_shared<TGraph>();')
+        ROOT.graph.SetPoint(0, 300*nm, 0.)
+        ROOT.graph.SetPoint(1, 500*nm, .5) # 0.25 at 400 nm
+        mirror.SetReflectance(ROOT.graph)
+
+        tracer = ROOT.ASequentialTracer(manager)
+        tracer.AddStage()
+        self.assertTrue(tracer.AddSurface("/world_1/mirror_1"))
+        self.assertEqual(tracer.GetNstages(), 1)
+
+        N = 10000
+
+        batch = ROOT.ARayBatch()
+        ROOT.ARayShooter.Square(batch, 400*nm, 0.1*m, 100, 0,
+                                ROOT.TGeoTranslation(0, 0, 0.8*m),
+                                ROOT.TVector3(0, 0, -1))
+        tracer.Trace(batch)
+
+        n = batch.Count(ROOT.ARay.kExit)
+        ref = 0.25
+
+        # The reflected photons are handed to the non-sequential path after
+        # the last stage, and they exit the world
+        self.assertEqual(tracer.GetNfallback(), n)
+        self.assertEqual(n + batch.Count(ROOT.ARay.kAbsorb), N)
+        self.assertGreater(ref, (n - n**0.5*3)/N)
+        self.assertLess(ref, (n + n**0.5*3)/N)
+
+        stats = manager.GetTraceStatistics()
+        if ROOT.ATraceStatistics.IsEnabled():
+            self.assertEqual(stats.GetNrays(), N)
+            self.assertEqual(stats.GetNrays(ROOT.ARay.kAbsorb), N - n)
+            self.assertEqual(stats.GetNrays(ROOT.ARay.kExit), n)
+            self.assertEqual(
+                stats.GetNcalls(ROOT.ATraceStatistics.kReflection), N)
+
+        for i in range(N):
+            if batch.IsExited(i):
+                self.assertGreater(batch.GetDz()[i], 0)
+                self.assertAlmostEqual(batch.GetZ()[i], 20*m, 6) # world
+
+        cleanupGeo()
+
     def testMirrorBoundaryMultilayer(self):
         manager = makeTheWorld()
 
@@ -410,6 +565,60 @@ class TestROBAST(unittest.TestCase):
         n = ray.GetNpoints()
         self.assertEqual(n, 1000)
 
+        # only the first and last points are kept, but the limit is the same
+        manager.SetRecording(ROOT.ARay.kRecordEndpoints)
+        ray = ROOT.ARay(0, 400*nm, 0, 0, 0, 0, 0, 0, -1)
+        manager.TraceNonSequential(ray)
+        self.assertTrue(ray.IsSuspended())
+        self.assertEqual(ray.GetNpoints(), 2)
+        self.assertEqual(ray.GetNsteps(), 999)
+        self.assertEqual(ray.GetNodeHistory().GetEntries(), 0)
+
+        manager.SetRecording(ROOT.ARay.kRecordLastPoint)
+        ray = ROOT.ARay(0, 400*nm, 0, 0, 0, 0, 0, 0, -1)
+        manager.TraceNonSequential(ray)
+        self.assertTrue(ray.IsSuspended())
+        self.assertEqual(ray.GetNpoints(), 1)
+        self.assertEqual(ray.GetVolumeHistory().size(), 999)
+
+        cleanupGeo()
+
+    def testTraceStatistics(self):
+        manager = makeTheWorld()
+        manager.SetLimit(1000)
+
+        mirrorsphere = ROOT.TGeoSphere("mirrorsphere", 0.1*m, 0.2*m)
+        mirror = ROOT.AMirror("mirror", mirrorsphere)
+        registerGeo((mirrorsphere, mirror))
+
+        manager.GetTopVolume().AddNode(mirror, 1)
+        manager.CloseGeometry()
+
+        ray = ROOT.ARay(0, 400*nm, 0, 0, 0, 0, 0, 0, -1)
+        manager.TraceNonSequential(ray)
+
+        stats = manager.GetTraceStatistics()
+        if not ROOT.ATraceStatistics.IsEnabled():
+            # built without ROBAST_INSTRUMENTATION
+            self.assertEqual(stats.GetNrays(), 0)
+            cleanupGeo()
+            return
+
+        self.assertEqual(stats.GetNrays(), 1)
+        self.assertEqual(stats.GetNrays(ROOT.ARay.kSuspend), 1)
+        self.assertEqual(stats.GetNcalls(ROOT.ATraceStatistics.kReflection),
+                         999)
+        self.assertEqual(stats.GetStepsPerRay().size(), 1000)
+        self.assertEqual(stats.GetStepsPerRay()[999], 1)
+        self.assertTrue('"suspend": 1' in str(stats.ToJSON()))
+
+        # counters of successive calls are summed until reset
+        ray = ROOT.ARay(0, 400*nm, 0, 0, 0, 0, 0, 0, -1)
+        manager.TraceNonSequential(ray)
+        self.assertEqual(stats.GetNrays(), 2)
+        manager.ResetTraceStatistics()
+        self.assertEqual(stats.GetNrays(), 0)
+
         cleanupGeo()
 
     def testRefractiveIndex(self):
@@ -425,6 +634,195 @@ class TestROBAST(unittest.TestCase):
         n = lens.GetRefractiveIndex(450*nm)
         self.assertEqual(n, 1.55)
 
+    def testWinstonConeEdge(self):
+        # rays crossing an edge of a hexagonal cone exactly, which used to be
+        # missed by both faces and to hit the opposite edge
+        cone = ROOT.AGeoWinstonConePoly("cone6edge", 20*mm, 10*mm, 6)
+        registerGeo((cone,))
+        for z in (-2*cm, 0, 1*cm):
+            for sign in (1, -1):
+                x = array.array("d", [0, -sign*5*cm, z])
+                d = array.array("d", [0, sign, 0])
+                rc = cone.CalcR(z)/math.cos(math.pi/6)
+                self.assertAlmostEqual(cone.DistFromOutside(x, d), 5*cm - rc,
+                                       10)
+
+    def testAsphericDisk(self):
+        # spherical surface 2 (R = 1 m) hit at a large incident angle
+        disk = ROOT.AGeoAsphericDisk("disk", 0, 0, 1*cm, 1/m, 50*cm)
+        R = 1*m
+        zc = 1*cm + R
+        for theta_deg in (0, 30, 70, 85):
+            theta = theta_deg*math.pi/180.
+            x = array.array("d", [-30*cm, 0, 0])
+            d = array.array("d", [math.sin(theta), 0, math.cos(theta)])
+            # |x + t*d - c|^2 = R^2 with c = (0, 0, zc), the nearer root
+            b = x[0]*d[0] + (x[2] - zc)*d[2]
+            c = x[0]**2 + (x[2] - zc)**2 - R**2
+            t = -b - math.sqrt(b*b - c)
+            self.assertAlmostEqual(disk.DistToAsphere(2, x, d), t, 8)
+
+        # rays missing the surface and rays inside rmin
+        x = array.array("d", [0, 0, -1*cm])
+        d = array.array("d", [1, 0, 0])
+        self.assertEqual(disk.DistToAsphere(2, x, d), ROOT.TGeoShape.Big())
+        disk = ROOT.AGeoAsphericDisk("disk2", 0, 0, 1*cm, 1/m, 50*cm, 10*cm)
+        d = array.array("d", [0, 0, 1])
+        self.assertEqual(disk.DistToAsphere(2, x, d), ROOT.TGeoShape.Big())
+
+        # safety must not exceed the distance to the boundary found by a fine
+        # scan of the surfaces and the walls, and should be close to it
+        disk = ROOT.AGeoAsphericDisk("disk3", 0, 0, 1*cm, 1/m, 50*cm, 10*cm)
+        f2 = lambda r: 1*cm + R - math.sqrt(R**2 - r**2)
+        for r in (0, 5*cm, 20*cm, 45*cm, 60*cm):
+            for dz in (-5*mm, 1*mm, 5*cm):
+                z = f2(min(r, 50*cm)) + dz
+                dist = min(math.hypot(r - rw, max(0, -z, z - f2(rw)))
+                           for rw in (10*cm, 50*cm))
+                for i in range(4001):
+                    rr = 10*cm + 40*cm*i/4000.
+                    dist = min(dist, math.hypot(rr - r, z),
+                               math.hypot(rr - r, z - f2(rr)))
+                x = array.array("d", [r, 0, z])
+                safe = disk.Safety(x, True)
+                self.assertLessEqual(safe, dist)
+                self.assertGreater(safe, 0.7*dist)
+
+        # the profiles are recomputed for a shape read from a file
+        copy = writeAndRead(disk)
+        d = array.array("d", [math.sin(0.5), 0, math.cos(0.5)])
+        for r in (0, 20*cm, 60*cm):
+            for z in (-5*mm, 5*mm, 5*cm):
+                x = array.array("d", [r, 0, z])
+                self.assertEqual(copy.Safety(x, True), disk.Safety(x, True))
+                self.assertEqual(copy.Safety(x, False),
+                                 disk.Safety(x, False))
+                self.assertEqual(copy.DistToAsphere(2, x, d),
+                                 disk.DistToAsphere(2, x, d))
+
+    def testBezierCone(self):
+        manager = makeTheWorld()
+
+        # a linear curve gives a truncated cone and a hexagonal frustum
+        cone = ROOT.AGeoBezierCone("bcone", 20*mm, 10*mm, 30*mm)
+        tcone = ROOT.TGeoCone("tcone", 30*mm, 0, 10*mm, 0, 20*mm)
+        hexa = ROOT.AGeoBezierConePoly("bhex", 6, 20*mm, 10*mm, 30*mm)
+        pgon = ROOT.TGeoPgon("tpgon", 0, 360, 6, 2)
+        pgon.DefineSection(0, -30*mm, 0, 10*mm)
+        pgon.DefineSection(1, 30*mm, 0, 20*mm)
+        registerGeo((cone, tcone, hexa, pgon))
+
+        self.assertAlmostEqual(cone.Capacity(), tcone.Capacity(), 6)
+        self.assertAlmostEqual(hexa.Capacity(), pgon.Capacity(), 6)
+        for x0, theta_deg in ((-50*mm, 80), (-50*mm, 45), (-5*mm, 20),
+                              (3*mm, -10), (-50*mm, 89)):
+            theta = theta_deg*math.pi/180.
+            x = array.array("d", [x0, 1*mm, -40*mm])
+            d = array.array("d", [math.sin(theta), 0, math.cos(theta)])
+            self.assertAlmostEqual(cone.DistFromOutside(x, d),
+                                   tcone.DistFromOutside(x, d), 8)
+            self.assertAlmostEqual(hexa.DistFromOutside(x, d),
+                                   pgon.DistFromOutside(x, d), 8)
+            x = array.array("d", [x0/10., 1*mm, 0])
+            self.assertAlmostEqual(cone.DistFromInside(x, d),
+                                   tcone.DistFromInside(x, d), 8)
+            self.assertAlmostEqual(hexa.DistFromInside(x, d),
+                                   pgon.DistFromInside(x, d), 8)
+
+        # crossing points must be on the cubic Bezier curve
+        p1, p2 = (0.39, 0.18), (0.87, 0.36)
+        cone.SetControlPoints(p1[0], p1[1], p2[0], p2[1])
+        hexa.SetControlPoints(p1[0], p1[1], p2[0], p2[1])
+        bezier = lambda u, i: (3*(1 - u)**2*u*p1[i] + 3*(1 - u)*u**2*p2[i] +
+                               u**3)
+        for theta_deg in (90, 70, 110, 80):
+            theta = theta_deg*math.pi/180.
+            x = array.array("d", [-50*mm, 1*mm, -10*mm])
+            d = array.array("d", [math.sin(theta), 0, math.cos(theta)])
+            for shape in (cone, hexa):
+                t = shape.DistFromOutside(x, d)
+                xc = x[0] + t*d[0]
+                zc = x[2] + t*d[2]
+                lo, hi = 0., 1.
+                for i in range(60):
+                    u = (lo + hi)/2.
+                    if -30*mm + 60*mm*bezier(u, 1) < zc:
+                        lo = u
+                    else:
+                        hi = u
+                # the hexagon face hit here is normal to phi = 150 deg
+                if shape == cone:
+                    rc = math.hypot(xc, x[1])
+                else:
+                    rc = -xc*math.cos(math.pi/6) + x[1]*math.sin(math.pi/6)
+                r = 10*mm + 10*mm*bezier(u, 0)
+                self.assertAlmostEqual(rc, r, 8)
+
+    def testWinstonCone(self):
+        # fixed distances in cm along rays hitting faces and edges, starting
+        # on a face, and passing through the apertures (R1 = 20 mm, R2 = 10 mm)
+        big = ROOT.TGeoShape.Big()
+        l = math.sqrt(1.1)
+        oblique = (-1/l, 0.1/l, 0.3/l)
+        for n, values in ((4, (3.10894443991, 3.33778637311,
+                               2.41968912068, 1.89105556009,
+                               2.58031087932)),
+                          (6, (3.10894443991, 3.87043779711,
+                               2.89318498930, 1.89105556009,
+                               2.10681501070))):
+            e = math.pi/n
+            cone = ROOT.AGeoWinstonConePoly("cone%d" % n, 20*mm, 10*mm, n)
+            registerGeo((cone,))
+            copy = writeAndRead(cone)
+            rz = cone.CalcR(0.5*cm)
+            outside = (((5*cm, 0, 0.5*cm), (-1, 0, 0), values[0]),
+                       ((5*cm, 1*cm, -1*cm), oblique, values[1]),
+                       ((5*cm*math.cos(e), 5*cm*math.sin(e), 0),
+                        (-math.cos(e), -math.sin(e), 0), values[2]),
+                       ((2*mm, 1*mm, -5*cm), (0, 0, 1), 2.40192378865),
+                       ((5*cm, 0, 0), (0, 1, 0), big),
+                       ((rz, 0, 0.5*cm), (-1, 0, 0), 0),
+                       ((rz, 0, 0.5*cm), (1, 0, 0), big))
+            inside = (((0, 0, 0.5*cm), (1, 0, 0), values[3]),
+                      ((0, 0, 0), (math.cos(e), math.sin(e), 0), values[4]),
+                      ((0, 0, 0), (0, 0, 1), 2.59807621135))
+            for rays, isin in ((outside, False), (inside, True)):
+                for x, d, dist in rays:
+                    x = array.array("d", x)
+                    d = array.array("d", d)
+                    if isin:
+                        s = cone.DistFromInside(x, d)
+                        self.assertEqual(copy.DistFromInside(x, d), s)
+                    else:
+                        s = cone.DistFromOutside(x, d)
+                        self.assertEqual(copy.DistFromOutside(x, d), s)
+                    if dist == big:
+                        self.assertEqual(s, big)
+                    else:
+                        self.assertAlmostEqual(s, dist, 10)
+
+        cone = ROOT.AGeoWinstonCone2D("cone2d", 20*mm, 10*mm, 10*mm)
+        registerGeo((cone,))
+        copy = writeAndRead(cone)
+        for x, d, isin, dist in (((5*cm, 0, 0.5*cm), (-1, 0, 0), False,
+                                  3.10894443991),
+                                 ((-5*cm, 3*mm, -1*cm), (1, 0, 0), False,
+                                  3.37626390823),
+                                 ((0, 5*cm, 0), (0, -1, 0), False, 4*cm),
+                                 ((0, 0, 0.5*cm), (1, 0, 0), True,
+                                  1.89105556009),
+                                 ((0, 0, 0), (0, 0, 1), True, 2.59807621135),
+                                 ((0, 0, 0), (0, 1, 0), True, 1*cm)):
+            x = array.array("d", x)
+            d = array.array("d", d)
+            if isin:
+                s = cone.DistFromInside(x, d)
+                self.assertEqual(copy.DistFromInside(x, d), s)
+            else:
+                s = cone.DistFromOutside(x, d)
+                self.assertEqual(copy.DistFromOutside(x, d), s)
+            self.assertAlmostEqual(s, dist, 10)
+
     def testSnellsLaw(self):
         manager = makeTheWorld()
         manager.DisableFresnelReflection(True)
@@ -519,6 +917,43 @@ class TestROBAST(unittest.TestCase):
                 sigma = (N * (1 - p) * p)**0.5
                 self.assertLess(abs(nfocused - N * p), 3*sigma)
 
+        self.assertAlmostEqual(focal.GetQuantumEfficiency(400*nm), 0.5, 6)
+        self.assertAlmostEqual(focal.GetQuantumEfficiency(400*nm, 45*deg), 0.25, 6)
+
+        # The QE curves are written to a file and the tables are rebuilt
+        copy = writeAndRead(focal)
+        self.assertTrue(copy.HasQEAngle())
+        self.assertFalse(copy.IsQELambdaFolded())
+        for lmd in (300*nm, 400*nm, 450*nm, 600*nm):
+            for angle in (0*deg, 45*deg, 60*deg):
+                self.assertEqual(copy.GetQuantumEfficiency(lmd, angle),
+                                 focal.GetQuantumEfficiency(lmd, angle))
+
+        # The lambda QE folded into the source by rejection
+        N = 100**2
+        batch = ROOT.ARayBatch()
+        ROOT.ARayShooter.Square(batch, 400*nm, 1*mm, 100, 0, raytr, direction)
+        focal.FoldQuantumEfficiency(batch)
+        nrunning = batch.Count(ROOT.ARay.kRun)
+        p = 0.5
+        sigma = (N * (1 - p) * p)**0.5
+        self.assertLess(abs(nrunning - N * p), 3*sigma)
+
+        focal.SetQELambdaFolded(True)
+        self.assertAlmostEqual(focal.GetDetectionProbability(400*nm, 45*deg), 0.5, 6)
+        manager.TraceNonSequential(batch)
+        nfocused = batch.Count(ROOT.ARay.kFocus)
+        p = 0.25
+        sigma = (N * (1 - p) * p)**0.5
+        self.assertLess(abs(nfocused - N * p), 3*sigma)
+
+        # Or as photon weights
+        batch.Clear()
+        ROOT.ARayShooter.Square(batch, 400*nm, 1*mm, 10, 0, raytr, direction)
+        focal.FoldQuantumEfficiency(batch, ROOT.AFocalSurface.kWeight)
+        self.assertEqual(batch.Count(ROOT.ARay.kRun), 100)
+        self.assertAlmostEqual(batch.GetWeight(0), 0.5, 6)
+
         cleanupGeo()
 
     def testGlassCatalog(self):
@@ -624,6 +1059,28 @@ class TestROBAST(unittest.TestCase):
         self.assertAlmostEqual(n, nA * 0.3 + nB * 0.7)
         self.assertAlmostEqual(k, kA * 0.3 + kB * 0.7)
 
+    def testFrozenRefractiveIndex(self):
+        nbk7 = ROOT.ASellmeierFormula(1.03961212, 0.231792344, 1.01046945,
+                                      0.00600069867, 0.0200179144, 103.560653)
+        wl = [(300 + i*0.45)*nm for i in range(1000)] # up to 750 nm
+        exact = [nbk7.GetRefractiveIndex(x) for x in wl]
+
+        nbk7.Freeze(250*nm, 700*nm, 1000)
+        self.assertTrue(nbk7.IsFrozen())
+        for x, n in zip(wl, exact):
+            self.assertAlmostEqual(nbk7.GetRefractiveIndex(x), n, 6)
+
+        # batch evaluation, partly outside the frozen range
+        lam = array.array('d', wl)
+        out = array.array('d', [0.]*len(wl))
+        nbk7.GetRefractiveIndices(len(wl), lam, out)
+        for n1, n2 in zip(out, exact):
+            self.assertAlmostEqual(n1, n2, 6)
+
+        nbk7.Unfreeze()
+        self.assertFalse(nbk7.IsFrozen())
+        self.assertEqual(nbk7.GetRefractiveIndex(wl[10]), exact[10])
+
     def testTMM(self):
         # Copied from tmm.tests.basic_test()
         ROOT.gROOT.ProcessLine('std::shared_ptr<ARefractiveIndex> med1(new ARefractiveIndex(1.));')
@@ -654,6 +1111,16 @@ class TestROBAST(unittest.TestCase):
         self.assertAlmostEqual(reflectance.value, (rs + rp) / 2.)
         self.assertAlmostEqual(transmittance.value, (ts + tp) / 2.)
 
+        r_s, t_s = ctypes.c_double(), ctypes.c_double()
+        r_p, t_p = ctypes.c_double(), ctypes.c_double()
+        multi.CoherentTMMMixed(th_0, lam_vac, reflectance, transmittance, r_s, t_s, r_p, t_p)
+        self.assertAlmostEqual(reflectance.value, (rs + rp) / 2.)
+        self.assertAlmostEqual(transmittance.value, (ts + tp) / 2.)
+        self.assertAlmostEqual(r_s.value, rs)
+        self.assertAlmostEqual(t_s.value, ts)
+        self.assertAlmostEqual(r_p.value, rp)
+        self.assertAlmostEqual(t_p.value, tp)
+
         reverse = ROOT.AMultilayer(ROOT.med4, ROOT.med1)
         reverse.InsertLayer(ROOT.med3, 3)
         reverse.InsertLayer(ROOT.med2, 2)
@@ -665,6 +1132,12 @@ class TestROBAST(unittest.TestCase):
         self.assertAlmostEqual(reflectance.value, rp)
         self.assertAlmostEqual(transmittance.value, tp)
 
+        reverse.CoherentTMMSP(th_0, lam_vac, r_s, t_s, r_p, t_p, True)
+        self.assertAlmostEqual(r_s.value, rs)
+        self.assertAlmostEqual(t_s.value, ts)
+        self.assertAlmostEqual(r_p.value, rp)
+        self.assertAlmostEqual(t_p.value, tp)
+
         wavelength_v = ROOT.vector('Double_t')()
         answer = []
 
@@ -691,6 +1164,15 @@ class TestROBAST(unittest.TestCase):
             
         multi.CoherentTMMMixed(angle_v, lam_vac, reflectance_v, transmittance_v)
 
+        for i in range(angle_v.size()):
+            self.assertAlmostEqual(answer[i][0], reflectance_v[i])
+            self.assertAlmostEqual(answer[i][1], transmittance_v[i])
+
+        # the same grid on the thread pool
+        multi.SetNthreads(4)
+        multi.CoherentTMMMixed(angle_v, lam_vac, reflectance_v, transmittance_v)
+        multi.SetNthreads(1)
+
         for i in range(angle_v.size()):
             self.assertAlmostEqual(answer[i][0], reflectance_v[i])
             self.assertAlmostEqual(answer[i][1], transmittance_v[i])
@@ -708,6 +1190,41 @@ class TestROBAST(unittest.TestCase):
         self.assertAlmostEqual(reflectance0.value, reflectance1.value)
         self.assertAlmostEqual(transmittance0.value, transmittance1.value)
 
+        # nodes equally spaced in cos(theta) do not include 45 deg
+        multi.PreCalculateCoherentTMM(801, 199.5, 1000.5, 90, -0.5 * deg, 89.5 * deg, True)
+        multi.CoherentTMMMixed(45 * deg, 600, reflectance1, transmittance1)
+
+        self.assertAlmostEqual(reflectance0.value, reflectance1.value, 3)
+        self.assertAlmostEqual(transmittance0.value, transmittance1.value, 3)
+
+        hist = multi.GetPrecalculatedReflectanceMixed()
+        self.assertEqual(hist.GetNbinsX(), 801)
+        self.assertEqual(hist.GetNbinsY(), 90)
+
+        multi.ClearPreCalculation()
+        multi.CoherentTMMMixed(45 * deg, 600, reflectance1, transmittance1)
+        self.assertEqual(reflectance0.value, reflectance1.value)
+
+        # the second table is read from the cache
+        import tempfile, glob, os
+        cachedir = tempfile.mkdtemp()
+        multi.SetCacheDirectory(cachedir)
+        multi.PreCalculateCoherentTMM(81, 195, 1005, 9, -5 * deg, 85 * deg)
+        table0 = multi.GetPreCalculatedTable()
+        self.assertEqual(len(glob.glob(os.path.join(cachedir, '*.root'))), 1)
+        multi.PreCalculateCoherentTMM(81, 195, 1005, 9, -5 * deg, 85 * deg)
+        table1 = multi.GetPreCalculatedTable()
+        for i in range(81 * 9 * 2):
+            self.assertEqual(table0.GetValues()[i], table1.GetValues()[i])
+
+        # a different stack must not hit the same cache
+        multi.ChangeThickness(1, 2.5)
+        multi.PreCalculateCoherentTMM(81, 195, 1005, 9, -5 * deg, 85 * deg)
+        self.assertEqual(len(glob.glob(os.path.join(cachedir, '*.root'))), 2)
+        multi.ChangeThickness(1, 2)
+        multi.SetCacheDirectory('')
+        multi.ClearPreCalculation()
+
     def testIncoherentTMM(self):
         '''
         Compare with the output of tmm.inc_tmm for the following config
@@ -779,6 +1296,84 @@ class TestROBAST(unittest.TestCase):
         self.assertAlmostEqual(reflectance.value, rp)
         self.assertAlmostEqual(transmittance.value, tp)
 
+        # The layer grouping is cached, so changing a thickness must give the
+        # same result as a stack built with the new thickness
+        multi.ChangeThickness(4, d2)
+        multi2 = ROOT.AMultilayer(ROOT.n0, ROOT.n3)
+        multi2.InsertLayer(ROOT.n1, d1)
+        multi2.InsertLayer(ROOT.n2, d2, False)
+        multi2.InsertLayer(ROOT.n1, d1)
+        multi2.InsertLayer(ROOT.n2, d2)
+        multi2.InsertLayer(ROOT.n3, d1)
+        multi2.InsertLayer(ROOT.n1, d2, False)
+        multi2.InsertLayer(ROOT.n3, d1)
+        multi2.InsertLayer(ROOT.n1, d1)
+
+        reflectance2 = ctypes.c_double()
+        transmittance2 = ctypes.c_double()
+        multi.IncoherentTMM(ROOT.AMultilayer.kS, th_0, lam_vac, reflectance, transmittance)
+        multi2.IncoherentTMM(ROOT.AMultilayer.kS, th_0, lam_vac, reflectance2, transmittance2)
+        self.assertNotAlmostEqual(reflectance.value, rs)
+        self.assertAlmostEqual(reflectance.value, reflectance2.value)
+        self.assertAlmostEqual(transmittance.value, transmittance2.value)
+
+    def testTMMGradient(self):
+        ROOT.gROOT.ProcessLine('std::shared_ptr<ARefractiveIndex> g0(new ARefractiveIndex(1., 0.));')
+        ROOT.gROOT.ProcessLine('std::shared_ptr<ARefractiveIndex> g1(new ARefractiveIndex(2.36, 0.01));')
+        ROOT.gROOT.ProcessLine('std::shared_ptr<ARefractiveIndex> g2(new ARefractiveIndex(1.46, 0.));')
+        ROOT.gROOT.ProcessLine('std::shared_ptr<ARefractiveIndex> g3(new ARefractiveIndex(1.52, 0.001));')
+
+        multi = ROOT.AMultilayer(ROOT.g0, ROOT.g0)
+        multi.InsertLayer(ROOT.g1, 110)
+        multi.InsertLayer(ROOT.g2, 170)
+        multi.InsertLayer(ROOT.g1, 105)
+        multi.InsertLayer(ROOT.g3, 5000, False)
+        multi.InsertLayer(ROOT.g2, 180)
+
+        th_0 = 0.3
+        lam_vac = 1000
+        h = 1e-4
+
+        reflectance = ctypes.c_double()
+        transmittance = ctypes.c_double()
+        r_p, t_p = ctypes.c_double(), ctypes.c_double()
+        r_m, t_m = ctypes.c_double(), ctypes.c_double()
+        r_grad = ROOT.std.vector('double')()
+        t_grad = ROOT.std.vector('double')()
+
+        # compare with finite differences
+        for pol in (ROOT.AMultilayer.kS, ROOT.AMultilayer.kP):
+            multi.IncoherentTMMGradient(pol, th_0, lam_vac, reflectance, transmittance, r_grad, t_grad)
+            self.assertEqual(r_grad.size(), 7)
+            self.assertEqual(r_grad[0], 0)
+            for i in range(1, 6):
+                d = multi.GetThickness(i)
+                multi.ChangeThickness(i, d + h)
+                multi.IncoherentTMM(pol, th_0, lam_vac, r_p, t_p)
+                multi.ChangeThickness(i, d - h)
+                multi.IncoherentTMM(pol, th_0, lam_vac, r_m, t_m)
+                multi.ChangeThickness(i, d)
+                self.assertAlmostEqual(r_grad[i], (r_p.value - r_m.value) / (2 * h), places=6)
+                self.assertAlmostEqual(t_grad[i], (t_p.value - t_m.value) / (2 * h), places=6)
+
+        layers = ROOT.std.vector('size_t')()
+        for i in (1, 2, 3):
+            layers.push_back(i)
+        merit = ROOT.AMultilayerMeritFunction(multi, layers)
+        for wl in (900, 1000, 1100):
+            merit.AddTarget(wl, th_0, ROOT.AMultilayerMeritFunction.kTransmittance, 0.)
+            merit.AddTarget(wl, th_0, ROOT.AMultilayerMeritFunction.kReflectance, 0.2, ROOT.AMultilayerMeritFunction.kAtLeast)
+        self.assertEqual(merit.NDim(), 3)
+
+        x = array.array('d', [100., 160., 110.])
+        grad = array.array('d', [0., 0., 0.])
+        merit.Gradient(x, grad)
+        for i in range(3):
+            xp, xm = array.array('d', x), array.array('d', x)
+            xp[i] += h
+            xm[i] -= h
+            self.assertAlmostEqual(grad[i], (merit(xp) - merit(xm)) / (2 * h), places=6)
+
     def testLambertian(self):
         manager = makeTheWorld()
 